@@ -0,0 +1,14 @@
+#version 460
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(location = 0) in vec2 texCoordFS;
+layout(location = 1) flat in uint textureIndexFS;
+
+layout(set = 0, binding = 1) uniform sampler linearSampler;
+layout(set = 0, binding = 2) uniform texture2D textures[];
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    outColor = texture(sampler2D(textures[nonuniformEXT(textureIndexFS)], linearSampler), texCoordFS);
+}
\ No newline at end of file
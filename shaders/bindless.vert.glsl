@@ -0,0 +1,35 @@
+#version 460
+
+struct Instance {
+    vec4 rect;
+    uint textureIndex;
+};
+
+layout(set = 0, binding = 0, std430) readonly buffer Instances {
+    Instance instances[];
+};
+
+const vec2[] corners = vec2[6](
+    vec2(0.0, 0.0),
+    vec2(0.0, 1.0),
+    vec2(1.0, 0.0),
+    vec2(1.0, 0.0),
+    vec2(0.0, 1.0),
+    vec2(1.0, 1.0)
+);
+
+out gl_PerVertex {
+    vec4 gl_Position;
+};
+
+layout(location = 0) out vec2 texCoordFS;
+layout(location = 1) flat out uint textureIndexFS;
+
+void main() {
+    Instance instance = instances[gl_InstanceIndex];
+    vec2 corner = corners[gl_VertexIndex];
+
+    gl_Position = vec4(instance.rect.xy + corner * instance.rect.zw, 0.0, 1.0);
+    texCoordFS = corner;
+    textureIndexFS = instance.textureIndex;
+}
\ No newline at end of file
@@ -1,3 +1,5 @@
 @echo off
 glslangValidator -V example.vert.glsl -o ../bin/example.vert.spv
-glslangValidator -V example.frag.glsl -o ../bin/example.frag.spv
\ No newline at end of file
+glslangValidator -V example.frag.glsl -o ../bin/example.frag.spv
+glslangValidator -V bindless.vert.glsl -o ../bin/bindless.vert.spv
+glslangValidator -V bindless.frag.glsl -o ../bin/bindless.frag.spv
\ No newline at end of file
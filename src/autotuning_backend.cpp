@@ -0,0 +1,288 @@
+#include "autotuning_backend.hpp"
+#include <algorithm>
+#include <cstring>
+
+autotuning_backend::autotuning_backend(storage_backend& backend, const autotuning_desc& desc) : _backend(backend), _desc(desc) {
+    _desc.min_queue_depth = std::max(_desc.min_queue_depth, 1u);
+    _desc.max_queue_depth = std::max(_desc.max_queue_depth, _desc.min_queue_depth);
+    _desc.min_request_size = std::max<uint64_t>(_desc.min_request_size, 1);
+    _desc.max_request_size = std::max(_desc.max_request_size, _desc.min_request_size);
+
+    _queue_depth = _accepted_queue_depth = std::clamp(_desc.initial_queue_depth, _desc.min_queue_depth, _desc.max_queue_depth);
+    _request_size = _accepted_request_size = std::clamp(_desc.initial_request_size, _desc.min_request_size, _desc.max_request_size);
+
+    _stats.queue_depth = _queue_depth;
+    _stats.request_size = _request_size;
+}
+
+void autotuning_backend::enqueue(const read_request& request) {
+    _queued.push_back(request);
+}
+
+void autotuning_backend::submit() {
+    update_saturation(clock::now());
+
+    for(const auto& request : _queued) {
+        const auto request_id = _next_request_id++;
+
+        _requests.emplace(request_id, pending_request {
+            .user_data = request.user_data,
+            .bytes_left = request.size,
+            .success = true
+        });
+
+        _waiting.push_back(waiting_range {
+            .request_id = request_id,
+            .file = request.file,
+            .offset = request.offset,
+            .size = request.size,
+            .destination = static_cast<uint8_t*>(request.destination),
+            .priority = request.priority,
+            .destination_kind = request.destination_kind,
+            .split = false
+        });
+    }
+    _queued.clear();
+
+    issue();
+    _backend.submit();
+}
+
+bool autotuning_backend::issue() {
+    auto issued = false;
+
+    while(!_waiting.empty() && _reads.size() < _queue_depth) {
+        issue_read();
+        issued = true;
+    }
+
+    return issued;
+}
+
+void autotuning_backend::issue_read() {
+    auto& first = _waiting.front();
+
+    tuned_read read = {
+        .issue_time = clock::now()
+    };
+
+    read_request backend_request = {
+        .file = first.file,
+        .offset = first.offset,
+        .size = 0,
+        .priority = first.priority,
+        .destination_kind = first.destination_kind
+    };
+
+    if(first.size >= _request_size) {
+        // The next piece of a long request goes straight into its destination
+        backend_request.size = _request_size;
+        read.data = first.destination;
+        read.targets.push_back(scatter_target {
+            .request_id = first.request_id,
+            .destination = first.destination,
+            .offset_in_read = 0,
+            .size = _request_size
+        });
+
+        if(first.size > _request_size && !first.split) {
+            first.split = true;
+            _stats.split_requests++;
+        }
+
+        first.offset += _request_size;
+        first.destination += _request_size;
+        first.size -= _request_size;
+        if(first.size == 0) {
+            _waiting.pop_front();
+        }
+    } else {
+        while(!_waiting.empty()) {
+            const auto& range = _waiting.front();
+            if(!read.targets.empty() && (range.file != backend_request.file || range.offset != backend_request.offset + backend_request.size ||
+                                         backend_request.size + range.size > _request_size)) {
+                break;
+            }
+
+            // A merged read is as urgent as the most urgent request it serves
+            backend_request.priority = std::max(backend_request.priority, range.priority);
+            read.targets.push_back(scatter_target {
+                .request_id = range.request_id,
+                .destination = range.destination,
+                .offset_in_read = backend_request.size,
+                .size = range.size
+            });
+            backend_request.size += range.size;
+
+            _waiting.pop_front();
+        }
+
+        if(read.targets.size() > 1) {
+            read.scratch = std::make_unique_for_overwrite<uint8_t[]>(backend_request.size);
+            read.data = read.scratch.get();
+            backend_request.destination_kind = read_destination::private_memory;
+            _stats.merged_requests += read.targets.size();
+        } else {
+            read.data = read.targets.front().destination;
+        }
+    }
+
+    const auto read_id = _next_read_id++;
+    backend_request.destination = read.data;
+    backend_request.user_data = read_id;
+
+    _backend.enqueue(backend_request);
+    _reads.emplace(read_id, std::move(read));
+    _stats.backend_reads++;
+}
+
+void autotuning_backend::poll(std::vector<read_completion>& completions) {
+    _backend_completions.clear();
+    _backend.poll(_backend_completions);
+
+    const auto now = clock::now();
+    update_saturation(now);
+
+    for(const auto& backend_completion : _backend_completions) {
+        const auto it = _reads.find(backend_completion.user_data);
+        if(it == _reads.end()) {
+            continue;
+        }
+
+        const auto& read = it->second;
+        _epoch_latency.record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now - read.issue_time).count()));
+        _epoch_read_count++;
+
+        for(const auto& target : read.targets) {
+            if(backend_completion.success && read.scratch) {
+                memcpy(target.destination, read.data + target.offset_in_read, target.size);
+            }
+            _epoch_bytes += target.size;
+
+            auto& request = _requests.at(target.request_id);
+            request.success = request.success && backend_completion.success;
+            request.bytes_left -= target.size;
+            if(request.bytes_left == 0) {
+                completions.push_back(read_completion {
+                    .user_data = request.user_data,
+                    .success = request.success
+                });
+                _requests.erase(target.request_id);
+            }
+        }
+
+        _reads.erase(it);
+    }
+
+    if(now - _epoch_start >= _desc.epoch && _epoch_read_count >= _desc.epoch_reads) {
+        finish_epoch(now);
+    }
+
+    if(issue()) {
+        _backend.submit();
+    }
+}
+
+void autotuning_backend::wait() {
+    if(!_reads.empty()) {
+        _backend.wait();
+    }
+}
+
+void autotuning_backend::update_saturation(clock::time_point now) {
+    // Requests waiting for a slot mean the current settings, not the demand, limited the device
+    if(!_waiting.empty()) {
+        _saturated_time += now - _last_update;
+    }
+    _last_update = now;
+}
+
+void autotuning_backend::finish_epoch(clock::time_point now) {
+    const auto elapsed = now - _epoch_start;
+    const auto bandwidth = static_cast<uint64_t>(static_cast<double>(_epoch_bytes) / std::chrono::duration<double>(elapsed).count());
+    const auto p90_latency = std::chrono::nanoseconds(_epoch_latency.value_at_percentile(90.0));
+    const auto saturated = _saturated_time >= elapsed * 3 / 4;
+
+    _stats.epochs++;
+    _stats.bandwidth = bandwidth;
+    _stats.p90_latency = p90_latency;
+
+    _epoch_start = now;
+    _saturated_time = {};
+    _epoch_bytes = 0;
+    _epoch_read_count = 0;
+    _epoch_latency.reset();
+
+    if(p90_latency > _desc.latency_limit) {
+        _stats.latency_backoffs++;
+        if(_probing) {
+            next_probe();
+        } else if(_accepted_queue_depth > _desc.min_queue_depth) {
+            _accepted_queue_depth = std::max(_accepted_queue_depth / 2, _desc.min_queue_depth);
+        } else {
+            // A single read takes too long, so it has to get shorter
+            _accepted_request_size = std::max(_accepted_request_size / 2, _desc.min_request_size);
+        }
+        _probing = false;
+    } else if(!saturated) {
+        _stats.idle_epochs++;
+    } else if(!_probing) {
+        _baseline_bandwidth = bandwidth;
+        _probing = apply_probe();
+    } else if(static_cast<double>(bandwidth) > static_cast<double>(_baseline_bandwidth) * (1.0 + _desc.min_gain)) {
+        // Worth it; keep going the same way
+        _accepted_queue_depth = _queue_depth;
+        _accepted_request_size = _request_size;
+        _baseline_bandwidth = bandwidth;
+        _probing = apply_probe();
+    } else {
+        next_probe();
+        _probing = false;
+    }
+
+    if(!_probing && (_queue_depth != _accepted_queue_depth || _request_size != _accepted_request_size)) {
+        _queue_depth = _accepted_queue_depth;
+        _request_size = _accepted_request_size;
+        _stats.adjustments++;
+    }
+
+    _stats.queue_depth = _queue_depth;
+    _stats.request_size = _request_size;
+}
+
+bool autotuning_backend::apply_probe() {
+    for(uint32_t attempt = 0; attempt < static_cast<uint32_t>(probe::count); attempt++) {
+        auto queue_depth = _accepted_queue_depth;
+        auto request_size = _accepted_request_size;
+
+        switch(_probe) {
+            case probe::deeper_queue:
+                queue_depth = std::min(queue_depth * 2, _desc.max_queue_depth);
+                break;
+            case probe::larger_requests:
+                request_size = std::min(request_size * 2, _desc.max_request_size);
+                break;
+            case probe::shallower_queue:
+                queue_depth = std::max(queue_depth / 2, _desc.min_queue_depth);
+                break;
+            default:
+                request_size = std::max(request_size / 2, _desc.min_request_size);
+                break;
+        }
+
+        if(queue_depth != _accepted_queue_depth || request_size != _accepted_request_size) {
+            _queue_depth = queue_depth;
+            _request_size = request_size;
+            _stats.adjustments++;
+            return true;
+        }
+
+        next_probe();
+    }
+
+    return false;
+}
+
+void autotuning_backend::next_probe() {
+    _probe = static_cast<probe>((static_cast<uint32_t>(_probe) + 1) % static_cast<uint32_t>(probe::count));
+}
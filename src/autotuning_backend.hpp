@@ -0,0 +1,143 @@
+#pragma once
+
+#include "load_telemetry.hpp"
+#include "storage_backend.hpp"
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <unordered_map>
+
+struct autotuning_desc {
+    uint32_t initial_queue_depth = 32;
+    uint32_t min_queue_depth = 1;
+    uint32_t max_queue_depth = 256;
+    uint64_t initial_request_size = 512 * 1024;
+    uint64_t min_request_size = 64 * 1024;
+    uint64_t max_request_size = 8 * 1024 * 1024;
+    // Settings whose p90 read latency goes over this are backed off, whatever bandwidth they reach
+    std::chrono::microseconds latency_limit = std::chrono::milliseconds(20);
+    // A measurement covers at least this long and this many reads
+    std::chrono::microseconds epoch = std::chrono::milliseconds(100);
+    uint32_t epoch_reads = 32;
+    // A probed setting is kept when it raises the bandwidth by more than this fraction
+    double min_gain = 0.05;
+};
+
+struct autotuning_stats {
+    uint32_t queue_depth;
+    uint64_t request_size;
+    uint64_t bandwidth;
+    std::chrono::nanoseconds p90_latency;
+    uint64_t epochs;
+    uint64_t idle_epochs;
+    uint64_t adjustments;
+    uint64_t latency_backoffs;
+    uint64_t split_requests;
+    uint64_t merged_requests;
+    uint64_t backend_reads;
+};
+
+// Sits in front of the device and tunes how it is driven. At most queue_depth reads are outstanding;
+// requests beyond that wait in submission order. Requests longer than request_size are split into reads of
+// that size straight into their destination, and waiting requests that continue each other in a file are
+// merged into one read of up to request_size through a scratch buffer. Every epoch with a backlog measures
+// the bandwidth and p90 latency of the current settings, then probes doubling or halving one of them: the
+// probe is kept when it pays off and reverted otherwise. Latency over the limit halves the queue depth, or
+// the request size once the queue is as shallow as allowed. Epochs without a backlog don't tell anything
+// about the settings and are skipped.
+class autotuning_backend final : public storage_backend {
+public:
+    autotuning_backend(storage_backend& backend, const autotuning_desc& desc);
+
+    uint64_t open_file(const std::filesystem::path& path) override { return _backend.open_file(path); }
+    uint64_t file_size(uint64_t file) const override { return _backend.file_size(file); }
+    void close_file(uint64_t file) override { _backend.close_file(file); }
+
+    void enqueue(const read_request& request) override;
+    void submit() override;
+    void poll(std::vector<read_completion>& completions) override;
+    void wait() override;
+
+    size_t in_flight() const override { return _queued.size() + _requests.size(); }
+
+    const autotuning_stats& stats() const { return _stats; }
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    enum class probe {
+        deeper_queue,
+        larger_requests,
+        shallower_queue,
+        smaller_requests,
+        count
+    };
+
+    struct pending_request {
+        uint64_t user_data;
+        uint64_t bytes_left;
+        bool success;
+    };
+
+    struct waiting_range {
+        uint64_t request_id;
+        uint64_t file;
+        uint64_t offset;
+        uint64_t size;
+        uint8_t* destination;
+        read_priority priority;
+        read_destination destination_kind;
+        bool split;
+    };
+
+    struct scatter_target {
+        uint64_t request_id;
+        uint8_t* destination;
+        uint64_t offset_in_read;
+        uint64_t size;
+    };
+
+    struct tuned_read {
+        std::unique_ptr<uint8_t[]> scratch;
+        uint8_t* data;
+        std::vector<scatter_target> targets;
+        clock::time_point issue_time;
+    };
+
+    bool issue();
+    void issue_read();
+    void update_saturation(clock::time_point now);
+    void finish_epoch(clock::time_point now);
+    bool apply_probe();
+    void next_probe();
+
+    storage_backend& _backend;
+    autotuning_desc _desc;
+
+    uint32_t _queue_depth;
+    uint64_t _request_size;
+
+    std::vector<read_request> _queued;
+    std::unordered_map<uint64_t, pending_request> _requests;
+    uint64_t _next_request_id = 1;
+    std::deque<waiting_range> _waiting;
+    std::unordered_map<uint64_t, tuned_read> _reads;
+    uint64_t _next_read_id = 1;
+    std::vector<read_completion> _backend_completions;
+
+    clock::time_point _epoch_start = clock::now();
+    clock::time_point _last_update = _epoch_start;
+    clock::duration _saturated_time = {};
+    uint64_t _epoch_bytes = 0;
+    uint64_t _epoch_read_count = 0;
+    latency_histogram _epoch_latency;
+
+    // Settings that measured best so far, and what is being tried against them
+    uint32_t _accepted_queue_depth;
+    uint64_t _accepted_request_size;
+    uint64_t _baseline_bandwidth = 0;
+    bool _probing = false;
+    probe _probe = probe::deeper_queue;
+
+    autotuning_stats _stats = {};
+};
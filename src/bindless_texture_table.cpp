@@ -0,0 +1,210 @@
+#include "bindless_texture_table.hpp"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <stdexcept>
+
+void bindless_texture_table::enable_features(VkPhysicalDevice physical_device, VkPhysicalDeviceDescriptorIndexingFeatures& descriptor_indexing_features) {
+    VkPhysicalDeviceDescriptorIndexingFeatures supported_descriptor_indexing_features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES
+    };
+
+    VkPhysicalDeviceFeatures2 physical_device_features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+        .pNext = &supported_descriptor_indexing_features
+    };
+
+    vkGetPhysicalDeviceFeatures2(physical_device, &physical_device_features);
+
+    if(!supported_descriptor_indexing_features.shaderSampledImageArrayNonUniformIndexing ||
+       !supported_descriptor_indexing_features.descriptorBindingSampledImageUpdateAfterBind ||
+       !supported_descriptor_indexing_features.descriptorBindingPartiallyBound ||
+       !supported_descriptor_indexing_features.runtimeDescriptorArray) {
+        throw std::runtime_error("Descriptor indexing is not supported by the physical device");
+    }
+
+    descriptor_indexing_features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+    descriptor_indexing_features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    descriptor_indexing_features.descriptorBindingPartiallyBound = VK_TRUE;
+    descriptor_indexing_features.runtimeDescriptorArray = VK_TRUE;
+}
+
+void bindless_texture_table::create(VkPhysicalDevice physical_device, VkDevice device, VkSampler sampler) {
+    _device = device;
+
+    VkPhysicalDeviceDescriptorIndexingProperties descriptor_indexing_properties = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES
+    };
+
+    VkPhysicalDeviceProperties2 physical_device_properties = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+        .pNext = &descriptor_indexing_properties
+    };
+
+    vkGetPhysicalDeviceProperties2(physical_device, &physical_device_properties);
+
+    _texture_capacity = std::min({ max_textures, descriptor_indexing_properties.maxDescriptorSetUpdateAfterBindSampledImages,
+                                   descriptor_indexing_properties.maxPerStageDescriptorUpdateAfterBindSampledImages });
+
+    std::array<VkDescriptorSetLayoutBinding, 3> descriptor_set_layout_bindings = {
+        VkDescriptorSetLayoutBinding {
+            .binding = 0,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_VERTEX_BIT
+        },
+        VkDescriptorSetLayoutBinding {
+            .binding = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+            .pImmutableSamplers = &sampler
+        },
+        VkDescriptorSetLayoutBinding {
+            .binding = 2,
+            .descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+            .descriptorCount = _texture_capacity,
+            .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT
+        }
+    };
+
+    std::array<VkDescriptorBindingFlags, 3> descriptor_binding_flags = {
+        0,
+        0,
+        VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT
+    };
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo descriptor_set_layout_binding_flags_create_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+        .bindingCount = static_cast<uint32_t>(descriptor_binding_flags.size()),
+        .pBindingFlags = descriptor_binding_flags.data()
+    };
+
+    VkDescriptorSetLayoutCreateInfo descriptor_set_layout_create_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .pNext = &descriptor_set_layout_binding_flags_create_info,
+        .flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT,
+        .bindingCount = static_cast<uint32_t>(descriptor_set_layout_bindings.size()),
+        .pBindings = descriptor_set_layout_bindings.data()
+    };
+
+    throw_if_failed(vkCreateDescriptorSetLayout(device, &descriptor_set_layout_create_info, nullptr, &_descriptor_set_layout), "vkCreateDescriptorSetLayout");
+
+    std::array<VkDescriptorPoolSize, 3> descriptor_pool_sizes = {
+        VkDescriptorPoolSize { .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1 },
+        VkDescriptorPoolSize { .type = VK_DESCRIPTOR_TYPE_SAMPLER, .descriptorCount = 1 },
+        VkDescriptorPoolSize { .type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, .descriptorCount = _texture_capacity }
+    };
+
+    VkDescriptorPoolCreateInfo descriptor_pool_create_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT,
+        .maxSets = 1,
+        .poolSizeCount = static_cast<uint32_t>(descriptor_pool_sizes.size()),
+        .pPoolSizes = descriptor_pool_sizes.data()
+    };
+
+    throw_if_failed(vkCreateDescriptorPool(device, &descriptor_pool_create_info, nullptr, &_descriptor_pool), "vkCreateDescriptorPool");
+
+    VkDescriptorSetAllocateInfo descriptor_set_allocate_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = _descriptor_pool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &_descriptor_set_layout
+    };
+
+    throw_if_failed(vkAllocateDescriptorSets(device, &descriptor_set_allocate_info, &_descriptor_set), "vkAllocateDescriptorSets");
+
+    VkBufferCreateInfo buffer_create_info = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = sizeof(bindless_instance) * max_instances,
+        .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE
+    };
+
+    throw_if_failed(vkCreateBuffer(device, &buffer_create_info, nullptr, &_instance_buffer), "vkCreateBuffer");
+
+    VkMemoryRequirements memory_requirements;
+    vkGetBufferMemoryRequirements(device, _instance_buffer, &memory_requirements);
+
+    VkMemoryAllocateInfo memory_allocate_info = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .allocationSize = memory_requirements.size,
+        .memoryTypeIndex = find_memory_type(physical_device, memory_requirements.memoryTypeBits,
+                                            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+    };
+
+    throw_if_failed(vkAllocateMemory(device, &memory_allocate_info, nullptr, &_instance_memory), "vkAllocateMemory");
+    throw_if_failed(vkBindBufferMemory(device, _instance_buffer, _instance_memory, 0), "vkBindBufferMemory");
+    throw_if_failed(vkMapMemory(device, _instance_memory, 0, VK_WHOLE_SIZE, 0, reinterpret_cast<void**>(&_mapped_instances)), "vkMapMemory");
+
+    VkDescriptorBufferInfo descriptor_buffer_info = {
+        .buffer = _instance_buffer,
+        .offset = 0,
+        .range = VK_WHOLE_SIZE
+    };
+
+    VkWriteDescriptorSet write_descriptor_set = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = _descriptor_set,
+        .dstBinding = 0,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .pBufferInfo = &descriptor_buffer_info
+    };
+
+    vkUpdateDescriptorSets(device, 1, &write_descriptor_set, 0, nullptr);
+}
+
+void bindless_texture_table::destroy() {
+    vkUnmapMemory(_device, _instance_memory);
+    vkDestroyBuffer(_device, _instance_buffer, nullptr);
+    vkFreeMemory(_device, _instance_memory, nullptr);
+
+    vkDestroyDescriptorPool(_device, _descriptor_pool, nullptr);
+    vkDestroyDescriptorSetLayout(_device, _descriptor_set_layout, nullptr);
+}
+
+uint32_t bindless_texture_table::add_texture(VkImageView image_view) {
+    uint32_t texture_index;
+    if(!_free_texture_indices.empty()) {
+        texture_index = _free_texture_indices.back();
+        _free_texture_indices.pop_back();
+    } else if(_next_texture_index < _texture_capacity) {
+        texture_index = _next_texture_index++;
+    } else {
+        throw std::runtime_error("Bindless texture table is full");
+    }
+
+    VkDescriptorImageInfo descriptor_image_info = {
+        .imageView = image_view,
+        .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+    };
+
+    VkWriteDescriptorSet write_descriptor_set = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = _descriptor_set,
+        .dstBinding = 2,
+        .dstArrayElement = texture_index,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+        .pImageInfo = &descriptor_image_info
+    };
+
+    vkUpdateDescriptorSets(_device, 1, &write_descriptor_set, 0, nullptr);
+
+    return texture_index;
+}
+
+void bindless_texture_table::remove_texture(uint32_t texture_index) {
+    _free_texture_indices.push_back(texture_index);
+}
+
+void bindless_texture_table::set_instances(std::span<const bindless_instance> instances) {
+    _instance_count = static_cast<uint32_t>(std::min<size_t>(instances.size(), max_instances));
+    memcpy(_mapped_instances, instances.data(), _instance_count * sizeof(bindless_instance));
+}
+
+void bindless_texture_table::bind(VkCommandBuffer command_buffer, VkPipelineLayout pipeline_layout) const {
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, 0, 1, &_descriptor_set, 0, nullptr);
+}
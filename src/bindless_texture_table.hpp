@@ -0,0 +1,49 @@
+#pragma once
+
+#include "vulkan_utils.hpp"
+#include <cstdint>
+#include <span>
+#include <vector>
+
+struct bindless_instance {
+    float rect[4];
+    uint32_t texture_index;
+    uint32_t padding[3];
+};
+
+// One descriptor set holding the per-instance storage buffer, an immutable sampler and a large
+// partially bound array of sampled images. Texture slots are written with update-after-bind, so
+// textures can be added while the set is bound by in-flight command buffers.
+class bindless_texture_table {
+public:
+    static constexpr uint32_t max_textures = 16384;
+    static constexpr uint32_t max_instances = 65536;
+
+    static void enable_features(VkPhysicalDevice physical_device, VkPhysicalDeviceDescriptorIndexingFeatures& descriptor_indexing_features);
+
+    void create(VkPhysicalDevice physical_device, VkDevice device, VkSampler sampler);
+    void destroy();
+
+    uint32_t add_texture(VkImageView image_view);
+    void remove_texture(uint32_t texture_index);
+
+    void set_instances(std::span<const bindless_instance> instances);
+    uint32_t instance_count() const { return _instance_count; }
+    uint32_t texture_capacity() const { return _texture_capacity; }
+
+    VkDescriptorSetLayout descriptor_set_layout() const { return _descriptor_set_layout; }
+    void bind(VkCommandBuffer command_buffer, VkPipelineLayout pipeline_layout) const;
+
+private:
+    VkDevice _device = VK_NULL_HANDLE;
+    VkDescriptorSetLayout _descriptor_set_layout = VK_NULL_HANDLE;
+    VkDescriptorPool _descriptor_pool = VK_NULL_HANDLE;
+    VkDescriptorSet _descriptor_set = VK_NULL_HANDLE;
+    VkBuffer _instance_buffer = VK_NULL_HANDLE;
+    VkDeviceMemory _instance_memory = VK_NULL_HANDLE;
+    bindless_instance* _mapped_instances = nullptr;
+    uint32_t _instance_count = 0;
+    uint32_t _texture_capacity = 0;
+    uint32_t _next_texture_index = 0;
+    std::vector<uint32_t> _free_texture_indices;
+};
@@ -0,0 +1,426 @@
+#include "caching_backend.hpp"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <system_error>
+#include <utility>
+
+namespace {
+    uint64_t fnv1a(const void* data, size_t size, uint64_t hash = 0xcbf29ce484222325) {
+        const auto* bytes = static_cast<const uint8_t*>(data);
+        for(size_t i = 0; i < size; i++) {
+            hash = (hash ^ bytes[i]) * 0x100000001b3;
+        }
+        return hash;
+    }
+
+    template<typename T>
+    uint64_t fnv1a_value(const T& value, uint64_t hash) {
+        return fnv1a(&value, sizeof(value), hash);
+    }
+}
+
+caching_backend::caching_backend(storage_backend& backend, const caching_desc& desc) : _backend(backend), _desc(desc) {
+    if(!_desc.disk_directory.empty()) {
+        std::filesystem::create_directories(_desc.disk_directory);
+        _disk_thread = std::thread([this] { disk_main(); });
+        load_disk_index();
+    }
+}
+
+caching_backend::~caching_backend() {
+    if(_disk_thread.joinable()) {
+        // Spills still queued are written, so they are there for the next run
+        {
+            std::lock_guard lock(_disk_mutex);
+            _disk_stopping = true;
+        }
+        _disk_work_available.notify_one();
+        _disk_thread.join();
+    }
+}
+
+uint64_t caching_backend::open_file(const std::filesystem::path& path) {
+    const auto file = _backend.open_file(path);
+
+    // Hashing the contents would cost the read the cache is there to avoid, so the content hash
+    // covers what changes whenever the contents do
+    const auto canonical_path = std::filesystem::weakly_canonical(path).string();
+    const auto write_time = std::filesystem::last_write_time(path).time_since_epoch().count();
+
+    _files[file] = file_entry {
+        .path_hash = fnv1a(canonical_path.data(), canonical_path.size()),
+        .content_hash = fnv1a_value(write_time, fnv1a_value(_backend.file_size(file), 0xcbf29ce484222325))
+    };
+
+    return file;
+}
+
+void caching_backend::close_file(uint64_t file) {
+    _files.erase(file);
+    _backend.close_file(file);
+}
+
+caching_backend::cache_key caching_backend::make_key(const read_request& request) const {
+    const auto& file = _files.at(request.file);
+    return cache_key {
+        .asset_id = fnv1a_value(request.size, fnv1a_value(request.offset, file.path_hash)),
+        .content_hash = file.content_hash
+    };
+}
+
+void caching_backend::enqueue(const read_request& request) {
+    const auto key = make_key(request);
+
+    if(read_from_ram(key, request)) {
+        _hits.push_back(read_completion {
+            .user_data = request.user_data,
+            .success = true
+        });
+        return;
+    }
+
+    if(read_from_disk(key, request)) {
+        return;
+    }
+
+    _stats.misses++;
+    fill_from_backend(key, request);
+}
+
+void caching_backend::fill_from_backend(const cache_key& key, const read_request& request) {
+    const auto fill_id = _next_fill_id++;
+    _fills.emplace(fill_id, pending_fill {
+        .key = key,
+        .destination = request.destination,
+        .size = request.size,
+        .user_data = request.user_data
+    });
+
+    _backend.enqueue(read_request {
+        .file = request.file,
+        .offset = request.offset,
+        .size = request.size,
+        .destination = request.destination,
+        .user_data = fill_id,
+        .priority = request.priority,
+        .destination_kind = request.destination_kind
+    });
+}
+
+void caching_backend::poll(std::vector<read_completion>& completions) {
+    completions.insert(completions.end(), _hits.begin(), _hits.end());
+    _hits.clear();
+
+    if(_disk_thread.joinable()) {
+        finish_disk_jobs(completions);
+    }
+
+    _backend_completions.clear();
+    _backend.poll(_backend_completions);
+
+    for(const auto& backend_completion : _backend_completions) {
+        auto fill = _fills.extract(backend_completion.user_data);
+        if(fill.empty()) {
+            continue;
+        }
+
+        const auto& pending = fill.mapped();
+        if(backend_completion.success) {
+            _stats.bytes_from_backend += pending.size;
+            insert_ram(pending.key, pending.destination, pending.size);
+        }
+
+        completions.push_back(read_completion {
+            .user_data = pending.user_data,
+            .success = backend_completion.success
+        });
+    }
+}
+
+void caching_backend::wait() {
+    if(!_hits.empty()) {
+        return;
+    }
+
+    // A local file read finishes sooner than most device reads, and it's the only thing to wait for without them
+    if(_disk_reads > 0) {
+        std::unique_lock lock(_disk_mutex);
+        _disk_job_finished.wait(lock, [&] { return !_finished_disk_jobs.empty(); });
+        return;
+    }
+
+    _backend.wait();
+}
+
+bool caching_backend::read_from_ram(const cache_key& key, const read_request& request) {
+    const auto it = _ram_entries.find(key);
+    if(it == _ram_entries.end()) {
+        return false;
+    }
+
+    _ram_lru.splice(_ram_lru.begin(), _ram_lru, it->second);
+    memcpy(request.destination, it->second->data.data(), request.size);
+
+    _stats.ram_hits++;
+    _stats.bytes_from_ram += request.size;
+
+    return true;
+}
+
+bool caching_backend::read_from_disk(const cache_key& key, const read_request& request) {
+    const auto it = _disk_entries.find(key);
+    if(it == _disk_entries.end() || it->second->size != request.size) {
+        return false;
+    }
+
+    _disk_lru.splice(_disk_lru.begin(), _disk_lru, it->second);
+
+    _disk_reads++;
+    queue_disk_job(disk_job {
+        .operation = disk_operation::read,
+        .key = key,
+        .path = disk_path(key),
+        .request = request,
+        .data = {},
+        .success = false
+    });
+
+    return true;
+}
+
+void caching_backend::insert_ram(const cache_key& key, const void* data, uint64_t size) {
+    if(size > _desc.ram_capacity || _ram_entries.contains(key)) {
+        return;
+    }
+
+    while(_stats.ram_bytes + size > _desc.ram_capacity) {
+        auto& victim = _ram_lru.back();
+        _stats.ram_bytes -= victim.data.size();
+        _stats.ram_evictions++;
+
+        if(!_desc.disk_directory.empty() && !_disk_entries.contains(victim.key)) {
+            insert_disk(victim.key, std::move(victim.data));
+        }
+
+        _ram_entries.erase(victim.key);
+        _ram_lru.pop_back();
+    }
+
+    host_buffer copy(size, _desc.huge_pages, _desc.numa_node);
+    memcpy(copy.data(), data, size);
+
+    _ram_lru.push_front(ram_entry {
+        .key = key,
+        .data = std::move(copy)
+    });
+    _ram_entries.emplace(key, _ram_lru.begin());
+    _stats.ram_bytes += size;
+}
+
+void caching_backend::insert_disk(const cache_key& key, host_buffer data) {
+    if(data.size() > _desc.disk_capacity) {
+        return;
+    }
+
+    while(_stats.disk_bytes + data.size() > _desc.disk_capacity) {
+        evict_disk_lru();
+    }
+
+    // Indexed right away: reads of the entry are queued behind the write, and a failed write drops it again
+    _disk_lru.push_front(disk_entry {
+        .key = key,
+        .size = data.size()
+    });
+    _disk_entries.emplace(key, _disk_lru.begin());
+    _stats.disk_bytes += data.size();
+
+    queue_disk_job(disk_job {
+        .operation = disk_operation::write,
+        .key = key,
+        .path = disk_path(key),
+        .request = {},
+        .data = std::move(data),
+        .success = false
+    });
+}
+
+void caching_backend::drop_disk_entry(const cache_key& key) {
+    const auto it = _disk_entries.find(key);
+    if(it == _disk_entries.end()) {
+        return;
+    }
+
+    _stats.disk_bytes -= it->second->size;
+    _disk_lru.erase(it->second);
+    _disk_entries.erase(it);
+}
+
+void caching_backend::load_disk_index() {
+    struct indexed_file {
+        cache_key key;
+        uint64_t size;
+        std::filesystem::file_time_type write_time;
+    };
+
+    std::vector<indexed_file> files;
+
+    for(const auto& entry : std::filesystem::directory_iterator(_desc.disk_directory)) {
+        const auto name = entry.path().filename().string();
+        if(!entry.is_regular_file() || name.size() != 36 || !name.ends_with(".bin")) {
+            continue;
+        }
+
+        cache_key key;
+        const auto asset_result = std::from_chars(name.data(), name.data() + 16, key.asset_id, 16);
+        const auto content_result = std::from_chars(name.data() + 16, name.data() + 32, key.content_hash, 16);
+        if(asset_result.ec != std::errc() || content_result.ec != std::errc()) {
+            continue;
+        }
+
+        files.push_back(indexed_file {
+            .key = key,
+            .size = entry.file_size(),
+            .write_time = entry.last_write_time()
+        });
+    }
+
+    // Oldest first, so the most recently written entry ends up at the front
+    std::sort(files.begin(), files.end(), [](const indexed_file& a, const indexed_file& b) { return a.write_time < b.write_time; });
+
+    for(const auto& file : files) {
+        _disk_lru.push_front(disk_entry {
+            .key = file.key,
+            .size = file.size
+        });
+        _disk_entries.emplace(file.key, _disk_lru.begin());
+        _stats.disk_bytes += file.size;
+    }
+
+    while(_stats.disk_bytes > _desc.disk_capacity) {
+        evict_disk_lru();
+    }
+}
+
+void caching_backend::evict_disk_lru() {
+    const auto& victim = _disk_lru.back();
+
+    queue_disk_job(disk_job {
+        .operation = disk_operation::remove,
+        .key = victim.key,
+        .path = disk_path(victim.key),
+        .request = {},
+        .data = {},
+        .success = false
+    });
+
+    _stats.disk_bytes -= victim.size;
+    _stats.disk_evictions++;
+    _disk_entries.erase(victim.key);
+    _disk_lru.pop_back();
+}
+
+std::filesystem::path caching_backend::disk_path(const cache_key& key) const {
+    return _desc.disk_directory / std::format("{:016x}{:016x}.bin", key.asset_id, key.content_hash);
+}
+
+void caching_backend::queue_disk_job(disk_job job) {
+    {
+        std::lock_guard lock(_disk_mutex);
+        _disk_queue.push_back(std::move(job));
+    }
+    _disk_work_available.notify_one();
+}
+
+void caching_backend::finish_disk_jobs(std::vector<read_completion>& completions) {
+    _harvested_disk_jobs.clear();
+    {
+        std::lock_guard lock(_disk_mutex);
+        std::swap(_harvested_disk_jobs, _finished_disk_jobs);
+    }
+
+    auto refilled = false;
+    for(auto& job : _harvested_disk_jobs) {
+        if(job.operation == disk_operation::write) {
+            // A failed write only costs the entry
+            drop_disk_entry(job.key);
+            continue;
+        }
+
+        _disk_reads--;
+
+        if(!job.success) {
+            // Removed or truncated behind the cache's back
+            drop_disk_entry(job.key);
+            _stats.misses++;
+            fill_from_backend(job.key, job.request);
+            refilled = true;
+            continue;
+        }
+
+        _stats.disk_hits++;
+        _stats.bytes_from_disk += job.request.size;
+        insert_ram(job.key, job.request.destination, job.request.size);
+
+        completions.push_back(read_completion {
+            .user_data = job.request.user_data,
+            .success = true
+        });
+    }
+
+    // Refills go out with this poll instead of waiting for the caller's next submit
+    if(refilled) {
+        _backend.submit();
+    }
+}
+
+void caching_backend::disk_main() {
+    std::unique_lock lock(_disk_mutex);
+
+    for(;;) {
+        _disk_work_available.wait(lock, [&] { return _disk_stopping || !_disk_queue.empty(); });
+        if(_disk_queue.empty()) {
+            return;
+        }
+
+        auto job = std::move(_disk_queue.front());
+        _disk_queue.pop_front();
+        lock.unlock();
+
+        switch(job.operation) {
+            case disk_operation::read: {
+                std::ifstream file(job.path, std::ios::binary);
+                job.success = static_cast<bool>(file.read(static_cast<char*>(job.request.destination), static_cast<std::streamsize>(job.request.size)));
+                break;
+            }
+            case disk_operation::write: {
+                {
+                    std::ofstream file(job.path, std::ios::binary | std::ios::trunc);
+                    job.success = static_cast<bool>(file.write(reinterpret_cast<const char*>(job.data.data()), static_cast<std::streamsize>(job.data.size())));
+                }
+                if(!job.success) {
+                    std::error_code error;
+                    std::filesystem::remove(job.path, error);
+                }
+                job.data = {};
+                break;
+            }
+            case disk_operation::remove: {
+                std::error_code error;
+                std::filesystem::remove(job.path, error);
+                job.success = true;
+                break;
+            }
+        }
+
+        lock.lock();
+
+        // Only reads and failed writes have anything left for the polling thread
+        if(job.operation == disk_operation::read || !job.success) {
+            _finished_disk_jobs.push_back(std::move(job));
+            _disk_job_finished.notify_all();
+        }
+    }
+}
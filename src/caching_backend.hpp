@@ -0,0 +1,159 @@
+#pragma once
+
+#include "host_memory.hpp"
+#include "storage_backend.hpp"
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+struct caching_desc {
+    uint64_t ram_capacity = 256 * 1024 * 1024;
+    // An empty directory disables the disk tier
+    std::filesystem::path disk_directory;
+    uint64_t disk_capacity = 4ull * 1024 * 1024 * 1024;
+    // Pages of the RAM tier; hits are memcpys out of it, so large entries go on huge pages
+    huge_page_mode huge_pages = huge_page_mode::automatic;
+    // Node the RAM tier lives on; -1 leaves it wherever it is first touched
+    int32_t numa_node = -1;
+};
+
+struct caching_stats {
+    uint64_t ram_hits;
+    uint64_t disk_hits;
+    uint64_t misses;
+    uint64_t bytes_from_ram;
+    uint64_t bytes_from_disk;
+    uint64_t bytes_from_backend;
+    uint64_t ram_evictions;
+    uint64_t disk_evictions;
+    uint64_t ram_bytes;
+    uint64_t disk_bytes;
+};
+
+// Sits in front of another backend and keeps the payloads it delivered. Entries are keyed by the asset
+// (path and byte range) plus a content hash of the file's size and modification time, so a rewritten
+// file never hits stale data. A bounded RAM tier answers hits with one memcpy during enqueue(); its
+// least recently used entries spill to files in disk_directory, which is bounded the same way and
+// survives restarts. The disk tier's reads, spills and removals run in order on a thread of its own, so
+// the polling thread never waits for the disk: a disk hit completes on a later poll() and is promoted
+// back into RAM there, and one whose file turned out to be gone is read from the backend instead.
+class caching_backend final : public storage_backend {
+public:
+    caching_backend(storage_backend& backend, const caching_desc& desc);
+    ~caching_backend();
+
+    caching_backend(const caching_backend&) = delete;
+    caching_backend& operator=(const caching_backend&) = delete;
+
+    uint64_t open_file(const std::filesystem::path& path) override;
+    uint64_t file_size(uint64_t file) const override { return _backend.file_size(file); }
+    void close_file(uint64_t file) override;
+
+    void enqueue(const read_request& request) override;
+    void submit() override { _backend.submit(); }
+    void poll(std::vector<read_completion>& completions) override;
+    void wait() override;
+
+    size_t in_flight() const override { return _fills.size() + _hits.size() + _disk_reads; }
+
+    const caching_stats& stats() const { return _stats; }
+
+private:
+    struct cache_key {
+        uint64_t asset_id;
+        uint64_t content_hash;
+
+        bool operator==(const cache_key&) const = default;
+    };
+
+    struct cache_key_hash {
+        size_t operator()(const cache_key& key) const { return key.asset_id ^ (key.content_hash * 0x9e3779b97f4a7c15); }
+    };
+
+    struct file_entry {
+        uint64_t path_hash;
+        uint64_t content_hash;
+    };
+
+    struct ram_entry {
+        cache_key key;
+        host_buffer data;
+    };
+
+    struct disk_entry {
+        cache_key key;
+        uint64_t size;
+    };
+
+    struct pending_fill {
+        cache_key key;
+        void* destination;
+        uint64_t size;
+        uint64_t user_data;
+    };
+
+    enum class disk_operation : uint8_t {
+        read,
+        write,
+        remove
+    };
+
+    struct disk_job {
+        disk_operation operation;
+        cache_key key;
+        std::filesystem::path path;
+        // The request a read serves, and the entry a write spills
+        read_request request;
+        host_buffer data;
+        bool success;
+    };
+
+    cache_key make_key(const read_request& request) const;
+    bool read_from_ram(const cache_key& key, const read_request& request);
+    bool read_from_disk(const cache_key& key, const read_request& request);
+    void fill_from_backend(const cache_key& key, const read_request& request);
+    void insert_ram(const cache_key& key, const void* data, uint64_t size);
+    void insert_disk(const cache_key& key, host_buffer data);
+    void evict_disk_lru();
+    void drop_disk_entry(const cache_key& key);
+    void load_disk_index();
+    std::filesystem::path disk_path(const cache_key& key) const;
+
+    void queue_disk_job(disk_job job);
+    void finish_disk_jobs(std::vector<read_completion>& completions);
+    void disk_main();
+
+    storage_backend& _backend;
+    caching_desc _desc;
+
+    std::unordered_map<uint64_t, file_entry> _files;
+
+    std::list<ram_entry> _ram_lru;
+    std::unordered_map<cache_key, std::list<ram_entry>::iterator, cache_key_hash> _ram_entries;
+
+    std::list<disk_entry> _disk_lru;
+    std::unordered_map<cache_key, std::list<disk_entry>::iterator, cache_key_hash> _disk_entries;
+
+    std::unordered_map<uint64_t, pending_fill> _fills;
+    uint64_t _next_fill_id = 1;
+    std::vector<read_completion> _hits;
+    std::vector<read_completion> _backend_completions;
+
+    std::thread _disk_thread;
+    std::mutex _disk_mutex;
+    std::condition_variable _disk_work_available;
+    std::condition_variable _disk_job_finished;
+    std::deque<disk_job> _disk_queue;
+    std::vector<disk_job> _finished_disk_jobs;
+    std::vector<disk_job> _harvested_disk_jobs;
+    bool _disk_stopping = false;
+    // Disk reads queued or running; only the polling thread touches it
+    size_t _disk_reads = 0;
+
+    caching_stats _stats = {};
+};
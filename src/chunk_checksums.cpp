@@ -0,0 +1,110 @@
+#include "chunk_checksums.hpp"
+#include "xxh3.hpp"
+#include <algorithm>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+
+namespace {
+    constexpr char checksum_magic[8] = { 'D', 'S', 'V', 'K', 'X', 'H', '3', '1' };
+
+    // Follows the magic; the hashes come after it, one uint64_t per chunk
+    struct checksum_header {
+        uint64_t chunk_size;
+        uint64_t file_size;
+        uint64_t chunk_count;
+    };
+}
+
+std::filesystem::path chunk_checksum_path(const std::filesystem::path& asset) {
+    auto path = asset;
+    path += ".xxh3";
+    return path;
+}
+
+chunk_checksums compute_chunk_checksums(const std::filesystem::path& asset, uint64_t chunk_size) {
+    if(chunk_size == 0) {
+        throw std::runtime_error("Checksum chunks can't be empty");
+    }
+
+    std::ifstream file(asset, std::ios::binary);
+    if(!file) {
+        throw std::runtime_error(std::format("Can't read {}", asset.string()));
+    }
+
+    chunk_checksums checksums = {
+        .chunk_size = chunk_size,
+        .file_size = std::filesystem::file_size(asset),
+        .hashes = {}
+    };
+
+    const auto chunk = std::make_unique_for_overwrite<uint8_t[]>(chunk_size);
+    for(uint64_t offset = 0; offset < checksums.file_size; offset += chunk_size) {
+        const auto size = std::min(chunk_size, checksums.file_size - offset);
+        if(!file.read(reinterpret_cast<char*>(chunk.get()), static_cast<std::streamsize>(size))) {
+            throw std::runtime_error(std::format("{} changed while its checksums were computed", asset.string()));
+        }
+        checksums.hashes.push_back(xxh3_64(chunk.get(), size));
+    }
+
+    return checksums;
+}
+
+void write_chunk_checksums(const std::filesystem::path& path, const chunk_checksums& checksums) {
+    // Written next to the old checksums and renamed, so a crash never leaves a torn file for readers to reject
+    auto temporary_path = path;
+    temporary_path += ".tmp";
+
+    {
+        std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+
+        const checksum_header header = {
+            .chunk_size = checksums.chunk_size,
+            .file_size = checksums.file_size,
+            .chunk_count = checksums.hashes.size()
+        };
+
+        file.write(checksum_magic, sizeof(checksum_magic));
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(checksums.hashes.data()), static_cast<std::streamsize>(checksums.hashes.size() * sizeof(uint64_t)));
+        if(!file) {
+            throw std::runtime_error(std::format("Can't write checksums {}", temporary_path.string()));
+        }
+    }
+
+    std::filesystem::rename(temporary_path, path);
+}
+
+std::optional<chunk_checksums> read_chunk_checksums(const std::filesystem::path& path) {
+    std::ifstream file(path, std::ios::binary);
+    if(!file) {
+        return std::nullopt;
+    }
+
+    char magic[sizeof(checksum_magic)];
+    checksum_header header;
+    if(!file.read(magic, sizeof(magic)) || memcmp(magic, checksum_magic, sizeof(magic)) != 0 ||
+       !file.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+        throw std::runtime_error(std::format("{} is not a checksum file", path.string()));
+    }
+
+    const auto expected_chunks = header.chunk_size > 0 ? (header.file_size + header.chunk_size - 1) / header.chunk_size : 0;
+    if(header.chunk_size == 0 || header.chunk_count != expected_chunks) {
+        throw std::runtime_error(std::format("{} has {} checksums for {} chunks", path.string(), header.chunk_count, expected_chunks));
+    }
+    if(std::filesystem::file_size(path) != sizeof(checksum_magic) + sizeof(header) + header.chunk_count * sizeof(uint64_t)) {
+        throw std::runtime_error(std::format("{} has the wrong size for its header", path.string()));
+    }
+
+    chunk_checksums checksums = {
+        .chunk_size = header.chunk_size,
+        .file_size = header.file_size,
+        .hashes = std::vector<uint64_t>(header.chunk_count)
+    };
+
+    file.read(reinterpret_cast<char*>(checksums.hashes.data()), static_cast<std::streamsize>(header.chunk_count * sizeof(uint64_t)));
+
+    return checksums;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <vector>
+
+// XXH3 hashes of consecutive fixed-size chunks of an asset, kept in a sidecar file next to it so the
+// assets themselves stay in their original formats. The last chunk ends with the file and may be shorter.
+struct chunk_checksums {
+    uint64_t chunk_size;
+    uint64_t file_size;
+    std::vector<uint64_t> hashes;
+};
+
+constexpr uint64_t default_checksum_chunk_size = 64 * 1024;
+
+// "<asset>.xxh3"
+std::filesystem::path chunk_checksum_path(const std::filesystem::path& asset);
+
+chunk_checksums compute_chunk_checksums(const std::filesystem::path& asset, uint64_t chunk_size = default_checksum_chunk_size);
+
+void write_chunk_checksums(const std::filesystem::path& path, const chunk_checksums& checksums);
+
+// Empty when the file doesn't exist; throws when it exists but isn't a checksum file
+std::optional<chunk_checksums> read_chunk_checksums(const std::filesystem::path& path);
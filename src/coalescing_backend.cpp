@@ -0,0 +1,157 @@
+#include "coalescing_backend.hpp"
+#include <algorithm>
+#include <cstring>
+
+coalescing_backend::coalescing_backend(storage_backend& backend, const coalescing_desc& desc) : _backend(backend), _desc(desc) {
+}
+
+void coalescing_backend::enqueue(const read_request& request) {
+    _stats.requests++;
+    _stats.bytes_requested += request.size;
+
+    if(attach_to_in_flight(request)) {
+        _stats.attached_requests++;
+        return;
+    }
+
+    _queued.push_back(request);
+}
+
+bool coalescing_backend::attach_to_in_flight(const read_request& request) {
+    auto it = _operations_by_range.upper_bound({ request.file, request.offset });
+
+    while(it != _operations_by_range.begin()) {
+        --it;
+
+        const auto [file, offset] = it->first;
+        if(file != request.file || request.offset - offset > _desc.max_read_size) {
+            break;
+        }
+
+        auto& operation = _operations.at(it->second);
+        if(request.offset + request.size <= operation.offset + operation.size) {
+            operation.targets.push_back(scatter_target {
+                .destination = request.destination,
+                .offset_in_read = request.offset - operation.offset,
+                .size = request.size,
+                .user_data = request.user_data
+            });
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void coalescing_backend::submit() {
+    if(_queued.empty()) {
+        _backend.submit();
+        return;
+    }
+
+    std::sort(_queued.begin(), _queued.end(), [](const read_request& a, const read_request& b) {
+        return a.file != b.file ? a.file < b.file : a.offset < b.offset;
+    });
+
+    read_operation operation = {};
+
+    for(const auto& request : _queued) {
+        const auto request_end = request.offset + request.size;
+        const auto operation_end = operation.offset + operation.size;
+
+        const auto mergeable = !operation.targets.empty() && request.file == operation.file && request.offset <= operation_end + _desc.max_gap &&
+                               std::max(request_end, operation_end) - operation.offset <= _desc.max_read_size;
+
+        if(!mergeable) {
+            if(!operation.targets.empty()) {
+                issue(std::move(operation));
+            }
+
+            operation = read_operation {
+                .file = request.file,
+                .offset = request.offset,
+                .size = 0,
+                .priority = request.priority,
+                .destination_kind = request.destination_kind
+            };
+        }
+
+        // A merged read is as urgent as the most urgent request it serves
+        operation.priority = std::max(operation.priority, request.priority);
+        operation.size = std::max(request_end, operation.offset + operation.size) - operation.offset;
+        operation.targets.push_back(scatter_target {
+            .destination = request.destination,
+            .offset_in_read = request.offset - operation.offset,
+            .size = request.size,
+            .user_data = request.user_data
+        });
+    }
+
+    issue(std::move(operation));
+    _queued.clear();
+
+    _backend.submit();
+}
+
+void coalescing_backend::issue(read_operation operation) {
+    const auto& first_target = operation.targets.front();
+    if(operation.targets.size() == 1 && first_target.size == operation.size) {
+        operation.data = static_cast<uint8_t*>(first_target.destination);
+    } else {
+        operation.scratch = std::make_unique<uint8_t[]>(operation.size);
+        operation.data = operation.scratch.get();
+        operation.destination_kind = read_destination::private_memory;
+    }
+
+    const auto operation_id = _next_operation_id++;
+
+    _backend.enqueue(read_request {
+        .file = operation.file,
+        .offset = operation.offset,
+        .size = operation.size,
+        .destination = operation.data,
+        .user_data = operation_id,
+        .priority = operation.priority,
+        .destination_kind = operation.destination_kind
+    });
+
+    _stats.backend_reads++;
+    _stats.bytes_read += operation.size;
+
+    _operations_by_range.emplace(std::make_pair(operation.file, operation.offset), operation_id);
+    _operations.emplace(operation_id, std::move(operation));
+}
+
+void coalescing_backend::poll(std::vector<read_completion>& completions) {
+    _backend_completions.clear();
+    _backend.poll(_backend_completions);
+
+    for(const auto& backend_completion : _backend_completions) {
+        const auto it = _operations.find(backend_completion.user_data);
+        if(it == _operations.end()) {
+            continue;
+        }
+
+        const auto& operation = it->second;
+        for(const auto& target : operation.targets) {
+            if(backend_completion.success && target.destination != operation.data + target.offset_in_read) {
+                memcpy(target.destination, operation.data + target.offset_in_read, target.size);
+            }
+
+            completions.push_back(read_completion {
+                .user_data = target.user_data,
+                .success = backend_completion.success
+            });
+        }
+
+        auto [first, last] = _operations_by_range.equal_range({ operation.file, operation.offset });
+        for(; first != last; ++first) {
+            if(first->second == it->first) {
+                _operations_by_range.erase(first);
+                break;
+            }
+        }
+
+        _operations.erase(it);
+    }
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "storage_backend.hpp"
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+
+struct coalescing_desc {
+    uint64_t max_gap = 64 * 1024;
+    uint64_t max_read_size = 4 * 1024 * 1024;
+};
+
+struct coalescing_stats {
+    uint64_t requests;
+    uint64_t attached_requests;
+    uint64_t backend_reads;
+    uint64_t bytes_requested;
+    uint64_t bytes_read;
+};
+
+// Sits in front of another backend. A request whose range is already covered by an in-flight read
+// attaches to that read instead of issuing a new one, and requests submitted together are sorted by
+// file and offset and merged into reads of at most max_read_size when the gap between them is at most
+// max_gap. Merged reads land in a scratch buffer and are scattered to the original destinations.
+class coalescing_backend final : public storage_backend {
+public:
+    coalescing_backend(storage_backend& backend, const coalescing_desc& desc);
+
+    uint64_t open_file(const std::filesystem::path& path) override { return _backend.open_file(path); }
+    uint64_t file_size(uint64_t file) const override { return _backend.file_size(file); }
+    void close_file(uint64_t file) override { _backend.close_file(file); }
+
+    void enqueue(const read_request& request) override;
+    void submit() override;
+    void poll(std::vector<read_completion>& completions) override;
+    void wait() override { _backend.wait(); }
+
+    size_t in_flight() const override { return _operations.size() + _queued.size(); }
+
+    const coalescing_stats& stats() const { return _stats; }
+
+private:
+    struct scatter_target {
+        void* destination;
+        uint64_t offset_in_read;
+        uint64_t size;
+        uint64_t user_data;
+    };
+
+    struct read_operation {
+        uint64_t file;
+        uint64_t offset;
+        uint64_t size;
+        read_priority priority;
+        read_destination destination_kind;
+        std::unique_ptr<uint8_t[]> scratch;
+        uint8_t* data;
+        std::vector<scatter_target> targets;
+    };
+
+    bool attach_to_in_flight(const read_request& request);
+    void issue(read_operation operation);
+
+    storage_backend& _backend;
+    coalescing_desc _desc;
+
+    std::vector<read_request> _queued;
+    std::unordered_map<uint64_t, read_operation> _operations;
+    std::multimap<std::pair<uint64_t, uint64_t>, uint64_t> _operations_by_range;
+    std::vector<read_completion> _backend_completions;
+    uint64_t _next_operation_id = 1;
+
+    coalescing_stats _stats = {};
+};
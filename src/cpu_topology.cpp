@@ -0,0 +1,260 @@
+#include "cpu_topology.hpp"
+#include <algorithm>
+#include <charconv>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    int32_t role_node(const thread_placement_desc& desc, thread_role role) {
+        switch(role) {
+            case thread_role::io:
+                return desc.io_node;
+            case thread_role::decode:
+                return desc.decode_node;
+            default:
+                return desc.submission_node;
+        }
+    }
+
+#ifdef _WIN32
+    cpu_topology discover() {
+        cpu_topology topology;
+
+        ULONG highest_node = 0;
+        GetNumaHighestNodeNumber(&highest_node);
+
+        for(USHORT id = 0; id <= highest_node; id++) {
+            GROUP_AFFINITY affinity = {};
+            if(!GetNumaNodeProcessorMaskEx(id, &affinity) || affinity.Mask == 0) {
+                continue;
+            }
+
+            numa_node node = { .id = id, .cpus = {} };
+            for(uint32_t bit = 0; bit < 64; bit++) {
+                if(affinity.Mask & (KAFFINITY(1) << bit)) {
+                    node.cpus.push_back(static_cast<uint32_t>(affinity.Group) * 64 + bit);
+                }
+            }
+            topology.nodes.push_back(std::move(node));
+        }
+
+        return topology;
+    }
+#else
+    const numa_node* find_node(uint32_t id) {
+        const auto& nodes = system_topology().nodes;
+        const auto it = std::find_if(nodes.begin(), nodes.end(), [id](const numa_node& node) { return node.id == id; });
+        return it != nodes.end() ? &*it : nullptr;
+    }
+
+    // "0-3,8-11"
+    std::vector<uint32_t> parse_cpu_list(std::string_view list) {
+        std::vector<uint32_t> cpus;
+
+        while(!list.empty()) {
+            const auto comma = list.find(',');
+            const auto range = list.substr(0, comma);
+            list = comma == std::string_view::npos ? std::string_view() : list.substr(comma + 1);
+
+            uint32_t first = 0;
+            const auto [end, error] = std::from_chars(range.data(), range.data() + range.size(), first);
+            if(error != std::errc()) {
+                continue;
+            }
+
+            auto last = first;
+            if(end < range.data() + range.size() && *end == '-') {
+                std::from_chars(end + 1, range.data() + range.size(), last);
+            }
+
+            for(auto cpu = first; cpu <= last; cpu++) {
+                cpus.push_back(cpu);
+            }
+        }
+
+        return cpus;
+    }
+
+    cpu_topology discover() {
+        cpu_topology topology;
+
+        std::error_code error;
+        for(const auto& entry : std::filesystem::directory_iterator("/sys/devices/system/node", error)) {
+            const auto name = entry.path().filename().string();
+            uint32_t id = 0;
+            if(!name.starts_with("node") || std::from_chars(name.data() + 4, name.data() + name.size(), id).ec != std::errc()) {
+                continue;
+            }
+
+            std::ifstream file(entry.path() / "cpulist");
+            std::string list;
+            std::getline(file, list);
+
+            // Memory-only nodes have no CPUs to run threads on
+            auto cpus = parse_cpu_list(list);
+            if(!cpus.empty()) {
+                topology.nodes.push_back(numa_node { .id = id, .cpus = std::move(cpus) });
+            }
+        }
+
+        std::sort(topology.nodes.begin(), topology.nodes.end(), [](const numa_node& a, const numa_node& b) { return a.id < b.id; });
+        return topology;
+    }
+
+    // Raw system calls keep libnuma out of the build
+    constexpr int mpol_preferred = 1;
+#endif
+}
+
+const cpu_topology& system_topology() {
+    static const cpu_topology topology = [] {
+        auto discovered = discover();
+        if(discovered.nodes.empty()) {
+            numa_node node = { .id = 0, .cpus = {} };
+            for(uint32_t cpu = 0; cpu < std::max(std::thread::hardware_concurrency(), 1u); cpu++) {
+                node.cpus.push_back(cpu);
+            }
+            discovered.nodes.push_back(std::move(node));
+        }
+        return discovered;
+    }();
+    return topology;
+}
+
+void validate_thread_placement(const thread_placement_desc& desc) {
+    const auto& nodes = system_topology().nodes;
+
+    for(const auto role : { thread_role::io, thread_role::decode, thread_role::submission }) {
+        const auto node = role_node(desc, role);
+        if(node >= 0 && std::none_of(nodes.begin(), nodes.end(), [node](const numa_node& n) { return n.id == static_cast<uint32_t>(node); })) {
+            throw std::runtime_error(std::format("NUMA node {} has no CPUs on this host", node));
+        }
+    }
+}
+
+uint32_t placement_node(const thread_placement_desc& desc, thread_role role, uint32_t thread_index) {
+    const auto node = role_node(desc, role);
+    if(node >= 0) {
+        return static_cast<uint32_t>(node);
+    }
+
+    const auto& nodes = system_topology().nodes;
+    return nodes[thread_index % nodes.size()].id;
+}
+
+std::string format_cpu_list(const std::vector<uint32_t>& cpus) {
+    std::string list;
+
+    for(size_t i = 0; i < cpus.size();) {
+        auto j = i;
+        while(j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1) {
+            j++;
+        }
+
+        if(!list.empty()) {
+            list += ',';
+        }
+        list += j > i ? std::format("{}-{}", cpus[i], cpus[j]) : std::format("{}", cpus[i]);
+        i = j + 1;
+    }
+
+    return list;
+}
+
+#ifdef _WIN32
+
+bool place_current_thread(const thread_placement_desc& desc, thread_role role, uint32_t thread_index) {
+    if(!desc.pin) {
+        return true;
+    }
+
+    // Windows allocates from the node of the thread's processor, so pinning also places its memory
+    GROUP_AFFINITY affinity = {};
+    if(!GetNumaNodeProcessorMaskEx(static_cast<USHORT>(placement_node(desc, role, thread_index)), &affinity)) {
+        return false;
+    }
+
+    return SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr) != 0;
+}
+
+std::string interrupt_affinity_hints(uint32_t) {
+    return {};
+}
+
+#else
+
+bool place_current_thread(const thread_placement_desc& desc, thread_role role, uint32_t thread_index) {
+    if(!desc.pin) {
+        return true;
+    }
+
+    const auto* node = find_node(placement_node(desc, role, thread_index));
+    if(!node) {
+        return false;
+    }
+
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    for(const auto cpu : node->cpus) {
+        if(cpu < CPU_SETSIZE) {
+            CPU_SET(cpu, &cpus);
+        }
+    }
+    if(sched_setaffinity(0, sizeof(cpus), &cpus) != 0) {
+        return false;
+    }
+
+    // Preferred rather than bound, so a full node spills over instead of failing allocations
+    unsigned long node_mask[16] = {};
+    if(node->id < sizeof(node_mask) * 8) {
+        node_mask[node->id / 64] = 1ul << (node->id % 64);
+        syscall(SYS_set_mempolicy, mpol_preferred, node_mask, sizeof(node_mask) * 8);
+    }
+
+    return true;
+}
+
+std::string interrupt_affinity_hints(uint32_t node_id) {
+    const auto* node = find_node(node_id);
+    if(!node) {
+        return {};
+    }
+
+    const auto cpu_list = format_cpu_list(node->cpus);
+
+    std::string hints;
+    std::ifstream interrupts("/proc/interrupts");
+    std::string line;
+    while(std::getline(interrupts, line)) {
+        if(line.find("nvme") == std::string::npos) {
+            continue;
+        }
+
+        std::istringstream fields(line);
+        std::string irq;
+        fields >> irq;
+        if(irq.empty() || irq.back() != ':') {
+            continue;
+        }
+        irq.pop_back();
+
+        hints += std::format("echo {} > /proc/irq/{}/smp_affinity_list\n", cpu_list, irq);
+    }
+
+    return hints;
+}
+
+#endif
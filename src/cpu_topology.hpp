@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct numa_node {
+    uint32_t id;
+    std::vector<uint32_t> cpus;
+};
+
+// NUMA nodes with CPUs, in id order. Hosts without NUMA information get one node with every CPU.
+struct cpu_topology {
+    std::vector<numa_node> nodes;
+};
+
+enum class thread_role {
+    io,
+    decode,
+    submission
+};
+
+struct thread_placement_desc {
+    // Without pin, threads run wherever the scheduler puts them
+    bool pin = false;
+    // Node the threads of each role are pinned to; -1 spreads a pool's threads over all nodes
+    int32_t io_node = -1;
+    int32_t decode_node = -1;
+    int32_t submission_node = -1;
+};
+
+// Discovered once and cached
+const cpu_topology& system_topology();
+
+// Throws when a role is given a node that doesn't exist or has no CPUs
+void validate_thread_placement(const thread_placement_desc& desc);
+
+// The node the thread_index-th thread of a role belongs on; nodes past the last one wrap around
+uint32_t placement_node(const thread_placement_desc& desc, thread_role role, uint32_t thread_index);
+
+// Pins the calling thread to the node placement_node() picks and makes it allocate from that node. Does
+// nothing without desc.pin; returns false when the OS refuses.
+bool place_current_thread(const thread_placement_desc& desc, thread_role role, uint32_t thread_index);
+
+// "0-3,8-11"
+std::string format_cpu_list(const std::vector<uint32_t>& cpus);
+
+// Commands that steer the interrupts of NVMe devices to the CPUs of a node, one per line. Interrupts
+// the kernel manages itself (per-queue NVMe vectors on recent kernels) refuse the change and are
+// already spread over the CPUs that submit to them.
+std::string interrupt_affinity_hints(uint32_t node);
@@ -0,0 +1,10 @@
+#include "d3d12_utils.hpp"
+#include <format>
+#include <stdexcept>
+#include <system_error>
+
+void throw_if_failed(HRESULT result, const std::string_view& message) {
+    if(FAILED(result)) {
+        throw std::runtime_error(std::format("{} failed: {}", message, std::system_category().message(result)));
+    }
+}
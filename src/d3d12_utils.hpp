@@ -0,0 +1,18 @@
+#pragma once
+
+#include <DirectStorage/dstorage.h>
+#include <cstdint>
+#include <string_view>
+
+#ifdef min
+#undef min
+#endif
+
+#ifdef max
+#undef max
+#endif
+
+// DirectStorage fails requests larger than the queue's staging buffer, so bigger reads are split into pieces of at most this size
+inline constexpr uint32_t dstorage_max_request_size = DSTORAGE_STAGING_BUFFER_SIZE_32MB;
+
+void throw_if_failed(HRESULT result, const std::string_view& message);
@@ -0,0 +1,188 @@
+#include "dstorage_backend.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+dstorage_backend::dstorage_backend(IDStorageFactory* dstorage_factory, ID3D12Device* d3d12_device) : _dstorage_factory(dstorage_factory) {
+    DSTORAGE_QUEUE_DESC queue_desc = {
+        .SourceType = DSTORAGE_REQUEST_SOURCE_FILE,
+        .Capacity = DSTORAGE_MAX_QUEUE_CAPACITY,
+        .Priority = DSTORAGE_PRIORITY_NORMAL,
+        .Device = d3d12_device
+    };
+
+    throw_if_failed(dstorage_factory->CreateQueue(&queue_desc, IID_PPV_ARGS(&_dstorage_queue)), "IDStorageFactory::CreateQueue");
+    throw_if_failed(d3d12_device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&_fence)), "ID3D12Device::CreateFence");
+
+    _fence_event = CreateEvent(nullptr, false, false, nullptr);
+    if(!_fence_event) {
+        throw std::runtime_error("CreateEvent failed");
+    }
+}
+
+dstorage_backend::~dstorage_backend() {
+    submit();
+    while(!_batches.empty()) {
+        wait();
+
+        std::vector<read_completion> completions;
+        poll(completions);
+    }
+
+    for(const auto& [id, entry] : _files) {
+        entry.file->Release();
+    }
+
+    for(auto* status_array : _status_arrays) {
+        status_array->Release();
+    }
+
+    CloseHandle(_fence_event);
+    _fence->Release();
+    _dstorage_queue->Release();
+}
+
+uint64_t dstorage_backend::open_file(const std::filesystem::path& path) {
+    IDStorageFile* dstorage_file;
+    throw_if_failed(_dstorage_factory->OpenFile(path.c_str(), IID_PPV_ARGS(&dstorage_file)), "IDStorageFactory::OpenFile");
+
+    BY_HANDLE_FILE_INFORMATION dstorage_file_information = {};
+    throw_if_failed(dstorage_file->GetFileInformation(&dstorage_file_information), "IDStorageFile::GetFileInformation");
+
+    const auto file = _next_file++;
+    _files.emplace(file, open_file_entry {
+        .file = dstorage_file,
+        .size = (static_cast<uint64_t>(dstorage_file_information.nFileSizeHigh) << 32) | dstorage_file_information.nFileSizeLow
+    });
+
+    return file;
+}
+
+uint64_t dstorage_backend::file_size(uint64_t file) const {
+    return _files.at(file).size;
+}
+
+void dstorage_backend::close_file(uint64_t file) {
+    const auto it = _files.find(file);
+    if(it != _files.end()) {
+        it->second.file->Close();
+        it->second.file->Release();
+        _files.erase(it);
+    }
+}
+
+void dstorage_backend::enqueue(const read_request& request) {
+    auto* file = _files.at(request.file).file;
+    auto* destination = static_cast<uint8_t*>(request.destination);
+
+    // Pieces of one request complete with the same fence, so they only need the user data once
+    uint64_t done = 0;
+    do {
+        const auto size = static_cast<uint32_t>(std::min<uint64_t>(request.size - done, dstorage_max_request_size));
+
+        DSTORAGE_REQUEST dstorage_request = {
+            .Options = {
+                .SourceType = DSTORAGE_REQUEST_SOURCE_FILE,
+                .DestinationType = DSTORAGE_REQUEST_DESTINATION_MEMORY,
+            },
+            .Source = {
+                .File = {
+                    .Source = file,
+                    .Offset = request.offset + done,
+                    .Size = size
+                }
+            },
+            .Destination = {
+                .Memory = {
+                    .Buffer = destination + done,
+                    .Size = size
+                }
+            },
+            .UncompressedSize = size
+        };
+
+        _dstorage_queue->EnqueueRequest(&dstorage_request);
+        done += size;
+    } while(done < request.size);
+
+    _queued_user_data.push_back(request.user_data);
+}
+
+void dstorage_backend::submit() {
+    if(_queued_user_data.empty()) {
+        return;
+    }
+
+    // The status entry reports the first failure among the requests enqueued since the previous one,
+    // which are exactly this batch's
+    const auto status_entry = acquire_status_entry();
+    _dstorage_queue->EnqueueStatus(_status_arrays[status_entry / status_array_capacity], status_entry % status_array_capacity);
+
+    _fence_value++;
+    _dstorage_queue->EnqueueSignal(_fence, _fence_value);
+    _dstorage_queue->Submit();
+
+    _batches.push_back(submitted_batch {
+        .fence_value = _fence_value,
+        .status_entry = status_entry,
+        .user_data = std::move(_queued_user_data)
+    });
+    _queued_user_data.clear();
+}
+
+uint32_t dstorage_backend::acquire_status_entry() {
+    if(_free_status_entries.empty()) {
+        IDStorageStatusArray* status_array;
+        throw_if_failed(_dstorage_factory->CreateStatusArray(status_array_capacity, "dstorage_backend", IID_PPV_ARGS(&status_array)),
+                        "IDStorageFactory::CreateStatusArray");
+
+        const auto first = static_cast<uint32_t>(_status_arrays.size()) * status_array_capacity;
+        _status_arrays.push_back(status_array);
+        for(auto entry = first + status_array_capacity; entry-- > first;) {
+            _free_status_entries.push_back(entry);
+        }
+    }
+
+    const auto entry = _free_status_entries.back();
+    _free_status_entries.pop_back();
+    return entry;
+}
+
+void dstorage_backend::poll(std::vector<read_completion>& completions) {
+    const auto completed_value = _fence->GetCompletedValue();
+
+    while(!_batches.empty() && _batches.front().fence_value <= completed_value) {
+        // The queue's failure count is cumulative, so batches retiring together couldn't tell their failures apart
+        const auto status_entry = _batches.front().status_entry;
+        const auto success = SUCCEEDED(_status_arrays[status_entry / status_array_capacity]->GetHResult(status_entry % status_array_capacity));
+        _free_status_entries.push_back(status_entry);
+
+        for(const auto user_data : _batches.front().user_data) {
+            completions.push_back(read_completion {
+                .user_data = user_data,
+                .success = success
+            });
+        }
+
+        _batches.pop_front();
+    }
+}
+
+void dstorage_backend::wait() {
+    if(_batches.empty()) {
+        return;
+    }
+
+    const auto fence_value = _batches.front().fence_value;
+    _fence->SetEventOnCompletion(fence_value, _fence_event);
+    if(_fence->GetCompletedValue() < fence_value) {
+        WaitForSingleObject(_fence_event, INFINITE);
+    }
+}
+
+size_t dstorage_backend::in_flight() const {
+    size_t count = _queued_user_data.size();
+    for(const auto& batch : _batches) {
+        count += batch.user_data.size();
+    }
+    return count;
+}
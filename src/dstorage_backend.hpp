@@ -0,0 +1,60 @@
+#pragma once
+
+#include "d3d12_utils.hpp"
+#include "storage_backend.hpp"
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+// storage_backend on top of a DirectStorage queue with memory destinations. Each submit() is followed
+// by a fence signal, and requests complete together with the batch they were submitted in; a status
+// entry enqueued with every batch tells whether any of its reads failed. Requests larger than
+// dstorage_max_request_size go to the queue as several pieces that it reads in parallel.
+class dstorage_backend final : public storage_backend {
+public:
+    dstorage_backend(IDStorageFactory* dstorage_factory, ID3D12Device* d3d12_device);
+    ~dstorage_backend() override;
+
+    uint64_t open_file(const std::filesystem::path& path) override;
+    uint64_t file_size(uint64_t file) const override;
+    void close_file(uint64_t file) override;
+
+    void enqueue(const read_request& request) override;
+    void submit() override;
+    void poll(std::vector<read_completion>& completions) override;
+    void wait() override;
+
+    size_t in_flight() const override;
+
+private:
+    struct open_file_entry {
+        IDStorageFile* file;
+        uint64_t size;
+    };
+
+    struct submitted_batch {
+        uint64_t fence_value;
+        uint32_t status_entry;
+        std::vector<uint64_t> user_data;
+    };
+
+    // Status entries are reused once their batch retires; the arrays can't grow, so more are added as needed
+    static constexpr uint32_t status_array_capacity = 256;
+
+    uint32_t acquire_status_entry();
+
+    IDStorageFactory* _dstorage_factory;
+    IDStorageQueue* _dstorage_queue = nullptr;
+    ID3D12Fence* _fence = nullptr;
+    HANDLE _fence_event = nullptr;
+    uint64_t _fence_value = 0;
+
+    std::vector<IDStorageStatusArray*> _status_arrays;
+    std::vector<uint32_t> _free_status_entries;
+
+    std::unordered_map<uint64_t, open_file_entry> _files;
+    uint64_t _next_file = 1;
+
+    std::vector<uint64_t> _queued_user_data;
+    std::deque<submitted_batch> _batches;
+};
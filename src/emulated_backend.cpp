@@ -0,0 +1,240 @@
+#include "emulated_backend.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <format>
+#include <stdexcept>
+#include <thread>
+
+emulated_storage_desc emulated_storage_preset(std::string_view name) {
+    using namespace std::chrono_literals;
+
+    if(name == "nvme") {
+        return emulated_storage_desc {
+            .distribution = latency_distribution::lognormal,
+            .latency = 80us,
+            .latency_sigma = 0.3,
+            .bandwidth = 3500ull * 1000 * 1000,
+            .queue_depth = 64
+        };
+    }
+
+    if(name == "sata") {
+        return emulated_storage_desc {
+            .distribution = latency_distribution::lognormal,
+            .latency = 150us,
+            .latency_sigma = 0.4,
+            .bandwidth = 550ull * 1000 * 1000,
+            .queue_depth = 32
+        };
+    }
+
+    // 7200 rpm: half a revolution on average, plus a seek whenever the head has to move
+    if(name == "hdd") {
+        return emulated_storage_desc {
+            .distribution = latency_distribution::uniform,
+            .latency = 4170us,
+            .latency_spread = 4170us,
+            .bandwidth = 160ull * 1000 * 1000,
+            .queue_depth = 1,
+            .seek_penalty = 8ms
+        };
+    }
+
+    throw std::runtime_error(std::format("Unknown storage preset {}, expected nvme, sata or hdd", name));
+}
+
+emulated_backend::emulated_backend(storage_backend& backend, const emulated_storage_desc& desc)
+    : _backend(backend), _desc(desc), _random(desc.seed), _slots(std::max(desc.queue_depth, 1u)) {
+}
+
+uint64_t emulated_backend::open_file(const std::filesystem::path& path) {
+    const auto file = _backend.open_file(path);
+    if(!_desc.ram_source) {
+        return file;
+    }
+
+    // Loaded through the wrapped backend without any emulated cost; request ids start at 1, so 0 marks the load
+    auto& data = _ram_files[file];
+    data = host_buffer(_backend.file_size(file), _desc.huge_pages);
+
+    _backend.enqueue(read_request {
+        .file = file,
+        .offset = 0,
+        .size = data.size(),
+        .destination = data.data(),
+        .user_data = 0
+    });
+    _backend.submit();
+
+    _ram_load_result.reset();
+    while(!_ram_load_result) {
+        _backend.wait();
+        collect_backend_completions();
+    }
+
+    if(!*_ram_load_result) {
+        _ram_files.erase(file);
+        _backend.close_file(file);
+        throw std::runtime_error(std::format("Failed to load {} into memory", path.string()));
+    }
+
+    return file;
+}
+
+void emulated_backend::close_file(uint64_t file) {
+    _ram_files.erase(file);
+    _backend.close_file(file);
+}
+
+emulated_backend::clock::duration emulated_backend::sample_latency() {
+    const auto latency = std::chrono::duration<double, std::micro>(_desc.latency).count();
+
+    double sample;
+    switch(_desc.distribution) {
+        case latency_distribution::uniform: {
+            const auto spread = std::chrono::duration<double, std::micro>(_desc.latency_spread).count();
+            sample = std::uniform_real_distribution<double>(latency - spread, latency + spread)(_random);
+            break;
+        }
+        case latency_distribution::lognormal:
+            sample = latency > 0.0 ? std::lognormal_distribution<double>(std::log(latency), _desc.latency_sigma)(_random) : 0.0;
+            break;
+        default:
+            sample = latency;
+            break;
+    }
+
+    return std::chrono::duration_cast<clock::duration>(std::chrono::duration<double, std::micro>(std::max(sample, 0.0)));
+}
+
+emulated_backend::clock::time_point emulated_backend::schedule(const read_request& request, clock::time_point now) {
+    auto slot = std::min_element(_slots.begin(), _slots.end());
+    if(*slot > now) {
+        _stats.queued_requests++;
+    }
+
+    auto access_end = std::max(*slot, now) + sample_latency();
+    if(request.file != _head_file || request.offset != _head_offset) {
+        _stats.seeks++;
+        access_end += _desc.seek_penalty;
+    }
+    _head_file = request.file;
+    _head_offset = request.offset + request.size;
+
+    auto transfer_end = access_end;
+    if(_desc.bandwidth > 0) {
+        const auto transfer_time = std::chrono::duration<double>(static_cast<double>(request.size) / static_cast<double>(_desc.bandwidth));
+        transfer_end = std::max(access_end, _pipe_free) + std::chrono::duration_cast<clock::duration>(transfer_time);
+        _pipe_free = transfer_end;
+    }
+
+    *slot = transfer_end;
+    return transfer_end;
+}
+
+void emulated_backend::submit() {
+    const auto now = clock::now();
+
+    for(const auto& request : _queued) {
+        const auto request_id = _next_request_id++;
+
+        _stats.requests++;
+        _stats.bytes += request.size;
+
+        auto& emulated = _requests[request_id] = emulated_request {
+            .user_data = request.user_data,
+            .due = schedule(request, now)
+        };
+
+        const auto ram_file = _ram_files.find(request.file);
+        if(ram_file != _ram_files.end()) {
+            const auto& data = ram_file->second;
+            emulated.arrived = true;
+            emulated.success = request.offset <= data.size() && request.size <= data.size() - request.offset;
+            if(emulated.success) {
+                memcpy(request.destination, data.data() + request.offset, request.size);
+            }
+            continue;
+        }
+
+        auto backend_request = request;
+        backend_request.user_data = request_id;
+        _backend.enqueue(backend_request);
+    }
+
+    _queued.clear();
+    _backend.submit();
+}
+
+void emulated_backend::collect_backend_completions() {
+    _backend_completions.clear();
+    _backend.poll(_backend_completions);
+
+    for(const auto& backend_completion : _backend_completions) {
+        if(backend_completion.user_data == 0) {
+            _ram_load_result = backend_completion.success;
+            continue;
+        }
+
+        const auto it = _requests.find(backend_completion.user_data);
+        if(it != _requests.end()) {
+            it->second.arrived = true;
+            it->second.success = backend_completion.success;
+        }
+    }
+}
+
+void emulated_backend::poll(std::vector<read_completion>& completions) {
+    collect_backend_completions();
+
+    const auto now = clock::now();
+
+    for(auto it = _requests.begin(); it != _requests.end();) {
+        if(it->second.arrived && it->second.due <= now) {
+            _ready.push_back(it->second);
+            it = _requests.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    // Handed out in the order the device model finished them
+    std::sort(_ready.begin(), _ready.end(), [](const emulated_request& a, const emulated_request& b) { return a.due < b.due; });
+
+    for(const auto& emulated : _ready) {
+        completions.push_back(read_completion {
+            .user_data = emulated.user_data,
+            .success = emulated.success
+        });
+    }
+    _ready.clear();
+}
+
+void emulated_backend::wait() {
+    collect_backend_completions();
+
+    for(;;) {
+        auto earliest = clock::time_point::max();
+        auto waiting_for_backend = false;
+        for(const auto& [id, emulated] : _requests) {
+            if(emulated.arrived) {
+                earliest = std::min(earliest, emulated.due);
+            } else {
+                waiting_for_backend = true;
+            }
+        }
+
+        if(earliest != clock::time_point::max()) {
+            std::this_thread::sleep_until(earliest);
+            return;
+        }
+
+        if(!waiting_for_backend) {
+            return;
+        }
+
+        _backend.wait();
+        collect_backend_completions();
+    }
+}
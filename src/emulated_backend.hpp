@@ -0,0 +1,104 @@
+#pragma once
+
+#include "host_memory.hpp"
+#include "storage_backend.hpp"
+#include <chrono>
+#include <optional>
+#include <random>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+enum class latency_distribution {
+    fixed,
+    uniform,
+    lognormal
+};
+
+struct emulated_storage_desc {
+    // Per-request access time before the transfer starts. uniform spreads it by +-latency_spread,
+    // lognormal takes latency as the median and latency_sigma as the shape
+    latency_distribution distribution = latency_distribution::fixed;
+    std::chrono::microseconds latency = std::chrono::microseconds(0);
+    std::chrono::microseconds latency_spread = std::chrono::microseconds(0);
+    double latency_sigma = 0.5;
+    // Bytes per second shared by all requests; 0 is unlimited
+    uint64_t bandwidth = 0;
+    // Requests the device works on at once; the rest wait for a slot
+    uint32_t queue_depth = 1;
+    // Added when a request doesn't start where the previous one ended
+    std::chrono::microseconds seek_penalty = std::chrono::microseconds(0);
+    // Serve reads from a copy of each file loaded at open_file() instead of the wrapped backend
+    bool ram_source = false;
+    huge_page_mode huge_pages = huge_page_mode::automatic;
+    uint64_t seed = 1;
+};
+
+struct emulated_storage_stats {
+    uint64_t requests;
+    uint64_t bytes;
+    uint64_t seeks;
+    uint64_t queued_requests;
+};
+
+// nvme, sata or hdd; throws for anything else
+emulated_storage_desc emulated_storage_preset(std::string_view name);
+
+// Sits in front of another backend and makes it behave like a slower device. Every submitted request
+// is scheduled on a model of the device: it waits for one of queue_depth slots, pays the sampled
+// latency plus the seek penalty, then transfers through a pipe limited to bandwidth. The data is still
+// read by the wrapped backend (or copied from RAM), but its completion is held back until the modelled
+// time has passed. The model is driven by a seeded generator, so the same request stream gets the same
+// timing on every run.
+class emulated_backend final : public storage_backend {
+public:
+    emulated_backend(storage_backend& backend, const emulated_storage_desc& desc);
+
+    uint64_t open_file(const std::filesystem::path& path) override;
+    uint64_t file_size(uint64_t file) const override { return _backend.file_size(file); }
+    void close_file(uint64_t file) override;
+
+    void enqueue(const read_request& request) override { _queued.push_back(request); }
+    void submit() override;
+    void poll(std::vector<read_completion>& completions) override;
+    void wait() override;
+
+    size_t in_flight() const override { return _requests.size() + _queued.size(); }
+
+    const emulated_storage_stats& stats() const { return _stats; }
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    struct emulated_request {
+        uint64_t user_data;
+        clock::time_point due;
+        bool arrived;
+        bool success;
+    };
+
+    clock::duration sample_latency();
+    clock::time_point schedule(const read_request& request, clock::time_point now);
+    void collect_backend_completions();
+
+    storage_backend& _backend;
+    emulated_storage_desc _desc;
+    std::mt19937_64 _random;
+
+    std::unordered_map<uint64_t, host_buffer> _ram_files;
+    std::optional<bool> _ram_load_result;
+
+    std::vector<read_request> _queued;
+    std::unordered_map<uint64_t, emulated_request> _requests;
+    std::vector<emulated_request> _ready;
+    uint64_t _next_request_id = 1;
+    std::vector<read_completion> _backend_completions;
+
+    // Times at which each device slot and the transfer pipe become free
+    std::vector<clock::time_point> _slots;
+    clock::time_point _pipe_free = {};
+    uint64_t _head_file = 0;
+    uint64_t _head_offset = 0;
+
+    emulated_storage_stats _stats = {};
+};
@@ -0,0 +1,294 @@
+#include "host_memory.hpp"
+#include <atomic>
+#include <format>
+#include <fstream>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    std::atomic<uint64_t> live_buffers;
+    std::atomic<uint64_t> live_bytes;
+    std::atomic<uint64_t> explicit_bytes;
+    std::atomic<uint64_t> transparent_bytes;
+    std::atomic<uint64_t> fallbacks;
+
+    // Smaller buffers placed on a node still come from the heap: a mapping each would run into the
+    // process's mapping limit, and a pinned thread's heap allocations come from its node anyway
+    constexpr size_t min_node_mapping_size = 64 * 1024;
+
+    size_t align_up(size_t value, size_t alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+#ifndef _WIN32
+    // MAP_HUGE_2MB from linux/mman.h: log2 of the page size in the bits above MAP_HUGE_SHIFT
+    constexpr int map_huge_2mb = 21 << MAP_HUGE_SHIFT;
+
+    bool transparent_huge_pages_enabled() {
+        // "always [madvise] never": madvise() only helps unless the kernel says never
+        static const bool enabled = [] {
+            std::ifstream file("/sys/kernel/mm/transparent_hugepage/enabled");
+            std::string setting;
+            return std::getline(file, setting) && setting.find("[never]") == std::string::npos;
+        }();
+        return enabled;
+    }
+#endif
+}
+
+huge_page_mode parse_huge_page_mode(std::string_view name) {
+    if(name == "auto" || name == "automatic") {
+        return huge_page_mode::automatic;
+    }
+    if(name == "transparent") {
+        return huge_page_mode::transparent;
+    }
+    if(name == "off") {
+        return huge_page_mode::off;
+    }
+
+    throw std::runtime_error(std::format("Unknown huge page mode {}, expected auto, transparent or off", name));
+}
+
+host_memory_stats host_memory_statistics() {
+    return host_memory_stats {
+        .buffers = live_buffers.load(std::memory_order_relaxed),
+        .bytes = live_bytes.load(std::memory_order_relaxed),
+        .explicit_huge_page_bytes = explicit_bytes.load(std::memory_order_relaxed),
+        .transparent_huge_page_bytes = transparent_bytes.load(std::memory_order_relaxed),
+        .fallbacks = fallbacks.load(std::memory_order_relaxed)
+    };
+}
+
+uint64_t resident_transparent_huge_page_bytes() {
+#ifdef _WIN32
+    return 0;
+#else
+    std::ifstream file("/proc/self/smaps_rollup");
+    std::string line;
+    while(std::getline(file, line)) {
+        if(line.starts_with("AnonHugePages:")) {
+            return std::stoull(line.substr(line.find(':') + 1)) * 1024;
+        }
+    }
+    return 0;
+#endif
+}
+
+host_buffer::host_buffer(size_t size, huge_page_mode mode, int32_t numa_node) : _size(size) {
+    if(size == 0) {
+        return;
+    }
+
+    if(mode != huge_page_mode::off && size >= huge_page_size) {
+        const auto placed = (mode == huge_page_mode::automatic && map_explicit_pages(numa_node)) || map_transparent_pages();
+        if(!placed) {
+            fallbacks.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // Heap memory may share pages with other allocations, so only whole mappings can be placed on a node
+    if(!_data && !(numa_node >= 0 && size >= min_node_mapping_size && map_pages(numa_node))) {
+        _data = static_cast<uint8_t*>(::operator new[](size, std::align_val_t(alignment)));
+        _backing = backing::heap;
+    }
+
+    if(numa_node >= 0 && _backing != backing::heap) {
+        bind_to_node(numa_node);
+    }
+
+    live_buffers.fetch_add(1, std::memory_order_relaxed);
+    live_bytes.fetch_add(_size, std::memory_order_relaxed);
+    if(_backing == backing::explicit_pages) {
+        explicit_bytes.fetch_add(_size, std::memory_order_relaxed);
+    } else if(_backing == backing::transparent_pages) {
+        transparent_bytes.fetch_add(_size, std::memory_order_relaxed);
+    }
+}
+
+host_buffer::~host_buffer() {
+    release();
+}
+
+host_buffer::host_buffer(host_buffer&& other) noexcept
+    : _data(std::exchange(other._data, nullptr)), _size(std::exchange(other._size, 0)), _mapped_size(std::exchange(other._mapped_size, 0)),
+      _backing(std::exchange(other._backing, backing::heap)) {
+}
+
+host_buffer& host_buffer::operator=(host_buffer&& other) noexcept {
+    if(this != &other) {
+        release();
+        _data = std::exchange(other._data, nullptr);
+        _size = std::exchange(other._size, 0);
+        _mapped_size = std::exchange(other._mapped_size, 0);
+        _backing = std::exchange(other._backing, backing::heap);
+    }
+    return *this;
+}
+
+void host_buffer::release() {
+    if(!_data) {
+        return;
+    }
+
+    live_buffers.fetch_sub(1, std::memory_order_relaxed);
+    live_bytes.fetch_sub(_size, std::memory_order_relaxed);
+
+    switch(_backing) {
+        case backing::heap:
+            ::operator delete[](_data, std::align_val_t(alignment));
+            break;
+        case backing::pages:
+#ifdef _WIN32
+            VirtualFree(_data, 0, MEM_RELEASE);
+#else
+            munmap(_data, _mapped_size);
+#endif
+            break;
+        case backing::explicit_pages:
+            explicit_bytes.fetch_sub(_size, std::memory_order_relaxed);
+#ifdef _WIN32
+            VirtualFree(_data, 0, MEM_RELEASE);
+#else
+            munmap(_data, _mapped_size);
+#endif
+            break;
+        case backing::transparent_pages:
+            transparent_bytes.fetch_sub(_size, std::memory_order_relaxed);
+#ifndef _WIN32
+            munmap(_data, _mapped_size);
+#endif
+            break;
+    }
+
+    _data = nullptr;
+}
+
+#ifdef _WIN32
+
+bool host_buffer::map_explicit_pages(int32_t numa_node) {
+    // Large pages need SeLockMemoryPrivilege; without it the allocation fails and the heap takes over
+    const auto large_page_size = GetLargePageMinimum();
+    if(large_page_size == 0) {
+        return false;
+    }
+
+    const auto mapped_size = align_up(_size, large_page_size);
+    const auto node = numa_node >= 0 ? static_cast<DWORD>(numa_node) : NUMA_NO_PREFERRED_NODE;
+    auto* data = VirtualAllocExNuma(GetCurrentProcess(), nullptr, mapped_size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE, node);
+    if(!data) {
+        return false;
+    }
+
+    _data = static_cast<uint8_t*>(data);
+    _mapped_size = mapped_size;
+    _backing = backing::explicit_pages;
+    return true;
+}
+
+bool host_buffer::map_transparent_pages() {
+    return false;
+}
+
+bool host_buffer::map_pages(int32_t numa_node) {
+    auto* data = VirtualAllocExNuma(GetCurrentProcess(), nullptr, _size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE, static_cast<DWORD>(numa_node));
+    if(!data) {
+        return false;
+    }
+
+    _data = static_cast<uint8_t*>(data);
+    _mapped_size = _size;
+    _backing = backing::pages;
+    return true;
+}
+
+void host_buffer::bind_to_node(int32_t) {
+    // VirtualAllocExNuma already placed the pages
+}
+
+#else
+
+bool host_buffer::map_explicit_pages(int32_t) {
+    // Only succeeds while the reserved pool (vm.nr_hugepages) has enough free pages; the reservation is
+    // taken here, so touching the pages later can't fail
+    const auto mapped_size = align_up(_size, huge_page_size);
+    auto* data = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | map_huge_2mb, -1, 0);
+    if(data == MAP_FAILED) {
+        return false;
+    }
+
+    _data = static_cast<uint8_t*>(data);
+    _mapped_size = mapped_size;
+    _backing = backing::explicit_pages;
+    return true;
+}
+
+bool host_buffer::map_transparent_pages() {
+    if(!transparent_huge_pages_enabled()) {
+        return false;
+    }
+
+    // Huge pages can only back 2 MiB aligned ranges, so reserve one extra and trim both ends
+    const auto mapped_size = align_up(_size, huge_page_size);
+    const auto reserved_size = mapped_size + huge_page_size;
+    auto* reserved = mmap(nullptr, reserved_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(reserved == MAP_FAILED) {
+        return false;
+    }
+
+    const auto start = reinterpret_cast<uintptr_t>(reserved);
+    const auto aligned = align_up(start, huge_page_size);
+    if(aligned > start) {
+        munmap(reserved, aligned - start);
+    }
+    if(start + reserved_size > aligned + mapped_size) {
+        munmap(reinterpret_cast<void*>(aligned + mapped_size), start + reserved_size - (aligned + mapped_size));
+    }
+
+    auto* data = reinterpret_cast<void*>(aligned);
+    if(madvise(data, mapped_size, MADV_HUGEPAGE) != 0) {
+        munmap(data, mapped_size);
+        return false;
+    }
+
+    _data = static_cast<uint8_t*>(data);
+    _mapped_size = mapped_size;
+    _backing = backing::transparent_pages;
+    return true;
+}
+
+bool host_buffer::map_pages(int32_t) {
+    const auto mapped_size = align_up(_size, alignment);
+    auto* data = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(data == MAP_FAILED) {
+        return false;
+    }
+
+    _data = static_cast<uint8_t*>(data);
+    _mapped_size = mapped_size;
+    _backing = backing::pages;
+    return true;
+}
+
+void host_buffer::bind_to_node(int32_t numa_node) {
+    // Before the first touch, so every page is allocated there; raw system calls keep libnuma out of the build
+    constexpr int mpol_preferred = 1;
+
+    unsigned long node_mask[16] = {};
+    if(static_cast<size_t>(numa_node) < sizeof(node_mask) * 8) {
+        node_mask[numa_node / 64] = 1ul << (numa_node % 64);
+        syscall(SYS_mbind, _data, _mapped_size, mpol_preferred, node_mask, sizeof(node_mask) * 8, 0);
+    }
+}
+
+#endif
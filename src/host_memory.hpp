@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+enum class huge_page_mode {
+    // Explicit huge pages from the reserved pool, then transparent huge pages, then normal pages
+    automatic,
+    // Transparent huge pages only; they need no reservation but the kernel backs them as it can
+    transparent,
+    off
+};
+
+struct host_memory_stats {
+    uint64_t buffers;
+    uint64_t bytes;
+    // Bytes of buffers on explicit huge pages (hugetlb on Linux, large pages on Windows)
+    uint64_t explicit_huge_page_bytes;
+    // Bytes of buffers advised for transparent huge pages; see resident_transparent_huge_page_bytes()
+    uint64_t transparent_huge_page_bytes;
+    // Buffers large enough for huge pages that got normal pages
+    uint64_t fallbacks;
+};
+
+// auto, transparent or off; throws for anything else
+huge_page_mode parse_huge_page_mode(std::string_view name);
+
+// Counters of all live host_buffers
+host_memory_stats host_memory_statistics();
+
+// Transparent huge pages the kernel has actually given the process (AnonHugePages), 0 where unknown
+uint64_t resident_transparent_huge_page_bytes();
+
+// Host memory for staging, decode and cache data that is copied through in bulk. Buffers of at least
+// huge_page_size are placed on 2 MiB pages where the system has them, so loops over hundreds of
+// megabytes take one TLB entry per 2 MiB instead of per 4 KiB; smaller buffers, and large ones where no
+// huge page is available, come from the heap. A buffer of 64 KiB or more given a numa_node gets its
+// pages from that node (preferred, so a full node spills over) instead of from whichever thread touches
+// it first. Every buffer is aligned for direct I/O, and the contents start out undefined.
+class host_buffer {
+public:
+    static constexpr size_t huge_page_size = 2 * 1024 * 1024;
+    static constexpr size_t alignment = 4096;
+
+    host_buffer() = default;
+    explicit host_buffer(size_t size, huge_page_mode mode = huge_page_mode::automatic, int32_t numa_node = -1);
+    ~host_buffer();
+
+    host_buffer(host_buffer&& other) noexcept;
+    host_buffer& operator=(host_buffer&& other) noexcept;
+
+    host_buffer(const host_buffer&) = delete;
+    host_buffer& operator=(const host_buffer&) = delete;
+
+    uint8_t* data() const { return _data; }
+    size_t size() const { return _size; }
+    bool huge_pages() const { return _backing == backing::explicit_pages || _backing == backing::transparent_pages; }
+
+private:
+    enum class backing {
+        heap,
+        pages,
+        explicit_pages,
+        transparent_pages
+    };
+
+    bool map_explicit_pages(int32_t numa_node);
+    bool map_transparent_pages();
+    bool map_pages(int32_t numa_node);
+    void bind_to_node(int32_t numa_node);
+    void release();
+
+    uint8_t* _data = nullptr;
+    size_t _size = 0;
+    size_t _mapped_size = 0;
+    backing _backing = backing::heap;
+};
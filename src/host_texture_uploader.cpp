@@ -0,0 +1,471 @@
+#include "host_texture_uploader.hpp"
+#include <algorithm>
+#include <cstring>
+#include <format>
+#include <limits>
+#include <stdexcept>
+
+void host_texture_uploader::enable_device_features(VkPhysicalDevice physical_device, const host_upload_desc& desc, std::vector<const char*>& enabled_device_extensions,
+                                                   VkPhysicalDeviceFeatures2& physical_device_features) {
+    _desc = desc;
+
+    uint32_t num_extensions;
+    throw_if_failed(vkEnumerateDeviceExtensionProperties(physical_device, nullptr, &num_extensions, nullptr), "vkEnumerateDeviceExtensionProperties");
+
+    std::vector<VkExtensionProperties> extensions(num_extensions);
+    throw_if_failed(vkEnumerateDeviceExtensionProperties(physical_device, nullptr, &num_extensions, extensions.data()), "vkEnumerateDeviceExtensionProperties");
+
+    const auto supports_extension = [&](const char* name) {
+        return std::any_of(extensions.begin(), extensions.end(), [name](const VkExtensionProperties& extension) { return strcmp(extension.extensionName, name) == 0; });
+    };
+
+    if(desc.import_host_memory && supports_extension(VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME)) {
+        enabled_device_extensions.push_back(VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME);
+        _import_host_memory = true;
+    }
+
+#ifdef VK_EXT_host_image_copy
+    if(desc.host_image_copy && supports_extension(VK_EXT_HOST_IMAGE_COPY_EXTENSION_NAME)) {
+        VkPhysicalDeviceHostImageCopyFeaturesEXT supported_host_image_copy_features = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_IMAGE_COPY_FEATURES_EXT
+        };
+
+        VkPhysicalDeviceFeatures2 supported_features = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+            .pNext = &supported_host_image_copy_features
+        };
+
+        vkGetPhysicalDeviceFeatures2(physical_device, &supported_features);
+
+        if(supported_host_image_copy_features.hostImageCopy) {
+            enabled_device_extensions.push_back(VK_EXT_HOST_IMAGE_COPY_EXTENSION_NAME);
+
+            _host_image_copy_features = {
+                .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_IMAGE_COPY_FEATURES_EXT,
+                .pNext = physical_device_features.pNext,
+                .hostImageCopy = VK_TRUE
+            };
+            physical_device_features.pNext = &_host_image_copy_features;
+
+            _host_image_copy = true;
+        }
+    }
+#endif
+}
+
+void host_texture_uploader::create(VkPhysicalDevice physical_device, VkDevice device, VkQueue queue, uint32_t queue_family_index) {
+    _physical_device = physical_device;
+    _device = device;
+    _queue = queue;
+
+    if(_import_host_memory) {
+        VkPhysicalDeviceExternalMemoryHostPropertiesEXT external_memory_host_properties = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_MEMORY_HOST_PROPERTIES_EXT
+        };
+
+        VkPhysicalDeviceProperties2 physical_device_properties = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+            .pNext = &external_memory_host_properties
+        };
+
+        vkGetPhysicalDeviceProperties2(physical_device, &physical_device_properties);
+        _import_alignment = external_memory_host_properties.minImportedHostPointerAlignment;
+    }
+
+#ifdef VK_EXT_host_image_copy
+    if(_host_image_copy) {
+        _copy_memory_to_image = reinterpret_cast<PFN_vkCopyMemoryToImageEXT>(vkGetDeviceProcAddr(device, "vkCopyMemoryToImageEXT"));
+        _transition_image_layout = reinterpret_cast<PFN_vkTransitionImageLayoutEXT>(vkGetDeviceProcAddr(device, "vkTransitionImageLayoutEXT"));
+
+        VkFormatProperties3 format_properties3 = {
+            .sType = VK_STRUCTURE_TYPE_FORMAT_PROPERTIES_3
+        };
+
+        VkFormatProperties2 format_properties = {
+            .sType = VK_STRUCTURE_TYPE_FORMAT_PROPERTIES_2,
+            .pNext = &format_properties3
+        };
+
+        vkGetPhysicalDeviceFormatProperties2(physical_device, VK_FORMAT_R8G8B8A8_UNORM, &format_properties);
+
+        VkPhysicalDeviceHostImageCopyPropertiesEXT host_image_copy_properties = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_IMAGE_COPY_PROPERTIES_EXT
+        };
+
+        VkPhysicalDeviceProperties2 physical_device_properties = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+            .pNext = &host_image_copy_properties
+        };
+
+        vkGetPhysicalDeviceProperties2(physical_device, &physical_device_properties);
+
+        std::vector<VkImageLayout> copy_dst_layouts(host_image_copy_properties.copyDstLayoutCount);
+        host_image_copy_properties.pCopyDstLayouts = copy_dst_layouts.data();
+        vkGetPhysicalDeviceProperties2(physical_device, &physical_device_properties);
+
+        // Images are written and sampled in SHADER_READ_ONLY_OPTIMAL, so the host path is only used
+        // when the device can copy into that layout
+        _host_image_copy = _copy_memory_to_image && _transition_image_layout &&
+                           (format_properties3.optimalTilingFeatures & VK_FORMAT_FEATURE_2_HOST_IMAGE_TRANSFER_BIT_EXT) &&
+                           std::find(copy_dst_layouts.begin(), copy_dst_layouts.end(), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) != copy_dst_layouts.end();
+    }
+#endif
+
+    VkCommandPoolCreateInfo command_pool_create_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+        .queueFamilyIndex = queue_family_index
+    };
+
+    throw_if_failed(vkCreateCommandPool(device, &command_pool_create_info, nullptr, &_command_pool), "vkCreateCommandPool");
+
+    VkCommandBufferAllocateInfo command_buffer_allocate_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = _command_pool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1
+    };
+
+    throw_if_failed(vkAllocateCommandBuffers(device, &command_buffer_allocate_info, &_command_buffer), "vkAllocateCommandBuffers");
+
+    VkFenceCreateInfo fence_create_info = {
+        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO
+    };
+
+    throw_if_failed(vkCreateFence(device, &fence_create_info, nullptr, &_fence), "vkCreateFence");
+}
+
+void host_texture_uploader::destroy() {
+    vkDestroyFence(_device, _fence, nullptr);
+    vkFreeCommandBuffers(_device, _command_pool, 1, &_command_buffer);
+    vkDestroyCommandPool(_device, _command_pool, nullptr);
+}
+
+host_texture host_texture_uploader::upload(const mapped_file& file, uint64_t offset, uint32_t width, uint32_t height) {
+    const uint64_t size = static_cast<uint64_t>(width) * height * 4;
+    if(offset + size > file.size()) {
+        throw std::runtime_error(std::format("Texture region {}+{} exceeds the file size {}", offset, size, file.size()));
+    }
+
+    return upload_region(file.data(), file.mapped_size(), offset, width, height);
+}
+
+host_texture host_texture_uploader::upload(std::span<const uint8_t> texels, uint32_t width, uint32_t height) {
+    const uint64_t size = static_cast<uint64_t>(width) * height * 4;
+    if(size > texels.size()) {
+        throw std::runtime_error(std::format("Texture of {} bytes exceeds the {} bytes given", size, texels.size()));
+    }
+
+    return upload_region(texels.data(), texels.size(), 0, width, height);
+}
+
+host_texture host_texture_uploader::upload_region(const uint8_t* base, uint64_t readable_size, uint64_t offset, uint32_t width, uint32_t height) {
+    const uint64_t size = static_cast<uint64_t>(width) * height * 4;
+
+#ifdef VK_EXT_host_image_copy
+    if(_host_image_copy && size <= _desc.host_image_copy_max_size) {
+        const auto texture = create_texture(width, height, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_HOST_TRANSFER_BIT_EXT);
+        copy_on_host(base + offset, texture.image, width, height);
+
+        _host_image_copies++;
+        _bytes_uploaded += size;
+
+        return texture;
+    }
+#endif
+
+    const auto texture = create_texture(width, height, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+
+    source_buffer source;
+    if(import_region(base, readable_size, offset, size, source)) {
+        _zero_copy_uploads++;
+    } else {
+        source = stage_region(base + offset, size);
+        _staged_uploads++;
+    }
+
+    copy_to_image(source, texture.image, width, height);
+
+    vkDestroyBuffer(_device, source.buffer, nullptr);
+    vkFreeMemory(_device, source.memory, nullptr);
+
+    _bytes_uploaded += size;
+
+    return texture;
+}
+
+host_texture host_texture_uploader::create_texture(uint32_t width, uint32_t height, VkImageUsageFlags usage) {
+    VkImageCreateInfo image_create_info = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .format = VK_FORMAT_R8G8B8A8_UNORM,
+        .extent = { .width = width, .height = height, .depth = 1 },
+        .mipLevels = 1,
+        .arrayLayers = 1,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .usage = usage
+    };
+
+    host_texture texture = {
+        .size_bytes = static_cast<uint64_t>(width) * height * 4
+    };
+
+    throw_if_failed(vkCreateImage(_device, &image_create_info, nullptr, &texture.image), "vkCreateImage");
+
+    VkMemoryRequirements memory_requirements;
+    vkGetImageMemoryRequirements(_device, texture.image, &memory_requirements);
+
+    VkMemoryAllocateInfo memory_allocate_info = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .allocationSize = memory_requirements.size,
+        .memoryTypeIndex = find_memory_type(_physical_device, memory_requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
+    };
+
+    throw_if_failed(vkAllocateMemory(_device, &memory_allocate_info, nullptr, &texture.memory), "vkAllocateMemory");
+    throw_if_failed(vkBindImageMemory(_device, texture.image, texture.memory, 0), "vkBindImageMemory");
+
+    VkImageViewCreateInfo image_view_create_info = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .image = texture.image,
+        .viewType = VK_IMAGE_VIEW_TYPE_2D,
+        .format = VK_FORMAT_R8G8B8A8_UNORM,
+        .components = VkComponentMapping {
+            .r = VK_COMPONENT_SWIZZLE_IDENTITY,
+            .g = VK_COMPONENT_SWIZZLE_IDENTITY,
+            .b = VK_COMPONENT_SWIZZLE_IDENTITY,
+            .a = VK_COMPONENT_SWIZZLE_IDENTITY
+        },
+        .subresourceRange = VkImageSubresourceRange {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .levelCount = 1,
+            .layerCount = 1
+        }
+    };
+
+    throw_if_failed(vkCreateImageView(_device, &image_view_create_info, nullptr, &texture.image_view), "vkCreateImageView");
+
+    return texture;
+}
+
+#ifdef VK_EXT_host_image_copy
+void host_texture_uploader::copy_on_host(const uint8_t* texels, VkImage image, uint32_t width, uint32_t height) {
+    const VkImageSubresourceRange subresource_range = {
+        .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+        .levelCount = 1,
+        .layerCount = 1
+    };
+
+    VkHostImageLayoutTransitionInfoEXT host_image_layout_transition_info = {
+        .sType = VK_STRUCTURE_TYPE_HOST_IMAGE_LAYOUT_TRANSITION_INFO_EXT,
+        .image = image,
+        .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        .subresourceRange = subresource_range
+    };
+
+    throw_if_failed(_transition_image_layout(_device, 1, &host_image_layout_transition_info), "vkTransitionImageLayoutEXT");
+
+    VkMemoryToImageCopyEXT memory_to_image_copy = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_TO_IMAGE_COPY_EXT,
+        .pHostPointer = texels,
+        .imageSubresource = {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .layerCount = 1
+        },
+        .imageExtent = { .width = width, .height = height, .depth = 1 }
+    };
+
+    VkCopyMemoryToImageInfoEXT copy_memory_to_image_info = {
+        .sType = VK_STRUCTURE_TYPE_COPY_MEMORY_TO_IMAGE_INFO_EXT,
+        .dstImage = image,
+        .dstImageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        .regionCount = 1,
+        .pRegions = &memory_to_image_copy
+    };
+
+    throw_if_failed(_copy_memory_to_image(_device, &copy_memory_to_image_info), "vkCopyMemoryToImageEXT");
+}
+#endif
+
+void host_texture_uploader::destroy_texture(const host_texture& texture) {
+    vkDestroyImageView(_device, texture.image_view, nullptr);
+    vkFreeMemory(_device, texture.memory, nullptr);
+    vkDestroyImage(_device, texture.image, nullptr);
+}
+
+host_upload_stats host_texture_uploader::stats() const {
+    return host_upload_stats {
+        .host_image_copies = _host_image_copies,
+        .zero_copy_uploads = _zero_copy_uploads,
+        .staged_uploads = _staged_uploads,
+        .import_fallbacks = _import_fallbacks,
+        .bytes_uploaded = _bytes_uploaded
+    };
+}
+
+bool host_texture_uploader::import_region(const uint8_t* base, uint64_t readable_size, uint64_t offset, uint64_t size, source_buffer& source) {
+    if(!_import_host_memory) {
+        return false;
+    }
+
+    // The imported range has to start and end on the import alignment and stay inside the readable
+    // memory, and the copy offset into it has to be a multiple of the texel size
+    const auto import_start = offset / _import_alignment * _import_alignment;
+    const auto import_end = (offset + size + _import_alignment - 1) / _import_alignment * _import_alignment;
+    if(reinterpret_cast<uintptr_t>(base) % _import_alignment != 0 || import_end > readable_size || offset % 4 != 0) {
+        _import_fallbacks++;
+        return false;
+    }
+
+    auto* host_pointer = const_cast<uint8_t*>(base) + import_start;
+    const auto import_size = import_end - import_start;
+
+    VkMemoryHostPointerPropertiesEXT memory_host_pointer_properties = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_HOST_POINTER_PROPERTIES_EXT
+    };
+
+    if(vkGetMemoryHostPointerPropertiesEXT(_device, VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT, host_pointer, &memory_host_pointer_properties) != VK_SUCCESS) {
+        _import_fallbacks++;
+        return false;
+    }
+
+    VkExternalMemoryBufferCreateInfo external_memory_buffer_create_info = {
+        .sType = VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_BUFFER_CREATE_INFO,
+        .handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT
+    };
+
+    VkBufferCreateInfo buffer_create_info = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .pNext = &external_memory_buffer_create_info,
+        .size = import_size,
+        .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE
+    };
+
+    throw_if_failed(vkCreateBuffer(_device, &buffer_create_info, nullptr, &source.buffer), "vkCreateBuffer");
+
+    VkMemoryRequirements memory_requirements;
+    vkGetBufferMemoryRequirements(_device, source.buffer, &memory_requirements);
+
+    const auto memory_type_bits = memory_requirements.memoryTypeBits & memory_host_pointer_properties.memoryTypeBits;
+    if(memory_type_bits == 0) {
+        vkDestroyBuffer(_device, source.buffer, nullptr);
+        _import_fallbacks++;
+        return false;
+    }
+
+    VkImportMemoryHostPointerInfoEXT import_memory_host_pointer_info = {
+        .sType = VK_STRUCTURE_TYPE_IMPORT_MEMORY_HOST_POINTER_INFO_EXT,
+        .handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT,
+        .pHostPointer = host_pointer
+    };
+
+    VkMemoryAllocateInfo memory_allocate_info = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .pNext = &import_memory_host_pointer_info,
+        .allocationSize = import_size,
+        .memoryTypeIndex = find_memory_type(_physical_device, memory_type_bits, 0)
+    };
+
+    // Some drivers refuse file-backed or read-only pages, which is only known once the import is tried
+    if(vkAllocateMemory(_device, &memory_allocate_info, nullptr, &source.memory) != VK_SUCCESS) {
+        vkDestroyBuffer(_device, source.buffer, nullptr);
+        _import_fallbacks++;
+        return false;
+    }
+
+    throw_if_failed(vkBindBufferMemory(_device, source.buffer, source.memory, 0), "vkBindBufferMemory");
+    source.offset = offset - import_start;
+
+    return true;
+}
+
+host_texture_uploader::source_buffer host_texture_uploader::stage_region(const uint8_t* texels, uint64_t size) {
+    source_buffer source = {};
+
+    VkBufferCreateInfo buffer_create_info = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = size,
+        .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE
+    };
+
+    throw_if_failed(vkCreateBuffer(_device, &buffer_create_info, nullptr, &source.buffer), "vkCreateBuffer");
+
+    VkMemoryRequirements memory_requirements;
+    vkGetBufferMemoryRequirements(_device, source.buffer, &memory_requirements);
+
+    VkMemoryAllocateInfo memory_allocate_info = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .allocationSize = memory_requirements.size,
+        .memoryTypeIndex = find_memory_type(_physical_device, memory_requirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+    };
+
+    throw_if_failed(vkAllocateMemory(_device, &memory_allocate_info, nullptr, &source.memory), "vkAllocateMemory");
+    throw_if_failed(vkBindBufferMemory(_device, source.buffer, source.memory, 0), "vkBindBufferMemory");
+
+    void* mapped;
+    throw_if_failed(vkMapMemory(_device, source.memory, 0, size, 0, &mapped), "vkMapMemory");
+    memcpy(mapped, texels, size);
+    vkUnmapMemory(_device, source.memory);
+
+    return source;
+}
+
+void host_texture_uploader::copy_to_image(const source_buffer& source, VkImage image, uint32_t width, uint32_t height) {
+    std::lock_guard lock(_queue_mutex);
+
+    VkCommandBufferBeginInfo command_buffer_begin_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+    };
+
+    throw_if_failed(vkBeginCommandBuffer(_command_buffer, &command_buffer_begin_info), "vkBeginCommandBuffer");
+
+    VkImageMemoryBarrier image_memory_barrier = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = 0,
+        .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .image = image,
+        .subresourceRange = VkImageSubresourceRange {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .levelCount = 1,
+            .layerCount = 1
+        }
+    };
+
+    vkCmdPipelineBarrier(_command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &image_memory_barrier);
+
+    VkBufferImageCopy buffer_image_copy = {
+        .bufferOffset = source.offset,
+        .imageSubresource = {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .layerCount = 1
+        },
+        .imageExtent = { .width = width, .height = height, .depth = 1 }
+    };
+
+    vkCmdCopyBufferToImage(_command_buffer, source.buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &buffer_image_copy);
+
+    image_memory_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    image_memory_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    image_memory_barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    image_memory_barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    vkCmdPipelineBarrier(_command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &image_memory_barrier);
+
+    throw_if_failed(vkEndCommandBuffer(_command_buffer), "vkEndCommandBuffer");
+
+    VkSubmitInfo submit_info = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &_command_buffer
+    };
+
+    throw_if_failed(vkQueueSubmit(_queue, 1, &submit_info, _fence), "vkQueueSubmit");
+    throw_if_failed(vkWaitForFences(_device, 1, &_fence, VK_TRUE, std::numeric_limits<uint64_t>::max()), "vkWaitForFences");
+    throw_if_failed(vkResetFences(_device, 1, &_fence), "vkResetFences");
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "mapped_file.hpp"
+#include "vulkan_utils.hpp"
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <span>
+#include <vector>
+
+struct host_texture {
+    VkImage image;
+    VkDeviceMemory memory;
+    VkImageView image_view;
+    uint64_t size_bytes;
+};
+
+struct host_upload_desc {
+    bool import_host_memory = true;
+    bool host_image_copy = true;
+    uint64_t host_image_copy_max_size = 1024 * 1024;
+};
+
+struct host_upload_stats {
+    uint64_t host_image_copies;
+    uint64_t zero_copy_uploads;
+    uint64_t staged_uploads;
+    uint64_t import_fallbacks;
+    uint64_t bytes_uploaded;
+};
+
+// Uploads texels that live in a memory-mapped file, or other host memory, into device-local images
+// without DirectStorage.
+// Textures up to host_image_copy_max_size are written straight from the mapping into the image with
+// VK_EXT_host_image_copy, without a buffer or a queue submission. Larger ones, or all of them when
+// that extension is missing, are copied with vkCmdCopyBufferToImage: when VK_EXT_external_memory_host
+// is enabled the pages around the texels are imported as the source buffer, otherwise, or when the
+// region or driver refuses the import, the texels go through a staging buffer first.
+// upload() may be called from several threads; buffer copies are submitted to the given queue one at
+// a time and waited for, so no other thread may use that queue while an upload is running.
+class host_texture_uploader {
+public:
+    void enable_device_features(VkPhysicalDevice physical_device, const host_upload_desc& desc, std::vector<const char*>& enabled_device_extensions,
+                                VkPhysicalDeviceFeatures2& physical_device_features);
+
+    void create(VkPhysicalDevice physical_device, VkDevice device, VkQueue queue, uint32_t queue_family_index);
+    void destroy();
+
+    host_texture upload(const mapped_file& file, uint64_t offset, uint32_t width, uint32_t height);
+    // Texels that are already in host memory, e.g. a stream_client arena; pages are only imported
+    // when the span itself covers them
+    host_texture upload(std::span<const uint8_t> texels, uint32_t width, uint32_t height);
+    void destroy_texture(const host_texture& texture);
+
+    host_upload_stats stats() const;
+
+private:
+    struct source_buffer {
+        VkBuffer buffer;
+        VkDeviceMemory memory;
+        VkDeviceSize offset;
+    };
+
+    // base..base + readable_size is the memory that may be read, which for a mapping extends to the page end
+    host_texture upload_region(const uint8_t* base, uint64_t readable_size, uint64_t offset, uint32_t width, uint32_t height);
+    host_texture create_texture(uint32_t width, uint32_t height, VkImageUsageFlags usage);
+    bool import_region(const uint8_t* base, uint64_t readable_size, uint64_t offset, uint64_t size, source_buffer& source);
+    source_buffer stage_region(const uint8_t* texels, uint64_t size);
+    void copy_to_image(const source_buffer& source, VkImage image, uint32_t width, uint32_t height);
+
+    VkPhysicalDevice _physical_device = VK_NULL_HANDLE;
+    VkDevice _device = VK_NULL_HANDLE;
+    VkQueue _queue = VK_NULL_HANDLE;
+    VkCommandPool _command_pool = VK_NULL_HANDLE;
+    VkCommandBuffer _command_buffer = VK_NULL_HANDLE;
+    VkFence _fence = VK_NULL_HANDLE;
+    std::mutex _queue_mutex;
+
+    host_upload_desc _desc;
+    bool _import_host_memory = false;
+    bool _host_image_copy = false;
+    VkDeviceSize _import_alignment = 0;
+
+#ifdef VK_EXT_host_image_copy
+    // The bundled volk predates VK_EXT_host_image_copy, so its entry points are loaded in create()
+    VkPhysicalDeviceHostImageCopyFeaturesEXT _host_image_copy_features = {};
+    PFN_vkCopyMemoryToImageEXT _copy_memory_to_image = nullptr;
+    PFN_vkTransitionImageLayoutEXT _transition_image_layout = nullptr;
+
+    void copy_on_host(const uint8_t* texels, VkImage image, uint32_t width, uint32_t height);
+#endif
+
+    std::atomic<uint64_t> _host_image_copies = 0;
+    std::atomic<uint64_t> _zero_copy_uploads = 0;
+    std::atomic<uint64_t> _staged_uploads = 0;
+    std::atomic<uint64_t> _import_fallbacks = 0;
+    std::atomic<uint64_t> _bytes_uploaded = 0;
+};
@@ -0,0 +1,47 @@
+#include "io_trace.hpp"
+#include <cstring>
+#include <format>
+#include <stdexcept>
+
+namespace {
+    constexpr char trace_magic[8] = { 'D', 'S', 'V', 'K', 'I', 'O', 'T', '1' };
+}
+
+io_trace_writer::io_trace_writer(const std::filesystem::path& path) : _file(path, std::ios::binary | std::ios::trunc) {
+    if(!_file.write(trace_magic, sizeof(trace_magic))) {
+        throw std::runtime_error(std::format("Can't write I/O trace {}", path.string()));
+    }
+}
+
+void io_trace_writer::write(const io_trace_record& record, const std::string& path) {
+    auto written = record;
+    written.path_size = static_cast<uint32_t>(path.size());
+
+    _file.write(reinterpret_cast<const char*>(&written), sizeof(written));
+    _file.write(path.data(), static_cast<std::streamsize>(path.size()));
+}
+
+io_trace read_io_trace(const std::filesystem::path& path) {
+    std::ifstream file(path, std::ios::binary);
+
+    char magic[sizeof(trace_magic)];
+    if(!file.read(magic, sizeof(magic)) || memcmp(magic, trace_magic, sizeof(magic)) != 0) {
+        throw std::runtime_error(std::format("{} is not an I/O trace", path.string()));
+    }
+
+    io_trace trace;
+
+    io_trace_record record;
+    while(file.read(reinterpret_cast<char*>(&record), sizeof(record))) {
+        std::string record_path(record.path_size, '\0');
+        if(!file.read(record_path.data(), record.path_size)) {
+            break;
+        }
+
+        trace.records.push_back(record);
+        trace.paths.push_back(std::move(record_path));
+    }
+
+    // A process that was killed leaves a truncated last record behind, which is dropped
+    return trace;
+}
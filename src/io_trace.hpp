@@ -0,0 +1,50 @@
+#pragma once
+
+#include "storage_backend.hpp"
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+enum class io_trace_event : uint8_t {
+    open_file,
+    close_file,
+    enqueue,
+    submit,
+    complete
+};
+
+// Fixed-size record; open_file records are followed by path_size bytes of UTF-8 path. file is the id
+// the traced backend handed out, request ids number enqueue records from 1 in trace order.
+struct io_trace_record {
+    uint64_t time_ns;
+    uint64_t file;
+    uint64_t offset;
+    uint64_t size;
+    uint64_t request_id;
+    uint32_t path_size;
+    io_trace_event event;
+    read_priority priority;
+    read_destination destination_kind;
+    uint8_t success;
+};
+
+struct io_trace {
+    std::vector<io_trace_record> records;
+    // Indexed like records; empty for everything but open_file
+    std::vector<std::string> paths;
+};
+
+class io_trace_writer {
+public:
+    explicit io_trace_writer(const std::filesystem::path& path);
+
+    void write(const io_trace_record& record, const std::string& path = {});
+    void flush() { _file.flush(); }
+
+private:
+    std::ofstream _file;
+};
+
+io_trace read_io_trace(const std::filesystem::path& path);
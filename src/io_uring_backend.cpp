@@ -0,0 +1,643 @@
+#include "io_uring_backend.hpp"
+#include "mapped_file.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <format>
+#include <stdexcept>
+#include <system_error>
+#include <fcntl.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace {
+    // Reads are capped well below the 2 GiB a single read may return
+    constexpr uint64_t max_read_length = 1u << 30;
+    constexpr uint32_t fallback_alignment = 4096;
+
+    [[noreturn]] void throw_errno(const std::string_view& message, int error = errno) {
+        throw std::runtime_error(std::format("{} failed: {}", message, std::system_category().message(error)));
+    }
+
+    int io_uring_setup(uint32_t entries, io_uring_params* params) {
+        return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+    }
+
+    int io_uring_enter(int ring, uint32_t to_submit, uint32_t min_complete, uint32_t flags) {
+        return static_cast<int>(syscall(__NR_io_uring_enter, ring, to_submit, min_complete, flags, nullptr, 0));
+    }
+
+    int io_uring_register(int ring, uint32_t opcode, const void* arg, uint32_t count) {
+        return static_cast<int>(syscall(__NR_io_uring_register, ring, opcode, arg, count));
+    }
+
+    uint32_t load_acquire(const uint32_t* value) {
+        return std::atomic_ref(*const_cast<uint32_t*>(value)).load(std::memory_order_acquire);
+    }
+
+    void store_release(uint32_t* value, uint32_t new_value) {
+        std::atomic_ref(*value).store(new_value, std::memory_order_release);
+    }
+
+    uint64_t align_down(uint64_t value, uint64_t alignment) {
+        return value / alignment * alignment;
+    }
+
+    uint64_t align_up(uint64_t value, uint64_t alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+}
+
+bool io_uring_backend::supported() {
+    io_uring_params params = {};
+    const auto ring = io_uring_setup(1, &params);
+    if(ring < 0) {
+        return false;
+    }
+
+    constexpr uint32_t probed_ops = 256;
+    std::vector<uint8_t> probe_storage(sizeof(io_uring_probe) + probed_ops * sizeof(io_uring_probe_op));
+    auto* probe = reinterpret_cast<io_uring_probe*>(probe_storage.data());
+
+    auto supported = io_uring_register(ring, IORING_REGISTER_PROBE, probe, probed_ops) == 0;
+    for(const auto op : { IORING_OP_READ, IORING_OP_READ_FIXED, IORING_OP_WRITE }) {
+        supported = supported && op <= probe->last_op && (probe->ops[op].flags & IO_URING_OP_SUPPORTED) != 0;
+    }
+
+    close(ring);
+    return supported;
+}
+
+io_uring_backend::io_uring_backend(const io_uring_desc& desc) : _desc(desc) {
+    // Whole pages keep split direct reads aligned
+    _desc.max_read_size = align_down(std::clamp(_desc.max_read_size, mapped_file::page_size(), max_read_length), mapped_file::page_size());
+
+    setup_ring();
+
+    try {
+        setup_fixed_files();
+        if(_desc.direct_io) {
+            setup_staging_buffers();
+        }
+        if(_desc.signal_completions) {
+            _completion_event = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+            if(_completion_event < 0) {
+                throw_errno("eventfd");
+            }
+            _entries_per_read = 2;
+        }
+    } catch(...) {
+        munmap(_sqes, _sqes_size);
+        if(_cq_ring != _sq_ring) {
+            munmap(_cq_ring, _cq_ring_size);
+        }
+        munmap(_sq_ring, _sq_ring_size);
+        close(_ring);
+        throw;
+    }
+}
+
+io_uring_backend::~io_uring_backend() {
+    // A failing ring can't deliver the rest; closing it below still cancels what the kernel holds
+    try {
+        submit();
+        while(!_requests.empty()) {
+            wait();
+
+            std::vector<read_completion> completions;
+            poll(completions);
+        }
+    } catch(const std::exception&) {
+    }
+
+    // Closing the ring drops the registered buffers and files with it
+    munmap(_sqes, _sqes_size);
+    if(_cq_ring != _sq_ring) {
+        munmap(_cq_ring, _cq_ring_size);
+    }
+    munmap(_sq_ring, _sq_ring_size);
+    close(_ring);
+
+    if(_completion_event >= 0) {
+        close(_completion_event);
+    }
+
+    for(const auto& [id, entry] : _files) {
+        close(entry.descriptor);
+    }
+}
+
+void io_uring_backend::setup_ring() {
+    io_uring_params params = {};
+
+    if(_desc.sq_poll) {
+        params.flags = IORING_SETUP_SQPOLL;
+        params.sq_thread_idle = _desc.sq_poll_idle_ms;
+        _ring = io_uring_setup(_desc.queue_depth, &params);
+        _sq_poll = _ring >= 0;
+    }
+
+    // Older kernels only allow SQPOLL with CAP_SYS_ADMIN
+    if(!_sq_poll) {
+        params = {};
+        _ring = io_uring_setup(_desc.queue_depth, &params);
+        if(_ring < 0) {
+            throw_errno("io_uring_setup");
+        }
+    }
+    _stats.syscalls++;
+
+    _sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    _cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+    const auto single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if(single_mmap) {
+        _sq_ring_size = _cq_ring_size = std::max(_sq_ring_size, _cq_ring_size);
+    }
+
+    auto* sq_ring = mmap(nullptr, _sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ring, IORING_OFF_SQ_RING);
+    if(sq_ring == MAP_FAILED) {
+        const auto error = errno;
+        close(_ring);
+        throw_errno("mmap of the submission ring", error);
+    }
+    _sq_ring = static_cast<uint8_t*>(sq_ring);
+
+    if(single_mmap) {
+        _cq_ring = _sq_ring;
+    } else {
+        auto* cq_ring = mmap(nullptr, _cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ring, IORING_OFF_CQ_RING);
+        if(cq_ring == MAP_FAILED) {
+            const auto error = errno;
+            munmap(_sq_ring, _sq_ring_size);
+            close(_ring);
+            throw_errno("mmap of the completion ring", error);
+        }
+        _cq_ring = static_cast<uint8_t*>(cq_ring);
+    }
+
+    _sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    auto* sqes = mmap(nullptr, _sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ring, IORING_OFF_SQES);
+    if(sqes == MAP_FAILED) {
+        const auto error = errno;
+        if(_cq_ring != _sq_ring) {
+            munmap(_cq_ring, _cq_ring_size);
+        }
+        munmap(_sq_ring, _sq_ring_size);
+        close(_ring);
+        throw_errno("mmap of the submission entries", error);
+    }
+    _sqes = static_cast<io_uring_sqe*>(sqes);
+
+    _sq_flags = reinterpret_cast<uint32_t*>(_sq_ring + params.sq_off.flags);
+    _sq_head = reinterpret_cast<uint32_t*>(_sq_ring + params.sq_off.head);
+    _sq_tail = reinterpret_cast<uint32_t*>(_sq_ring + params.sq_off.tail);
+    _sq_array = reinterpret_cast<uint32_t*>(_sq_ring + params.sq_off.array);
+    _sq_mask = *reinterpret_cast<uint32_t*>(_sq_ring + params.sq_off.ring_mask);
+    _sq_entries = params.sq_entries;
+    _sq_local_tail = *_sq_tail;
+
+    _cq_head = reinterpret_cast<uint32_t*>(_cq_ring + params.cq_off.head);
+    _cq_tail = reinterpret_cast<uint32_t*>(_cq_ring + params.cq_off.tail);
+    _cq_mask = *reinterpret_cast<uint32_t*>(_cq_ring + params.cq_off.ring_mask);
+    _cqes = reinterpret_cast<io_uring_cqe*>(_cq_ring + params.cq_off.cqes);
+}
+
+void io_uring_backend::setup_staging_buffers() {
+    _desc.staging_buffer_size = static_cast<uint32_t>(align_up(std::max(_desc.staging_buffer_size, fallback_alignment), mapped_file::page_size()));
+    _desc.staging_buffer_count = std::max(_desc.staging_buffer_count, 1u);
+    _staging = host_buffer(static_cast<size_t>(_desc.staging_buffer_size) * _desc.staging_buffer_count, _desc.huge_pages, _desc.numa_node);
+
+    std::vector<iovec> buffers(_desc.staging_buffer_count);
+    for(uint32_t i = 0; i < _desc.staging_buffer_count; i++) {
+        buffers[i] = iovec {
+            .iov_base = _staging.data() + static_cast<size_t>(i) * _desc.staging_buffer_size,
+            .iov_len = _desc.staging_buffer_size
+        };
+        _free_staging.push_back(static_cast<int32_t>(_desc.staging_buffer_count - 1 - i));
+    }
+
+    // Registration pins the pages and counts against RLIMIT_MEMLOCK; without it reads use the same buffers unregistered
+    _staging_registered = io_uring_register(_ring, IORING_REGISTER_BUFFERS, buffers.data(), _desc.staging_buffer_count) == 0;
+    _stats.syscalls++;
+}
+
+void io_uring_backend::setup_fixed_files() {
+    if(_desc.max_files == 0) {
+        return;
+    }
+
+    const std::vector<int> empty_slots(_desc.max_files, -1);
+    _fixed_files = io_uring_register(_ring, IORING_REGISTER_FILES, empty_slots.data(), _desc.max_files) == 0;
+    _stats.syscalls++;
+
+    if(_fixed_files) {
+        for(uint32_t i = 0; i < _desc.max_files; i++) {
+            _free_file_slots.push_back(static_cast<int32_t>(_desc.max_files - 1 - i));
+        }
+    }
+}
+
+void io_uring_backend::update_fixed_file(int32_t slot, int descriptor) {
+    io_uring_files_update update = {
+        .offset = static_cast<uint32_t>(slot),
+        .fds = reinterpret_cast<uint64_t>(&descriptor)
+    };
+
+    _stats.syscalls++;
+    if(io_uring_register(_ring, IORING_REGISTER_FILES_UPDATE, &update, 1) < 0) {
+        throw_errno("IORING_REGISTER_FILES_UPDATE");
+    }
+}
+
+uint64_t io_uring_backend::open_file(const std::filesystem::path& path) {
+    open_file_entry entry = {
+        .descriptor = -1,
+        .fixed_slot = -1
+    };
+
+    if(_desc.direct_io) {
+        // File systems without direct I/O, such as tmpfs, refuse O_DIRECT and are read buffered
+        entry.descriptor = open(path.c_str(), O_RDONLY | O_CLOEXEC | O_DIRECT);
+    }
+    if(entry.descriptor < 0) {
+        entry.descriptor = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    } else {
+        entry.offset_alignment = fallback_alignment;
+        entry.memory_alignment = fallback_alignment;
+
+#ifdef STATX_DIOALIGN
+        struct statx file_statx;
+        if(statx(entry.descriptor, "", AT_EMPTY_PATH, STATX_DIOALIGN, &file_statx) == 0 && (file_statx.stx_mask & STATX_DIOALIGN)) {
+            entry.offset_alignment = file_statx.stx_dio_offset_align;
+            entry.memory_alignment = file_statx.stx_dio_mem_align;
+        }
+#endif
+
+        // Staging buffers are page aligned, so larger alignments fall back to buffered reads
+        if(entry.offset_alignment == 0 || entry.offset_alignment > _desc.staging_buffer_size || entry.memory_alignment > mapped_file::page_size()) {
+            close(entry.descriptor);
+            entry = {
+                .descriptor = open(path.c_str(), O_RDONLY | O_CLOEXEC),
+                .fixed_slot = -1
+            };
+        }
+    }
+
+    if(entry.descriptor < 0) {
+        throw std::runtime_error(std::format("open failed for {}: {}", path.string(), std::system_category().message(errno)));
+    }
+
+    struct stat file_status;
+    if(fstat(entry.descriptor, &file_status) != 0) {
+        const auto error = errno;
+        close(entry.descriptor);
+        throw std::runtime_error(std::format("fstat failed for {}: {}", path.string(), std::system_category().message(error)));
+    }
+    entry.size = static_cast<uint64_t>(file_status.st_size);
+
+    if(_fixed_files && !_free_file_slots.empty()) {
+        entry.fixed_slot = _free_file_slots.back();
+        try {
+            update_fixed_file(entry.fixed_slot, entry.descriptor);
+            _free_file_slots.pop_back();
+        } catch(...) {
+            close(entry.descriptor);
+            throw;
+        }
+    }
+
+    if(entry.offset_alignment > 0) {
+        _stats.direct_files++;
+    } else {
+        _stats.buffered_files++;
+    }
+
+    const auto file = _next_file++;
+    _files.emplace(file, entry);
+
+    return file;
+}
+
+void io_uring_backend::close_file(uint64_t file) {
+    const auto it = _files.find(file);
+    if(it == _files.end()) {
+        return;
+    }
+
+    // Queued reads and reads still waiting for a submission slot need the descriptor, so closing waits for them
+    it->second.closing = true;
+    if(it->second.reads == 0) {
+        finish_read(file);
+    }
+}
+
+void io_uring_backend::finish_read(uint64_t file) {
+    auto& entry = _files.at(file);
+    if(entry.reads > 0) {
+        entry.reads--;
+    }
+
+    if(!entry.closing || entry.reads > 0) {
+        return;
+    }
+
+    if(entry.fixed_slot >= 0) {
+        update_fixed_file(entry.fixed_slot, -1);
+        _free_file_slots.push_back(entry.fixed_slot);
+    }
+
+    close(entry.descriptor);
+    _files.erase(file);
+}
+
+void io_uring_backend::enqueue(const read_request& request) {
+    // Counts as one read until submit() splits it into pieces
+    _files.at(request.file).reads++;
+    _queued.push_back(request);
+}
+
+void io_uring_backend::submit() {
+    for(const auto& request : _queued) {
+        const auto request_id = _next_request_id++;
+        _stats.requests++;
+
+        const auto& file = _files.at(request.file);
+        auto& pending = _requests[request_id] = pending_request {
+            .file = request.file,
+            .offset = request.offset,
+            .size = request.size,
+            .destination = static_cast<uint8_t*>(request.destination),
+            .user_data = request.user_data,
+            .success = true
+        };
+
+        if(request.size == 0) {
+            _completed.push_back(read_completion {
+                .user_data = request.user_data,
+                .success = true
+            });
+            _requests.erase(request_id);
+            finish_read(request.file);
+            continue;
+        }
+
+        split_request(request_id, pending, file);
+        finish_read(request.file);
+    }
+
+    _queued.clear();
+    pump();
+    enter(0);
+}
+
+void io_uring_backend::split_request(uint64_t request_id, const pending_request& request, const open_file_entry& file) {
+    const auto alignment = file.offset_alignment;
+
+    // Buffered files, and direct reads that are aligned on both sides, go straight to the destination
+    const auto direct_to_destination = alignment > 0 && request.offset % alignment == 0 && request.size % alignment == 0 &&
+                                       reinterpret_cast<uintptr_t>(request.destination) % file.memory_alignment == 0;
+
+    if(alignment == 0 || direct_to_destination) {
+        for(uint64_t done = 0; done < request.size; done += _desc.max_read_size) {
+            add_piece(read_piece {
+                .request_id = request_id,
+                .file = request.file,
+                .file_offset = request.offset + done,
+                .length = std::min(_desc.max_read_size, request.size - done),
+                .target = request.destination + done,
+                .staged = false,
+                .staging = no_staging
+            });
+        }
+        return;
+    }
+
+    const auto start = align_down(request.offset, alignment);
+    const auto end = align_up(request.offset + request.size, alignment);
+    const auto piece_size = align_down(_desc.staging_buffer_size, alignment);
+
+    for(auto offset = start; offset < end; offset += piece_size) {
+        add_piece(read_piece {
+            .request_id = request_id,
+            .file = request.file,
+            .file_offset = offset,
+            .length = std::min<uint64_t>(piece_size, end - offset),
+            .target = nullptr,
+            .staged = true,
+            .staging = no_staging
+        });
+    }
+}
+
+void io_uring_backend::add_piece(const read_piece& piece) {
+    const auto piece_id = _next_piece_id++;
+    _pieces.emplace(piece_id, piece);
+    _waiting_pieces.push_back(piece_id);
+
+    _requests.at(piece.request_id).reads_left++;
+    _files.at(piece.file).reads++;
+}
+
+void io_uring_backend::pump() {
+    while(!_waiting_pieces.empty() && _in_ring + _entries_per_read <= _sq_entries) {
+        const auto piece_id = _waiting_pieces.front();
+        if(!prepare(piece_id)) {
+            break;
+        }
+        _waiting_pieces.pop_front();
+    }
+
+    store_release(_sq_tail, _sq_local_tail);
+}
+
+bool io_uring_backend::prepare(uint64_t piece_id) {
+    // The submission ring is only full when the kernel hasn't consumed earlier entries yet
+    if(_sq_local_tail - load_acquire(_sq_head) + _entries_per_read > _sq_entries) {
+        return false;
+    }
+
+    auto& piece = _pieces.at(piece_id);
+    if(piece.staged) {
+        if(_free_staging.empty()) {
+            return false;
+        }
+        piece.staging = _free_staging.back();
+        _free_staging.pop_back();
+        piece.target = _staging.data() + static_cast<size_t>(piece.staging) * _desc.staging_buffer_size;
+    }
+
+    const auto& file = _files.at(piece.file);
+    const auto index = _sq_local_tail & _sq_mask;
+
+    auto& sqe = _sqes[index];
+    memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = piece.staged && _staging_registered ? IORING_OP_READ_FIXED : IORING_OP_READ;
+    sqe.fd = file.fixed_slot >= 0 ? file.fixed_slot : file.descriptor;
+    sqe.flags = file.fixed_slot >= 0 ? IOSQE_FIXED_FILE : 0;
+    sqe.off = piece.file_offset;
+    sqe.addr = reinterpret_cast<uint64_t>(piece.target);
+    sqe.len = static_cast<uint32_t>(piece.length);
+    sqe.buf_index = piece.staged ? static_cast<uint16_t>(piece.staging) : 0;
+    sqe.user_data = piece_id;
+
+    _sq_array[index] = index;
+    _sq_local_tail++;
+
+    // Hard links run the signal even when the read fails or comes up short, so no wakeup is lost
+    if(_completion_event >= 0) {
+        sqe.flags |= IOSQE_IO_HARDLINK;
+
+        const auto signal_index = _sq_local_tail & _sq_mask;
+        auto& signal = _sqes[signal_index];
+        memset(&signal, 0, sizeof(signal));
+        signal.opcode = IORING_OP_WRITE;
+        signal.fd = _completion_event;
+        signal.addr = reinterpret_cast<uint64_t>(&_signal_value);
+        signal.len = sizeof(_signal_value);
+        signal.user_data = signal_user_data;
+
+        _sq_array[signal_index] = signal_index;
+        _sq_local_tail++;
+    }
+
+    _to_submit += _entries_per_read;
+    _in_ring += _entries_per_read;
+    _stats.reads++;
+
+    return true;
+}
+
+void io_uring_backend::enter(uint32_t wait_count) {
+    auto flags = wait_count > 0 ? IORING_ENTER_GETEVENTS : 0u;
+
+    if(_sq_poll) {
+        // The kernel thread takes new entries from the ring by itself unless it has gone to sleep
+        _to_submit = 0;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(load_acquire(_sq_flags) & IORING_SQ_NEED_WAKEUP) {
+            flags |= IORING_ENTER_SQ_WAKEUP;
+            _stats.sq_wakeups++;
+        }
+        if(flags == 0) {
+            return;
+        }
+    } else if(_to_submit == 0 && wait_count == 0) {
+        return;
+    }
+
+    for(;;) {
+        _stats.syscalls++;
+        const auto submitted = io_uring_enter(_ring, _to_submit, wait_count, flags);
+        if(submitted >= 0) {
+            _to_submit -= std::min(_to_submit, static_cast<uint32_t>(submitted));
+            return;
+        }
+        if(errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            throw_errno("io_uring_enter");
+        }
+        // Out of resources for now; completions have to be reaped before more can be submitted
+        if(errno != EINTR) {
+            return;
+        }
+    }
+}
+
+void io_uring_backend::reap() {
+    // Everything the kernel has posted is taken in one pass and released with a single store
+    auto head = *_cq_head;
+    const auto tail = load_acquire(_cq_tail);
+    if(head == tail) {
+        return;
+    }
+
+    _stats.completion_batches++;
+
+    for(; head != tail; head++) {
+        const auto& cqe = _cqes[head & _cq_mask];
+        _in_ring--;
+        if(cqe.user_data != signal_user_data) {
+            _stats.completions++;
+            complete_piece(cqe.user_data, cqe.res);
+        }
+    }
+
+    store_release(_cq_head, head);
+}
+
+void io_uring_backend::complete_piece(uint64_t piece_id, int32_t result) {
+    auto node = _pieces.extract(piece_id);
+    auto& piece = node.mapped();
+    auto& request = _requests.at(piece.request_id);
+
+    if(result > 0) {
+        _stats.bytes_read += static_cast<uint64_t>(result);
+    }
+
+    const auto read = result > 0 ? static_cast<uint64_t>(result) : 0;
+
+    if(piece.staged) {
+        const auto request_end = request.offset + request.size;
+        const auto copy_start = std::max(piece.file_offset, request.offset);
+        const auto copy_end = std::min(piece.file_offset + piece.length, request_end);
+
+        // A direct read may stop at the end of the file, which is fine as long as the requested bytes are there
+        if(result >= 0 && piece.file_offset + read >= copy_end) {
+            memcpy(request.destination + (copy_start - request.offset), piece.target + (copy_start - piece.file_offset), copy_end - copy_start);
+            _stats.bytes_staged += copy_end - copy_start;
+        } else {
+            request.success = false;
+        }
+
+        _free_staging.push_back(piece.staging);
+    } else if(result > 0 && read < piece.length) {
+        // Short reads continue where they stopped, as another piece of the same request
+        piece.file_offset += read;
+        piece.target += read;
+        piece.length -= read;
+
+        const auto continued_id = _next_piece_id++;
+        _pieces.emplace(continued_id, piece);
+        _waiting_pieces.push_front(continued_id);
+        return;
+    } else if(result <= 0) {
+        request.success = false;
+    }
+
+    finish_read(piece.file);
+
+    if(--request.reads_left == 0) {
+        _completed.push_back(read_completion {
+            .user_data = request.user_data,
+            .success = request.success
+        });
+        _requests.erase(piece.request_id);
+    }
+}
+
+void io_uring_backend::poll(std::vector<read_completion>& completions) {
+    reap();
+    pump();
+    enter(0);
+
+    completions.insert(completions.end(), _completed.begin(), _completed.end());
+    _completed.clear();
+}
+
+void io_uring_backend::wait() {
+    if(!_completed.empty() || _requests.empty()) {
+        return;
+    }
+
+    reap();
+    pump();
+
+    if(_completed.empty() && _in_ring > 0) {
+        enter(std::min(_desc.wait_batch, _in_ring));
+    }
+}
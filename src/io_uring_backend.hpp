@@ -0,0 +1,184 @@
+#pragma once
+
+#include "host_memory.hpp"
+#include "storage_backend.hpp"
+#include <deque>
+#include <linux/io_uring.h>
+#include <unordered_map>
+#include <vector>
+
+struct io_uring_desc {
+    uint32_t queue_depth = 256;
+    // Opens files with O_DIRECT where the file system allows it, which keeps streamed data out of the page cache
+    bool direct_io = false;
+    // Direct reads that can't land in their destination as they are go through these registered buffers
+    uint32_t staging_buffer_size = 1024 * 1024;
+    uint32_t staging_buffer_count = 32;
+    // Registering huge pages also pins fewer, larger pages
+    huge_page_mode huge_pages = huge_page_mode::automatic;
+    // Node the staging buffers live on; -1 leaves them wherever they are first touched
+    int32_t numa_node = -1;
+    // Slots of the fixed file table
+    uint32_t max_files = 4096;
+    // Longer reads are split into reads of this size, which the kernel runs in parallel
+    uint64_t max_read_size = 8 * 1024 * 1024;
+    // A kernel thread picks up submissions, so submitting takes no system call while it is busy; it
+    // sleeps after sq_poll_idle_ms without work. Falls back to a normal ring where SQPOLL isn't allowed
+    bool sq_poll = false;
+    uint32_t sq_poll_idle_ms = 50;
+    // wait() asks the kernel for this many completions at once, or all reads in flight if there are fewer
+    uint32_t wait_batch = 1;
+    // Hard-links every read to a write to an eventfd, so an event loop can sleep on completion_event()
+    // until the backend has something to poll()
+    bool signal_completions = false;
+};
+
+struct io_uring_stats {
+    uint64_t requests;
+    uint64_t reads;
+    uint64_t bytes_read;
+    uint64_t bytes_staged;
+    uint64_t direct_files;
+    uint64_t buffered_files;
+    uint64_t syscalls;
+    uint64_t sq_wakeups;
+    uint64_t completion_batches;
+    uint64_t completions;
+};
+
+// storage_backend on an io_uring instance driven through the raw system calls. With direct_io, files
+// are opened with O_DIRECT and every read is widened to the file's direct I/O alignment (from statx,
+// falling back to 4096). A request that is already aligned in the file and in memory is read straight
+// into its destination; the others are split over staging buffers registered with the ring and copied
+// out when their read completes. File systems without direct I/O support get buffered reads. Open files
+// live in the ring's fixed file table, and the staging buffers and the file table are only used when
+// the kernel accepts their registration, so the backend degrades to plain reads instead of failing.
+// Completions are harvested from the completion ring in batches without a system call; one is only
+// made to submit (none with a busy SQPOLL thread) and to block in wait().
+class io_uring_backend final : public storage_backend {
+public:
+    explicit io_uring_backend(const io_uring_desc& desc);
+    ~io_uring_backend() override;
+
+    io_uring_backend(const io_uring_backend&) = delete;
+    io_uring_backend& operator=(const io_uring_backend&) = delete;
+
+    // Whether a ring can be created and supports the operations the backend issues. Kernels before 5.6,
+    // kernels with io_uring disabled and containers whose seccomp profile blocks it all report false
+    static bool supported();
+
+    uint64_t open_file(const std::filesystem::path& path) override;
+    uint64_t file_size(uint64_t file) const override { return _files.at(file).size; }
+    void close_file(uint64_t file) override;
+
+    void enqueue(const read_request& request) override;
+    void submit() override;
+    void poll(std::vector<read_completion>& completions) override;
+    void wait() override;
+
+    size_t in_flight() const override { return _queued.size() + _requests.size(); }
+
+    const io_uring_stats& stats() const { return _stats; }
+    bool sq_poll() const { return _sq_poll; }
+    // -1 without signal_completions
+    int completion_event() const { return _completion_event; }
+
+private:
+    static constexpr int32_t no_staging = -1;
+    // Piece ids start at 1, so the completions of linked signal writes carry 0
+    static constexpr uint64_t signal_user_data = 0;
+
+    struct open_file_entry {
+        int descriptor;
+        uint64_t size;
+        int32_t fixed_slot;
+        // Direct I/O alignment of file offsets and of memory; 0 for buffered files
+        uint32_t offset_alignment;
+        uint32_t memory_alignment;
+        size_t reads;
+        bool closing;
+    };
+
+    struct pending_request {
+        uint64_t file;
+        uint64_t offset;
+        uint64_t size;
+        uint8_t* destination;
+        uint64_t user_data;
+        uint32_t reads_left;
+        bool success;
+    };
+
+    struct read_piece {
+        uint64_t request_id;
+        uint64_t file;
+        uint64_t file_offset;
+        uint64_t length;
+        uint8_t* target;
+        bool staged;
+        int32_t staging;
+    };
+
+    void setup_ring();
+    void setup_staging_buffers();
+    void setup_fixed_files();
+    void update_fixed_file(int32_t slot, int descriptor);
+
+    void split_request(uint64_t request_id, const pending_request& request, const open_file_entry& file);
+    void add_piece(const read_piece& piece);
+    void pump();
+    bool prepare(uint64_t piece_id);
+    void enter(uint32_t wait_count);
+    void reap();
+    void complete_piece(uint64_t piece_id, int32_t result);
+    void finish_read(uint64_t file);
+
+    io_uring_desc _desc;
+
+    int _ring = -1;
+    uint8_t* _sq_ring = nullptr;
+    size_t _sq_ring_size = 0;
+    uint8_t* _cq_ring = nullptr;
+    size_t _cq_ring_size = 0;
+    io_uring_sqe* _sqes = nullptr;
+    size_t _sqes_size = 0;
+
+    bool _sq_poll = false;
+    uint32_t* _sq_flags = nullptr;
+    uint32_t* _sq_head = nullptr;
+    uint32_t* _sq_tail = nullptr;
+    uint32_t* _sq_array = nullptr;
+    uint32_t _sq_mask = 0;
+    uint32_t _sq_entries = 0;
+    uint32_t* _cq_head = nullptr;
+    uint32_t* _cq_tail = nullptr;
+    uint32_t _cq_mask = 0;
+    io_uring_cqe* _cqes = nullptr;
+
+    uint32_t _sq_local_tail = 0;
+    uint32_t _to_submit = 0;
+    uint32_t _in_ring = 0;
+    uint32_t _entries_per_read = 1;
+    int _completion_event = -1;
+    const uint64_t _signal_value = 1;
+
+    host_buffer _staging;
+    bool _staging_registered = false;
+    std::vector<int32_t> _free_staging;
+
+    bool _fixed_files = false;
+    std::vector<int32_t> _free_file_slots;
+
+    std::unordered_map<uint64_t, open_file_entry> _files;
+    uint64_t _next_file = 1;
+
+    std::vector<read_request> _queued;
+    std::unordered_map<uint64_t, pending_request> _requests;
+    uint64_t _next_request_id = 1;
+    std::unordered_map<uint64_t, read_piece> _pieces;
+    uint64_t _next_piece_id = 1;
+    std::deque<uint64_t> _waiting_pieces;
+    std::vector<read_completion> _completed;
+
+    io_uring_stats _stats = {};
+};
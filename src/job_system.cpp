@@ -0,0 +1,272 @@
+#include "job_system.hpp"
+#include <algorithm>
+
+namespace {
+    constexpr size_t deque_capacity = 4096;
+
+    thread_local const job_system* current_system = nullptr;
+    thread_local uint32_t current_worker = 0;
+}
+
+work_stealing_deque::work_stealing_deque(size_t capacity) : _capacity(static_cast<int64_t>(capacity)), _jobs(std::make_unique<std::atomic<job*>[]>(capacity)) {
+}
+
+bool work_stealing_deque::push(job* job) {
+    const auto bottom = _bottom.load(std::memory_order_relaxed);
+    const auto top = _top.load(std::memory_order_acquire);
+    if(bottom - top >= _capacity) {
+        return false;
+    }
+
+    _jobs[bottom % _capacity].store(job, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    _bottom.store(bottom + 1, std::memory_order_relaxed);
+
+    return true;
+}
+
+job* work_stealing_deque::pop() {
+    const auto bottom = _bottom.load(std::memory_order_relaxed) - 1;
+    _bottom.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto top = _top.load(std::memory_order_relaxed);
+
+    if(top > bottom) {
+        _bottom.store(bottom + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    auto job = _jobs[bottom % _capacity].load(std::memory_order_relaxed);
+    if(top == bottom) {
+        if(!_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            job = nullptr;
+        }
+        _bottom.store(bottom + 1, std::memory_order_relaxed);
+    }
+
+    return job;
+}
+
+job* work_stealing_deque::steal() {
+    auto top = _top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const auto bottom = _bottom.load(std::memory_order_acquire);
+
+    if(top >= bottom) {
+        return nullptr;
+    }
+
+    const auto job = _jobs[top % _capacity].load(std::memory_order_relaxed);
+    if(!_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+        return nullptr;
+    }
+
+    return job;
+}
+
+job_system::job_system(uint32_t worker_count, const thread_placement_desc& placement) : _placement(placement) {
+    for(uint32_t i = 0; i < worker_count; i++) {
+        _deques.push_back(std::make_unique<work_stealing_deque>(deque_capacity));
+    }
+
+    for(uint32_t i = 0; i < worker_count; i++) {
+        _workers.emplace_back(&job_system::worker_main, this, i);
+    }
+}
+
+job_system::~job_system() {
+    _stop.store(true);
+    _work_epoch.fetch_add(1);
+    _work_epoch.notify_all();
+
+    for(auto& worker : _workers) {
+        worker.join();
+    }
+}
+
+uint32_t job_system::default_worker_count() {
+    return std::max(std::thread::hardware_concurrency(), 2u) - 1;
+}
+
+job_handle job_system::schedule(std::function<void()> work, std::span<const job_handle> dependencies) {
+    auto handle = std::make_shared<job>();
+    handle->work = std::move(work);
+
+    for(const auto& dependency : dependencies) {
+        std::lock_guard lock(dependency->successors_mutex);
+        if(!dependency->finished.load(std::memory_order_acquire)) {
+            handle->unfinished_dependencies.fetch_add(1, std::memory_order_relaxed);
+            dependency->successors.push_back(handle);
+        } else if(dependency->exception) {
+            inherit_exception(*handle, dependency->exception);
+        }
+    }
+
+    if(handle->unfinished_dependencies.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        make_ready(handle);
+    }
+
+    return handle;
+}
+
+void job_system::wait(const job_handle& handle) {
+    const auto worker_index = current_system == this ? current_worker : static_cast<uint32_t>(_workers.size());
+
+    while(!handle->finished.load(std::memory_order_acquire)) {
+        const auto epoch = _waiter_epoch.load(std::memory_order_acquire);
+
+        if(const auto job = find_job(worker_index)) {
+            execute(job);
+        } else if(worker_index < _workers.size()) {
+            std::this_thread::yield();
+        } else if(!handle->finished.load(std::memory_order_acquire)) {
+            // Wake up on any completion or new job, not just this handle's completion, since the job
+            // it depends on may be one that only this thread is free to run
+            _waiter_epoch.wait(epoch, std::memory_order_acquire);
+        }
+    }
+
+    if(handle->exception) {
+        std::rethrow_exception(handle->exception);
+    }
+}
+
+void job_system::parallel_for(size_t count, const std::function<void(size_t)>& work) {
+    if(count == 0) {
+        return;
+    }
+
+    const size_t chunk_count = std::min<size_t>(count, (_workers.size() + 1) * 4);
+    const size_t chunk_size = (count + chunk_count - 1) / chunk_count;
+
+    std::vector<job_handle> chunks;
+    for(size_t begin = 0; begin < count; begin += chunk_size) {
+        const auto end = std::min(begin + chunk_size, count);
+        chunks.push_back(schedule([&work, begin, end] {
+            for(size_t i = begin; i < end; i++) {
+                work(i);
+            }
+        }));
+    }
+
+    // Every chunk has to finish before work and its captures go out of scope, so a failure is only rethrown after the others
+    std::exception_ptr exception;
+    for(const auto& chunk : chunks) {
+        try {
+            wait(chunk);
+        } catch(...) {
+            if(!exception) {
+                exception = std::current_exception();
+            }
+        }
+    }
+
+    if(exception) {
+        std::rethrow_exception(exception);
+    }
+}
+
+void job_system::make_ready(job_handle handle) {
+    const auto job = handle.get();
+    job->self = std::move(handle);
+
+    if(current_system != this || !_deques[current_worker]->push(job)) {
+        std::lock_guard lock(_injection_mutex);
+        _injection_queue.push_back(job);
+    }
+
+    _work_epoch.fetch_add(1, std::memory_order_release);
+    _work_epoch.notify_one();
+
+    _waiter_epoch.fetch_add(1, std::memory_order_release);
+    _waiter_epoch.notify_all();
+}
+
+void job_system::execute(job* job) {
+    const auto self = std::move(job->self);
+
+    // A job whose dependency failed is skipped and fails with the same exception
+    if(!job->exception) {
+        try {
+            job->work();
+        } catch(...) {
+            job->exception = std::current_exception();
+        }
+    }
+    job->work = nullptr;
+
+    std::vector<job_handle> successors;
+    {
+        std::lock_guard lock(job->successors_mutex);
+        job->finished.store(true, std::memory_order_release);
+        successors = std::move(job->successors);
+    }
+
+    _waiter_epoch.fetch_add(1, std::memory_order_release);
+    _waiter_epoch.notify_all();
+
+    for(const auto& successor : successors) {
+        if(job->exception) {
+            inherit_exception(*successor, job->exception);
+        }
+        if(successor->unfinished_dependencies.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            make_ready(successor);
+        }
+    }
+}
+
+void job_system::inherit_exception(job& successor, const std::exception_ptr& exception) {
+    std::lock_guard lock(successor.successors_mutex);
+    if(!successor.exception) {
+        successor.exception = exception;
+    }
+}
+
+job* job_system::find_job(uint32_t worker_index) {
+    const auto worker_count = static_cast<uint32_t>(_deques.size());
+
+    if(worker_index < worker_count) {
+        if(const auto job = _deques[worker_index]->pop()) {
+            return job;
+        }
+    }
+
+    {
+        std::lock_guard lock(_injection_mutex);
+        if(!_injection_queue.empty()) {
+            const auto job = _injection_queue.front();
+            _injection_queue.pop_front();
+            return job;
+        }
+    }
+
+    for(uint32_t i = 1; i <= worker_count; i++) {
+        const auto victim = (worker_index + i) % worker_count;
+        if(victim == worker_index) {
+            continue;
+        }
+        if(const auto job = _deques[victim]->steal()) {
+            return job;
+        }
+    }
+
+    return nullptr;
+}
+
+void job_system::worker_main(uint32_t worker_index) {
+    place_current_thread(_placement, thread_role::decode, worker_index);
+
+    current_system = this;
+    current_worker = worker_index;
+
+    while(!_stop.load(std::memory_order_acquire)) {
+        const auto epoch = _work_epoch.load(std::memory_order_acquire);
+
+        if(const auto job = find_job(worker_index)) {
+            execute(job);
+            continue;
+        }
+
+        _work_epoch.wait(epoch, std::memory_order_acquire);
+    }
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "cpu_topology.hpp"
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+struct job {
+    std::function<void()> work;
+    std::atomic<uint32_t> unfinished_dependencies = 1;
+    std::atomic<bool> finished = false;
+    std::mutex successors_mutex;
+    std::vector<std::shared_ptr<job>> successors;
+    std::exception_ptr exception;
+    std::shared_ptr<job> self;
+};
+
+using job_handle = std::shared_ptr<job>;
+
+// Chase-Lev deque: the owning worker pushes and pops at the bottom, other workers steal from the top.
+class work_stealing_deque {
+public:
+    explicit work_stealing_deque(size_t capacity);
+
+    bool push(job* job);
+    job* pop();
+    job* steal();
+
+private:
+    const int64_t _capacity;
+    std::unique_ptr<std::atomic<job*>[]> _jobs;
+    alignas(64) std::atomic<int64_t> _top = 0;
+    alignas(64) std::atomic<int64_t> _bottom = 0;
+};
+
+// Fixed pool of workers with one deque each. Jobs scheduled from a worker go to its own deque, jobs
+// scheduled from any other thread go to a shared injection queue, and idle workers steal. A job runs
+// once all jobs it depends on have finished; waiting threads execute other jobs in the meantime.
+// Exceptions are rethrown by wait() and propagate to every job that depends on the failed one.
+class job_system {
+public:
+    // Workers are placed as thread_role::decode
+    explicit job_system(uint32_t worker_count, const thread_placement_desc& placement = {});
+    ~job_system();
+
+    job_system(const job_system&) = delete;
+    job_system& operator=(const job_system&) = delete;
+
+    job_handle schedule(std::function<void()> work, std::span<const job_handle> dependencies = {});
+    void wait(const job_handle& handle);
+    void parallel_for(size_t count, const std::function<void(size_t)>& work);
+
+    uint32_t worker_count() const { return static_cast<uint32_t>(_workers.size()); }
+
+    static uint32_t default_worker_count();
+
+private:
+    void make_ready(job_handle handle);
+    void execute(job* job);
+    void inherit_exception(job& successor, const std::exception_ptr& exception);
+    job* find_job(uint32_t worker_index);
+    void worker_main(uint32_t worker_index);
+
+    std::vector<std::unique_ptr<work_stealing_deque>> _deques;
+    std::vector<std::thread> _workers;
+
+    std::mutex _injection_mutex;
+    std::deque<job*> _injection_queue;
+
+    std::atomic<uint32_t> _work_epoch = 0;
+    std::atomic<uint32_t> _waiter_epoch = 0;
+    std::atomic<bool> _stop = false;
+
+    thread_placement_desc _placement;
+};
@@ -0,0 +1,212 @@
+#include "load_submission_queue.hpp"
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <stdexcept>
+#include <unordered_map>
+
+load_submission_queue::load_submission_queue(texture_loader& loader, load_telemetry& telemetry, job_system& jobs, streaming_budget* budget,
+                                             const thread_placement_desc& placement, size_t capacity)
+    : _loader(loader), _telemetry(telemetry), _jobs(jobs), _budget(budget), _placement(placement), _submissions(capacity), _completions(capacity) {
+    _thread = std::thread([this] { run(); });
+}
+
+load_submission_queue::~load_submission_queue() {
+    _stop.store(true, std::memory_order_release);
+    _wake_counter.fetch_add(1, std::memory_order_release);
+    _wake_counter.notify_one();
+
+    _thread.join();
+}
+
+bool load_submission_queue::enqueue(const std::wstring_view& path, uint32_t width, uint32_t height, uint64_t user_data, read_priority priority,
+                                    uint32_t first_mip) {
+    return push(submission {
+        .path = std::wstring(path),
+        .width = width,
+        .height = height,
+        .first_mip = first_mip,
+        .user_data = user_data,
+        .priority = priority,
+        .enqueue_time = load_telemetry::clock::now()
+    });
+}
+
+task<texture> load_submission_queue::load_texture(std::wstring path, uint32_t width, uint32_t height, read_priority priority) {
+    co_return co_await load_awaiter { *this, path, width, height, priority };
+}
+
+void load_submission_queue::load_awaiter::await_suspend(std::coroutine_handle<> handle) {
+    const auto pushed = queue.push(submission {
+        .path = std::wstring(path),
+        .width = width,
+        .height = height,
+        .first_mip = 0,
+        .user_data = 0,
+        .priority = priority,
+        .enqueue_time = load_telemetry::clock::now(),
+        .on_complete = [this, handle](const texture& loaded, const std::exception_ptr& failure) {
+            result = loaded;
+            error = failure;
+            (void)queue._jobs.schedule([handle] { handle.resume(); });
+        }
+    });
+
+    if(!pushed) {
+        throw std::runtime_error("Load submission queue is full");
+    }
+}
+
+texture load_submission_queue::load_awaiter::await_resume() const {
+    if(error) {
+        std::rethrow_exception(error);
+    }
+    return result;
+}
+
+bool load_submission_queue::push(submission&& request) {
+    const auto pushed = _submissions.try_push(std::move(request));
+
+    if(pushed) {
+        _wake_counter.fetch_add(1, std::memory_order_release);
+        _wake_counter.notify_one();
+    }
+
+    return pushed;
+}
+
+void load_submission_queue::drain(std::vector<streamed_texture>& completed) {
+    while(auto completion = _completions.try_pop()) {
+        completed.push_back(*completion);
+    }
+}
+
+void load_submission_queue::run() {
+    place_current_thread(_placement, thread_role::submission, 0);
+
+    std::unordered_map<texture_loader::load_ticket, submission> submissions_by_ticket;
+    std::vector<submission> held;
+    std::vector<submission> still_held;
+    std::vector<submission> batch;
+    std::vector<texture_loader::load_ticket> tickets;
+    std::vector<std::exception_ptr> errors;
+    std::vector<texture_loader::completion> completions;
+    std::deque<streamed_texture> undelivered;
+
+    const auto deliver = [&](const submission& request, const texture& result, const std::exception_ptr& error) {
+        if(request.on_complete) {
+            request.on_complete(result, error);
+        } else {
+            undelivered.push_back(streamed_texture {
+                .user_data = request.user_data,
+                .result = result,
+                .error = error
+            });
+        }
+    };
+
+    while(!_stop.load(std::memory_order_acquire)) {
+        const auto observed_wake_counter = _wake_counter.load(std::memory_order_acquire);
+
+        const auto held_before = held.size();
+        while(auto request = _submissions.try_pop()) {
+            held.push_back(std::move(*request));
+        }
+
+        batch.clear();
+        if(_budget) {
+            if(held.size() != held_before) {
+                std::stable_sort(held.begin(), held.end(), [](const submission& a, const submission& b) { return a.priority > b.priority; });
+            }
+
+            // Within a class loads start in order, so the first one refused holds back the rest of its class
+            still_held.clear();
+            for(auto& request : held) {
+                // The loader creates R8G8B8A8 images starting at first_mip, so that's what the upload costs
+                const auto shift = std::min(request.first_mip, 31u);
+                const auto bytes = static_cast<uint64_t>(std::max(request.width >> shift, 1u)) * std::max(request.height >> shift, 1u) * 4;
+                const auto class_blocked = !still_held.empty() && still_held.back().priority == request.priority;
+                if(!class_blocked && _budget->try_admit(request.priority, bytes)) {
+                    batch.push_back(std::move(request));
+                } else {
+                    still_held.push_back(std::move(request));
+                }
+            }
+            std::swap(held, still_held);
+        } else {
+            std::swap(batch, held);
+        }
+
+        const auto submitted = !batch.empty();
+        if(submitted) {
+            const auto cpu_start = std::chrono::steady_clock::now();
+
+            // A load that can't start fails on its own; it must not take the thread or the rest of the batch with it
+            tickets.resize(batch.size());
+            errors.assign(batch.size(), nullptr);
+            _jobs.parallel_for(batch.size(), [&](size_t i) {
+                const auto telemetry_id = _telemetry.begin_request(batch[i].enqueue_time);
+                try {
+                    tickets[i] = _loader.enqueue(batch[i].path, batch[i].width, batch[i].height, batch[i].first_mip, telemetry_id);
+                } catch(const std::exception&) {
+                    _telemetry.cancel_request(telemetry_id);
+                    errors[i] = std::current_exception();
+                }
+            });
+
+            if(_budget) {
+                _budget->record_cpu_time(std::chrono::steady_clock::now() - cpu_start);
+            }
+
+            for(size_t i = 0; i < batch.size(); i++) {
+                if(errors[i]) {
+                    deliver(batch[i], {}, errors[i]);
+                } else {
+                    submissions_by_ticket.emplace(tickets[i], std::move(batch[i]));
+                }
+            }
+
+            _loader.submit();
+        }
+
+        completions.clear();
+        _loader.poll(completions);
+
+        for(const auto& completion : completions) {
+            // Only tickets this thread enqueued have anyone to deliver to
+            const auto it = submissions_by_ticket.find(completion.ticket);
+            if(it == submissions_by_ticket.end()) {
+                continue;
+            }
+
+            deliver(it->second, completion.result, completion.error);
+            submissions_by_ticket.erase(it);
+        }
+
+        while(!undelivered.empty() && _completions.try_push(undelivered.front())) {
+            undelivered.pop_front();
+        }
+
+        if(submitted || !completions.empty()) {
+            continue;
+        }
+
+        if(submissions_by_ticket.empty() && undelivered.empty() && held.empty()) {
+            _wake_counter.wait(observed_wake_counter, std::memory_order_acquire);
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(250));
+        }
+    }
+
+    // Nothing completes these any more, so awaiters and callbacks get a failure instead of waiting forever
+    const auto destroyed = std::make_exception_ptr(std::runtime_error("Load submission queue destroyed"));
+    while(auto request = _submissions.try_pop()) {
+        held.push_back(std::move(*request));
+    }
+    for(const auto& request : held) {
+        deliver(request, {}, destroyed);
+    }
+    for(const auto& [ticket, request] : submissions_by_ticket) {
+        deliver(request, {}, destroyed);
+    }
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "job_system.hpp"
+#include "mpsc_ring.hpp"
+#include "spsc_ring.hpp"
+#include "streaming_budget.hpp"
+#include "task.hpp"
+#include "texture_loader.hpp"
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct streamed_texture {
+    uint64_t user_data;
+    texture result;
+    // Set when the load failed, and result is empty
+    std::exception_ptr error;
+};
+
+// Front end of texture_loader for many threads. enqueue() is lock-free and may be called from any
+// thread; a dedicated submission thread drains the request ring, creates the resources of everything
+// it finds in parallel on the job system, submits them as one loader batch, and forwards finished
+// textures through a single-consumer ring that the render thread empties with drain() once per frame.
+// Failed loads are forwarded the same way, with their error. load_texture() is the coroutine flavour:
+// the returned task suspends until the load has finished and then resumes on the job system instead
+// of going through drain(), rethrowing when the load failed. With a streaming_budget, submissions
+// start most urgent first and only as far as the budget admits them; the rest wait for later frames.
+// Loads still waiting or in flight when the queue is destroyed fail with an error.
+class load_submission_queue {
+public:
+    // The submission thread is placed as thread_role::submission
+    load_submission_queue(texture_loader& loader, load_telemetry& telemetry, job_system& jobs, streaming_budget* budget = nullptr,
+                          const thread_placement_desc& placement = {}, size_t capacity = 4096);
+    ~load_submission_queue();
+
+    load_submission_queue(const load_submission_queue&) = delete;
+    load_submission_queue& operator=(const load_submission_queue&) = delete;
+
+    // first_mip skips the larger mips, as texture_loader::enqueue does
+    bool enqueue(const std::wstring_view& path, uint32_t width, uint32_t height, uint64_t user_data, read_priority priority = read_priority::normal,
+                 uint32_t first_mip = 0);
+    void drain(std::vector<streamed_texture>& completed);
+
+    task<texture> load_texture(std::wstring path, uint32_t width, uint32_t height, read_priority priority = read_priority::normal);
+
+private:
+    struct submission {
+        std::wstring path;
+        uint32_t width;
+        uint32_t height;
+        uint32_t first_mip;
+        uint64_t user_data;
+        read_priority priority;
+        load_telemetry::clock::time_point enqueue_time;
+        std::function<void(const texture&, const std::exception_ptr&)> on_complete;
+    };
+
+    struct load_awaiter {
+        load_submission_queue& queue;
+        std::wstring_view path;
+        uint32_t width;
+        uint32_t height;
+        read_priority priority;
+        texture result;
+        std::exception_ptr error;
+
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> handle);
+        texture await_resume() const;
+    };
+
+    bool push(submission&& request);
+
+    void run();
+
+    texture_loader& _loader;
+    load_telemetry& _telemetry;
+    job_system& _jobs;
+    streaming_budget* _budget;
+    thread_placement_desc _placement;
+
+    mpsc_ring<submission> _submissions;
+    spsc_ring<streamed_texture> _completions;
+
+    std::atomic<uint32_t> _wake_counter = 0;
+    std::atomic<bool> _stop = false;
+    std::thread _thread;
+};
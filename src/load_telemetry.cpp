@@ -0,0 +1,179 @@
+#include "load_telemetry.hpp"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+std::string_view load_stage_name(load_stage stage) {
+    switch(stage) {
+        case load_stage::enqueue: return "enqueue";
+        case load_stage::dispatch: return "dispatch";
+        case load_stage::io_issue: return "io_issue";
+        case load_stage::io_complete: return "io_complete";
+        case load_stage::decompress_complete: return "decompress_complete";
+        case load_stage::gpu_copy_submitted: return "gpu_copy_submitted";
+        case load_stage::image_usable: return "image_usable";
+        default: return "unknown";
+    }
+}
+
+uint32_t latency_histogram::index_of(uint64_t value) {
+    value = std::min(value, (uint64_t(1) << max_value_bits) - 1);
+
+    const auto magnitude = static_cast<uint32_t>(std::bit_width(value));
+    const auto shift = magnitude > sub_bucket_bits ? magnitude - sub_bucket_bits : 0;
+    return shift * sub_bucket_half_count + static_cast<uint32_t>(value >> shift);
+}
+
+uint64_t latency_histogram::highest_equivalent_value(uint32_t index) {
+    const auto shift = index < 2 * sub_bucket_half_count ? 0 : index / sub_bucket_half_count - 1;
+    const auto sub_bucket = index - shift * sub_bucket_half_count;
+    return (uint64_t(sub_bucket) << shift) + (uint64_t(1) << shift) - 1;
+}
+
+void latency_histogram::record(uint64_t value) {
+    _counts[index_of(value)]++;
+    _total_count++;
+    _max = std::max(_max, value);
+}
+
+void latency_histogram::merge(const latency_histogram& other) {
+    for(auto i = 0u; i < bucket_count; i++) {
+        _counts[i] += other._counts[i];
+    }
+    _total_count += other._total_count;
+    _max = std::max(_max, other._max);
+}
+
+void latency_histogram::reset() {
+    _counts.fill(0);
+    _total_count = 0;
+    _max = 0;
+}
+
+uint64_t latency_histogram::value_at_percentile(double percentile) const {
+    if(_total_count == 0) {
+        return 0;
+    }
+
+    const auto target = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(percentile / 100.0 * static_cast<double>(_total_count))));
+
+    uint64_t seen = 0;
+    for(auto i = 0u; i < bucket_count; i++) {
+        seen += _counts[i];
+        if(seen >= target) {
+            return std::min(highest_equivalent_value(i), _max);
+        }
+    }
+
+    return _max;
+}
+
+uint64_t load_telemetry::begin_request() {
+    return begin_request(clock::now());
+}
+
+uint64_t load_telemetry::begin_request(clock::time_point enqueue_time) {
+    std::lock_guard lock(_mutex);
+    const auto request_id = _next_request_id++;
+
+    auto& timestamps = _in_flight[request_id];
+    timestamps.times[static_cast<size_t>(load_stage::enqueue)] = enqueue_time;
+    timestamps.marked_mask = 1u << static_cast<uint32_t>(load_stage::enqueue);
+
+    return request_id;
+}
+
+void load_telemetry::mark(uint64_t request_id, load_stage stage) {
+    mark(request_id, stage, clock::now());
+}
+
+void load_telemetry::mark(uint64_t request_id, load_stage stage, clock::time_point time) {
+    std::lock_guard lock(_mutex);
+
+    const auto it = _in_flight.find(request_id);
+    if(it == _in_flight.end()) {
+        return;
+    }
+
+    it->second.times[static_cast<size_t>(stage)] = time;
+    it->second.marked_mask |= 1u << static_cast<uint32_t>(stage);
+
+    if(stage == load_stage::image_usable) {
+        complete_request(it->second);
+        _in_flight.erase(it);
+    }
+}
+
+void load_telemetry::cancel_request(uint64_t request_id) {
+    std::lock_guard lock(_mutex);
+    _in_flight.erase(request_id);
+}
+
+void load_telemetry::complete_request(const request_timestamps& timestamps) {
+    constexpr auto stage_count = static_cast<size_t>(load_stage::count);
+
+    auto times = timestamps.times;
+    for(auto i = stage_count - 1; i-- > 1;) {
+        if(!(timestamps.marked_mask & (1u << i))) {
+            times[i] = times[i + 1];
+        }
+    }
+
+    for(auto i = 1u; i < stage_count; i++) {
+        const auto duration = std::max(times[i] - times[i - 1], clock::duration::zero());
+        _stage_histograms[i].record(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+    }
+
+    const auto total = times[stage_count - 1] - times[0];
+    _total_histogram.record(std::chrono::duration_cast<std::chrono::nanoseconds>(total).count());
+}
+
+latency_percentiles load_telemetry::make_percentiles(const latency_histogram& histogram) {
+    return latency_percentiles {
+        .count = histogram.total_count(),
+        .p50 = std::chrono::nanoseconds(histogram.value_at_percentile(50.0)),
+        .p90 = std::chrono::nanoseconds(histogram.value_at_percentile(90.0)),
+        .p99 = std::chrono::nanoseconds(histogram.value_at_percentile(99.0)),
+        .p999 = std::chrono::nanoseconds(histogram.value_at_percentile(99.9)),
+        .max = std::chrono::nanoseconds(histogram.max())
+    };
+}
+
+latency_percentiles load_telemetry::percentiles(load_stage stage) const {
+    std::lock_guard lock(_mutex);
+    return make_percentiles(_stage_histograms[static_cast<size_t>(stage)]);
+}
+
+latency_percentiles load_telemetry::total() const {
+    std::lock_guard lock(_mutex);
+    return make_percentiles(_total_histogram);
+}
+
+void load_telemetry::dump(FILE* file) const {
+    const auto print_row = [file](std::string_view name, const latency_percentiles& p) {
+        const auto us = [](std::chrono::nanoseconds ns) { return static_cast<double>(ns.count()) / 1000.0; };
+        fprintf(file, "  %-20.*s %8llu %10.1f %10.1f %10.1f %10.1f %10.1f\n", static_cast<int>(name.size()), name.data(),
+                static_cast<unsigned long long>(p.count), us(p.p50), us(p.p90), us(p.p99), us(p.p999), us(p.max));
+    };
+
+    fprintf(file, "load latency (us)\n  %-20s %8s %10s %10s %10s %10s %10s\n", "stage", "count", "p50", "p90", "p99", "p99.9", "max");
+    for(auto i = 1u; i < static_cast<uint32_t>(load_stage::count); i++) {
+        const auto stage = static_cast<load_stage>(i);
+        print_row(load_stage_name(stage), percentiles(stage));
+    }
+    print_row("total", total());
+}
+
+void load_telemetry::dump_if_due(clock::duration interval, FILE* file) {
+    const auto now = clock::now();
+    {
+        std::lock_guard lock(_mutex);
+        if(now - _last_dump < interval || _total_histogram.total_count() == _last_dump_count) {
+            return;
+        }
+        _last_dump = now;
+        _last_dump_count = _total_histogram.total_count();
+    }
+
+    dump(file);
+}
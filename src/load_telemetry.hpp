@@ -0,0 +1,95 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+
+enum class load_stage : uint32_t {
+    enqueue,
+    dispatch,
+    io_issue,
+    io_complete,
+    decompress_complete,
+    gpu_copy_submitted,
+    image_usable,
+    count
+};
+
+std::string_view load_stage_name(load_stage stage);
+
+// Log-linear histogram in the style of HdrHistogram: 64 linear sub-buckets per power of two,
+// which keeps the relative error of every recorded value below 1.6%.
+class latency_histogram {
+public:
+    static constexpr uint32_t sub_bucket_bits = 7;
+    static constexpr uint32_t sub_bucket_half_count = 1u << (sub_bucket_bits - 1);
+    static constexpr uint32_t max_value_bits = 42;
+    static constexpr uint32_t bucket_count = (max_value_bits - sub_bucket_bits + 2) * sub_bucket_half_count;
+
+    void record(uint64_t value);
+    void merge(const latency_histogram& other);
+    void reset();
+
+    uint64_t value_at_percentile(double percentile) const;
+    uint64_t total_count() const { return _total_count; }
+    uint64_t max() const { return _max; }
+
+private:
+    static uint32_t index_of(uint64_t value);
+    static uint64_t highest_equivalent_value(uint32_t index);
+
+    std::array<uint64_t, bucket_count> _counts = {};
+    uint64_t _total_count = 0;
+    uint64_t _max = 0;
+};
+
+struct latency_percentiles {
+    uint64_t count;
+    std::chrono::nanoseconds p50;
+    std::chrono::nanoseconds p90;
+    std::chrono::nanoseconds p99;
+    std::chrono::nanoseconds p999;
+    std::chrono::nanoseconds max;
+};
+
+// Collects per-request timestamps for every load_stage. The histogram for a stage holds the time
+// spent between the previous stage and that one, so the stage dominating the tail stands out directly;
+// total() covers enqueue to image_usable. Stages a backend cannot observe separately are marked with the
+// timestamp of the next stage it can observe, which records them as zero-length.
+class load_telemetry {
+public:
+    using clock = std::chrono::steady_clock;
+
+    uint64_t begin_request();
+    uint64_t begin_request(clock::time_point enqueue_time);
+    void mark(uint64_t request_id, load_stage stage);
+    void mark(uint64_t request_id, load_stage stage, clock::time_point time);
+    void cancel_request(uint64_t request_id);
+
+    latency_percentiles percentiles(load_stage stage) const;
+    latency_percentiles total() const;
+
+    void dump(FILE* file) const;
+    void dump_if_due(clock::duration interval, FILE* file = stdout);
+
+private:
+    struct request_timestamps {
+        std::array<clock::time_point, static_cast<size_t>(load_stage::count)> times;
+        uint32_t marked_mask;
+    };
+
+    void complete_request(const request_timestamps& timestamps);
+    static latency_percentiles make_percentiles(const latency_histogram& histogram);
+
+    mutable std::mutex _mutex;
+    uint64_t _next_request_id = 1;
+    std::unordered_map<uint64_t, request_timestamps> _in_flight;
+    std::array<latency_histogram, static_cast<size_t>(load_stage::count)> _stage_histograms;
+    latency_histogram _total_histogram;
+    clock::time_point _last_dump = clock::now();
+    uint64_t _last_dump_count = 0;
+};
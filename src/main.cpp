@@ -1,54 +1,213 @@
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_vulkan.h>
-#include <DirectStorage/dstorage.h>
-#define VK_USE_PLATFORM_WIN32_KHR
+#ifdef _WIN32
+#include "d3d12_utils.hpp"
+#endif
 #define VOLK_IMPLEMENTATION
-#include <volk/volk.h>
+#include "vulkan_utils.hpp"
+#include "bindless_texture_table.hpp"
+#include "chunk_checksums.hpp"
+#include "cpu_topology.hpp"
+#include "host_texture_uploader.hpp"
+#include "job_system.hpp"
+#include "load_telemetry.hpp"
+#include "mapped_file.hpp"
+#include "task.hpp"
+#include "texture_layout.hpp"
+#ifdef _WIN32
+#include "load_submission_queue.hpp"
+#include "streaming_budget.hpp"
+#include "stress_scene.hpp"
+#include "texture_loader.hpp"
+#else
+#include "autotuning_backend.hpp"
+#include "caching_backend.hpp"
+#include "coalescing_backend.hpp"
+#include "emulated_backend.hpp"
+#include "host_memory.hpp"
+#include "shared_texture_client.hpp"
+#include "storage_selection.hpp"
+#include "stream_client.hpp"
+#include "stream_daemon.hpp"
+#include "stream_server.hpp"
+#include "tracing_backend.hpp"
+#include "verifying_backend.hpp"
+#endif
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
 #include <format>
+#include <future>
 #include <limits>
+#include <memory>
+#include <optional>
+#include <string>
 #include <string_view>
 #include <stdexcept>
-#include <system_error>
+#include <thread>
 #include <vector>
 
-#ifdef max
-#undef max
+#ifdef _WIN32
+constexpr bool direct_storage_available = true;
+#else
+constexpr bool direct_storage_available = false;
 #endif
 
-void throw_if_failed(HRESULT result, const std::string_view& message) {
-    if(FAILED(result)) {
-        throw std::runtime_error(std::format("{} failed: {}", message, std::system_category().message(result)));
+struct example_options {
+    bool bindless = false;
+    uint32_t bindless_instance_count = 4096;
+    bool host_upload = !direct_storage_available;
+    host_upload_desc host_desc;
+    thread_placement_desc placement;
+    std::string write_checksums_path;
+    uint64_t checksum_chunk_size = default_checksum_chunk_size;
+    bool stress = false;
+#ifdef _WIN32
+    stress_scene_desc stress_desc;
+    bool qos = false;
+    streaming_budget_desc budget_desc;
+#endif
+    std::string stress_asset_directory;
+#ifndef _WIN32
+    std::string stream_daemon_socket;
+    std::string shared_upload_socket;
+    std::string stream_server_socket;
+    std::string stream_client_socket;
+    caching_desc cache_desc;
+    stream_server_desc stream_desc;
+    std::string io_trace_path;
+    std::optional<emulated_storage_desc> emulated_desc;
+    bool autotune = false;
+    autotuning_desc autotune_desc;
+    storage_selection_desc storage_desc;
+    huge_page_mode huge_pages = huge_page_mode::automatic;
+    std::optional<verification_desc> verify_desc;
+#endif
+};
+
+example_options parse_options(int argc, char** args) {
+    example_options options;
+
+    for(auto i = 1; i < argc; i++) {
+        const std::string_view arg = args[i];
+        if(arg == "--bindless") {
+            options.bindless = true;
+        } else if(arg == "--instances" && i + 1 < argc) {
+            options.bindless_instance_count = static_cast<uint32_t>(std::stoul(args[++i]));
+        } else if(arg == "--host-upload") {
+            options.host_upload = true;
+        } else if(arg == "--no-host-import") {
+            options.host_desc.import_host_memory = false;
+        } else if(arg == "--no-host-image-copy") {
+            options.host_desc.host_image_copy = false;
+        } else if(arg == "--host-image-copy-max" && i + 1 < argc) {
+            options.host_desc.host_image_copy_max_size = std::stoull(args[++i]);
+        } else if(arg == "--pin-threads") {
+            options.placement.pin = true;
+        } else if(arg == "--io-node" && i + 1 < argc) {
+            options.placement.pin = true;
+            options.placement.io_node = std::stoi(args[++i]);
+        } else if(arg == "--decode-node" && i + 1 < argc) {
+            options.placement.pin = true;
+            options.placement.decode_node = std::stoi(args[++i]);
+        } else if(arg == "--submit-node" && i + 1 < argc) {
+            options.placement.pin = true;
+            options.placement.submission_node = std::stoi(args[++i]);
+        } else if(arg == "--write-checksums" && i + 1 < argc) {
+            options.write_checksums_path = args[++i];
+        } else if(arg == "--checksum-chunk" && i + 1 < argc) {
+            options.checksum_chunk_size = std::stoull(args[++i]);
+#ifdef _WIN32
+        } else if(arg == "--stress") {
+            options.stress = true;
+            options.bindless = true;
+        } else if(arg == "--stress-frames" && i + 1 < argc) {
+            options.stress_desc.frame_count = static_cast<uint32_t>(std::stoul(args[++i]));
+        } else if(arg == "--stress-grid" && i + 1 < argc) {
+            options.stress_desc.grid_size = static_cast<uint32_t>(std::stoul(args[++i]));
+        } else if(arg == "--stress-assets" && i + 1 < argc) {
+            options.stress_asset_directory = args[++i];
+        } else if(arg == "--qos") {
+            options.qos = true;
+        } else if(arg == "--qos-frame-target" && i + 1 < argc) {
+            options.qos = true;
+            options.budget_desc.target_frame_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::duration<double, std::milli>(std::stod(args[++i])));
+        } else if(arg == "--qos-frame-bytes" && i + 1 < argc) {
+            options.qos = true;
+            options.budget_desc.frame_upload_bytes = std::stoull(args[++i]);
+        } else if(arg == "--qos-frame-cpu" && i + 1 < argc) {
+            options.qos = true;
+            options.budget_desc.frame_cpu_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::duration<double, std::milli>(std::stod(args[++i])));
+#else
+        } else if(arg == "--stream-daemon" && i + 1 < argc) {
+            options.stream_daemon_socket = args[++i];
+        } else if(arg == "--shared-upload" && i + 1 < argc) {
+            options.shared_upload_socket = args[++i];
+        } else if(arg == "--stream-server" && i + 1 < argc) {
+            options.stream_server_socket = args[++i];
+        } else if(arg == "--stream-client" && i + 1 < argc) {
+            options.stream_client_socket = args[++i];
+        } else if(arg == "--cache-ram" && i + 1 < argc) {
+            options.cache_desc.ram_capacity = std::stoull(args[++i]);
+        } else if(arg == "--cache-dir" && i + 1 < argc) {
+            options.cache_desc.disk_directory = args[++i];
+        } else if(arg == "--cache-disk" && i + 1 < argc) {
+            options.cache_desc.disk_capacity = std::stoull(args[++i]);
+        } else if(arg == "--startup-trace" && i + 1 < argc) {
+            options.stream_desc.startup_trace = args[++i];
+        } else if(arg == "--startup-window" && i + 1 < argc) {
+            options.stream_desc.startup_window = std::chrono::seconds(std::stoul(args[++i]));
+        } else if(arg == "--io-trace" && i + 1 < argc) {
+            options.io_trace_path = args[++i];
+        } else if(arg == "--emulate-storage" && i + 1 < argc) {
+            options.emulated_desc = emulated_storage_preset(args[++i]);
+        } else if(arg == "--autotune") {
+            options.autotune = true;
+        } else if(arg == "--autotune-latency" && i + 1 < argc) {
+            options.autotune = true;
+            options.autotune_desc.latency_limit = std::chrono::milliseconds(std::stoul(args[++i]));
+        } else if(arg == "--storage-backend" && i + 1 < argc) {
+            options.storage_desc.kind = parse_storage_backend_kind(args[++i]);
+        } else if(arg == "--direct-io") {
+            options.storage_desc.uring.direct_io = true;
+        } else if(arg == "--sq-poll") {
+            options.storage_desc.uring.sq_poll = true;
+        } else if(arg == "--sq-poll-idle" && i + 1 < argc) {
+            options.storage_desc.uring.sq_poll_idle_ms = static_cast<uint32_t>(std::stoul(args[++i]));
+        } else if(arg == "--io-threads" && i + 1 < argc) {
+            options.storage_desc.pread.thread_count = static_cast<uint32_t>(std::stoul(args[++i]));
+        } else if(arg == "--huge-pages" && i + 1 < argc) {
+            options.huge_pages = parse_huge_page_mode(args[++i]);
+        } else if(arg == "--verify") {
+            if(!options.verify_desc) {
+                options.verify_desc.emplace();
+            }
+        } else if(arg == "--verify-retries" && i + 1 < argc) {
+            if(!options.verify_desc) {
+                options.verify_desc.emplace();
+            }
+            options.verify_desc->max_retries = static_cast<uint32_t>(std::stoul(args[++i]));
+#endif
+        } else {
+            throw std::runtime_error(std::format("Unknown argument: {}", arg));
+        }
     }
-}
 
-void throw_if_failed(VkResult result, const std::string_view& message) {
-    if(result != VK_SUCCESS) {
-        throw std::runtime_error(std::format("{} failed: {}", message, static_cast<int>(result)));
+    if(options.stress && options.host_upload) {
+        throw std::runtime_error("--stress streams through DirectStorage and can't be combined with --host-upload");
     }
-}
 
-std::vector<int8_t> read_binary_file(const std::string_view& path) {
-    auto* file = fopen(path.data(), "rb");
-    if(!file) {
-        throw std::runtime_error("fopen");
-    }
+    validate_thread_placement(options.placement);
 
-    fseek(file, 0, SEEK_END);
-    const auto length = ftell(file);
-    if(!length) {
-        throw std::runtime_error("ftell");
+#ifndef _WIN32
+    // Textures come from the daemon's process instead of being uploaded here
+    if(!options.shared_upload_socket.empty()) {
+        options.host_upload = false;
     }
-    fseek(file, 0, SEEK_SET);
-
-    std::vector<int8_t> buffer(length);
-    const auto length_read = fread(buffer.data(), 1, length, file);
-    if(length != length_read) {
-        throw std::runtime_error("fread");
-    }
-
-    fclose(file);
+#endif
 
-    return buffer;
+    return options;
 }
 
 void create_shader_module(VkDevice device, const std::string_view& path, VkShaderStageFlagBits stage, std::vector<VkPipelineShaderStageCreateInfo>& pipeline_shader_stage_create_infos) {
@@ -71,11 +230,12 @@ void create_shader_module(VkDevice device, const std::string_view& path, VkShade
     });
 }
 
-VkPipeline create_pipeline(VkDevice device, VkDescriptorSetLayout descriptor_set_layout, VkPipelineLayout& pipeline_layout) {
+VkPipeline create_pipeline(VkDevice device, VkDescriptorSetLayout descriptor_set_layout, const std::string_view& vertex_shader_path,
+                           const std::string_view& fragment_shader_path, VkPipelineLayout& pipeline_layout) {
     std::vector<VkPipelineShaderStageCreateInfo> pipeline_shader_stage_create_infos;
 
-    create_shader_module(device, "example.vert.spv", VK_SHADER_STAGE_VERTEX_BIT, pipeline_shader_stage_create_infos);
-    create_shader_module(device, "example.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT, pipeline_shader_stage_create_infos);
+    create_shader_module(device, vertex_shader_path, VK_SHADER_STAGE_VERTEX_BIT, pipeline_shader_stage_create_infos);
+    create_shader_module(device, fragment_shader_path, VK_SHADER_STAGE_FRAGMENT_BIT, pipeline_shader_stage_create_infos);
 
     VkPipelineLayoutCreateInfo pipeline_layout_create_info = {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
@@ -169,163 +329,144 @@ VkPipeline create_pipeline(VkDevice device, VkDescriptorSetLayout descriptor_set
     return pipeline;
 }
 
-uint32_t find_memory_type(VkPhysicalDevice physical_device, uint32_t memory_type_bits, VkMemoryPropertyFlags properties) {
-    VkPhysicalDeviceMemoryProperties physical_device_memory_properties;
-    vkGetPhysicalDeviceMemoryProperties(physical_device, &physical_device_memory_properties);
+std::vector<bindless_instance> create_instance_grid(uint32_t instance_count, uint32_t texture_index) {
+    if(instance_count == 0) {
+        return {};
+    }
 
-    for (auto i = 0; i < physical_device_memory_properties.memoryTypeCount; i++) {
-        if ((memory_type_bits & (1 << i)) && (physical_device_memory_properties.memoryTypes[i].propertyFlags & properties) == properties) {
-            return i;
-        }
+    const auto columns = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(instance_count))));
+    const auto cell_size = 2.0f / static_cast<float>(columns);
+
+    std::vector<bindless_instance> instances(instance_count);
+    for(auto i = 0u; i < instance_count; i++) {
+        instances[i] = bindless_instance {
+            .rect = {
+                -1.0f + static_cast<float>(i % columns) * cell_size,
+                -1.0f + static_cast<float>(i / columns) * cell_size,
+                cell_size * 0.9f,
+                cell_size * 0.9f
+            },
+            .texture_index = texture_index
+        };
     }
 
-    throw std::runtime_error("Invalid memory type!");
+    return instances;
 }
 
-VkImage create_image(VkDevice device, ID3D12Device8* d3d12_device, IDStorageFactory* dstorage_factory, IDStorageQueue* dstorage_queue,
-                     const std::wstring_view& path, VkDeviceMemory& memory, VkImageView& image_view) {
-    uint32_t width = 2048, height = 2048;
-
-    IDStorageFile* dstorage_file;
-    throw_if_failed(dstorage_factory->OpenFile(path.data(), IID_PPV_ARGS(&dstorage_file)), "IDStorageFactory::OpenFile"); //TODO: release me
-
-    BY_HANDLE_FILE_INFORMATION dstorage_file_information = {};
-    throw_if_failed(dstorage_file->GetFileInformation(&dstorage_file_information), "IDStorageFile::GetFileInformation");
-
-    D3D12_RESOURCE_DESC resource_desc = {
-        .Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D,
-        .Width = width,
-        .Height = height,
-        .DepthOrArraySize = 1,
-        .MipLevels = 1,
-        .Format = DXGI_FORMAT_R8G8B8A8_UNORM,
-        .SampleDesc = { .Count = 1, .Quality = 0 },
-        .Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN,
-        .Flags = D3D12_RESOURCE_FLAG_NONE
-    };
-
-    D3D12_HEAP_PROPERTIES heap_properties = {
-        .Type = D3D12_HEAP_TYPE_DEFAULT
-    };
-
-    ID3D12Resource* resource;
-    throw_if_failed(d3d12_device->CreateCommittedResource(&heap_properties, D3D12_HEAP_FLAG_SHARED, &resource_desc, D3D12_RESOURCE_STATE_COMMON, nullptr, IID_PPV_ARGS(&resource)),
-                    "ID3D12Device::CreateCommittedResource");
-
-    HANDLE handle;
-    throw_if_failed(d3d12_device->CreateSharedHandle(resource, nullptr, GENERIC_ALL, nullptr, &handle), "ID3D12Device::CreateSharedHandle");
-
-    VkExternalMemoryImageCreateInfo external_memory_image_create_info = {
-        .sType = VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_IMAGE_CREATE_INFO,
-        .handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_D3D12_RESOURCE_BIT
-    };
+std::vector<std::wstring> find_stress_assets(const example_options& options) {
+    if(options.stress_asset_directory.empty()) {
+        return { L"example.dds" };
+    }
 
-    VkImageCreateInfo image_create_info = {
-        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
-        .pNext = &external_memory_image_create_info,
-        .imageType = VK_IMAGE_TYPE_2D,
-        .format = VK_FORMAT_R8G8B8A8_UNORM,
-        .extent = { .width = width, .height = height, .depth = 1 },
-        .mipLevels = 1,
-        .arrayLayers = 1,
-        .samples = VK_SAMPLE_COUNT_1_BIT,
-        .tiling = VK_IMAGE_TILING_OPTIMAL,
-        .usage = VK_IMAGE_USAGE_SAMPLED_BIT
-    };
+    std::vector<std::wstring> asset_paths;
+    for(const auto& entry : std::filesystem::directory_iterator(options.stress_asset_directory)) {
+        if(entry.is_regular_file()) {
+            asset_paths.push_back(entry.path().wstring());
+        }
+    }
 
-    VkImage image;
-    throw_if_failed(vkCreateImage(device, &image_create_info, nullptr, &image), "vkCreateImage");
+    std::sort(asset_paths.begin(), asset_paths.end());
 
-    VkImportMemoryWin32HandleInfoKHR import_memory_win32_handle_info = {
-        .sType = VK_STRUCTURE_TYPE_IMPORT_MEMORY_WIN32_HANDLE_INFO_KHR,
-        .handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_D3D12_RESOURCE_BIT,
-        .handle = handle
-    };
+    return asset_paths;
+}
 
-    VkMemoryAllocateInfo memory_allocate_info = {
-        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-        .pNext = &import_memory_win32_handle_info
-    };
+void report_thread_placement(const thread_placement_desc& placement) {
+    for(const auto& node : system_topology().nodes) {
+        printf("NUMA node %u: CPUs %s\n", node.id, format_cpu_list(node.cpus).c_str());
+    }
 
-    throw_if_failed(vkAllocateMemory(device, &memory_allocate_info, nullptr, &memory), "vkAllocateMemory");
-    CloseHandle(handle);
+    if(placement.io_node >= 0) {
+        const auto hints = interrupt_affinity_hints(static_cast<uint32_t>(placement.io_node));
+        if(!hints.empty()) {
+            printf("To take NVMe interrupts on the I/O node as well, run as root:\n%s", hints.c_str());
+        }
+    }
+}
 
-    throw_if_failed(vkBindImageMemory(device, image, memory, 0), "vkBindImageMemory");
+void init(const example_options& options) {
+    if(options.placement.pin) {
+        report_thread_placement(options.placement);
+    }
 
-    ID3D12Fence* fence;
-    throw_if_failed(d3d12_device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&fence)), "ID3D12Device::CreateFence");
+    if(!options.write_checksums_path.empty()) {
+        const auto checksums = compute_chunk_checksums(options.write_checksums_path, options.checksum_chunk_size);
+        const auto path = chunk_checksum_path(options.write_checksums_path);
+        write_chunk_checksums(path, checksums);
+        printf("Wrote %zu checksums of %llu byte chunks to %s\n", checksums.hashes.size(), static_cast<unsigned long long>(checksums.chunk_size), path.string().c_str());
+        return;
+    }
 
-    auto fenceEvent = CreateEvent(nullptr, false, false, nullptr);
-    if(!fenceEvent) {
-        throw std::runtime_error("CreateEvent failed");
+#ifndef _WIN32
+    if(!options.stream_daemon_socket.empty()) {
+        stream_daemon daemon(options.stream_daemon_socket);
+        daemon.run();
+        return;
     }
 
-    DSTORAGE_REQUEST request = {
-        .Options = {
-            .SourceType = DSTORAGE_REQUEST_SOURCE_FILE,
-            .DestinationType = DSTORAGE_REQUEST_DESTINATION_TEXTURE_REGION,
-        },
-        .Source = {
-            .File = {
-                .Source = dstorage_file,
-                .Size = dstorage_file_information.nFileSizeLow,
-            }
-        },
-        .Destination = {
-            .Texture = {
-                .Resource = resource,
-                .Region = {
-                    .left = 0,
-                    .top = 0,
-                    .front = 0,
-                    .right = width,
-                    .bottom = height,
-                    .back = 1
-                }
-            }
-        },
-        .UncompressedSize = dstorage_file_information.nFileSizeLow
-    };
+    if(!options.stream_server_socket.empty()) {
+        auto stream_desc = options.stream_desc;
+
+        // The server loop is the submission thread; staging and cache memory live on its node
+        place_current_thread(options.placement, thread_role::submission, 0);
+        const auto memory_node = options.placement.pin ? static_cast<int32_t>(placement_node(options.placement, thread_role::submission, 0)) : -1;
+
+        // The emulated backend holds completions back past the device's signal, the verifying backend holds them
+        // until their chunks are hashed and the cache's disk tier completes reads on its own thread, so the server
+        // can only sleep on the device's signal with none of them
+        auto storage_desc = options.storage_desc;
+        storage_desc.uring.signal_completions = !options.emulated_desc && !options.verify_desc && options.cache_desc.disk_directory.empty();
+        storage_desc.uring.huge_pages = options.huge_pages;
+        storage_desc.uring.numa_node = memory_node;
+        storage_desc.pread.placement = options.placement;
+        stream_desc.huge_pages = options.huge_pages;
+        stream_desc.numa_node = memory_node;
+
+        auto [device, device_kind] = create_storage_backend(storage_desc);
+        printf("Reading through %s\n", storage_backend_name(device_kind));
+        if(device_kind == storage_backend_kind::io_uring) {
+            stream_desc.backend_event = static_cast<io_uring_backend&>(*device).completion_event();
+        }
 
-    dstorage_queue->EnqueueRequest(&request);
+        std::optional<emulated_backend> emulated;
+        if(options.emulated_desc) {
+            auto emulated_desc = *options.emulated_desc;
+            emulated_desc.huge_pages = options.huge_pages;
+            emulated.emplace(*device, emulated_desc);
+        }
 
-    dstorage_queue->EnqueueSignal(fence, 1);
-    dstorage_queue->Submit();
+        storage_backend* backend = emulated ? static_cast<storage_backend*>(&*emulated) : device.get();
 
-    fence->SetEventOnCompletion(1, fenceEvent);
-    if(fence->GetCompletedValue() < 1) {
-        WaitForSingleObject(fenceEvent, INFINITE);
-    }
+        std::optional<autotuning_backend> autotuning;
+        if(options.autotune) {
+            backend = &autotuning.emplace(*backend, options.autotune_desc);
+        }
 
-    CloseHandle(fenceEvent);
-    fence->Release();
+        // Below the coalescing backend, so merged reads are checked as one and the cache only keeps verified data
+        std::optional<job_system> verify_jobs;
+        std::optional<verifying_backend> verifying;
+        if(options.verify_desc) {
+            verify_jobs.emplace(job_system::default_worker_count(), options.placement);
+            backend = &verifying.emplace(*backend, *options.verify_desc, &*verify_jobs);
+        }
 
-    dstorage_file->Release();
+        auto cache_desc = options.cache_desc;
+        cache_desc.huge_pages = options.huge_pages;
+        cache_desc.numa_node = memory_node;
 
-    VkImageViewCreateInfo image_view_create_info = {
-        .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
-        .image = image,
-        .viewType = VK_IMAGE_VIEW_TYPE_2D,
-        .format = VK_FORMAT_R8G8B8A8_UNORM,
-        .components = VkComponentMapping {
-            .r = VK_COMPONENT_SWIZZLE_IDENTITY,
-            .g = VK_COMPONENT_SWIZZLE_IDENTITY,
-            .b = VK_COMPONENT_SWIZZLE_IDENTITY,
-            .a = VK_COMPONENT_SWIZZLE_IDENTITY
-        },
-        .subresourceRange = VkImageSubresourceRange {
-            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-            .levelCount = 1,
-            .layerCount = 1
-        }
-    };
+        coalescing_backend coalescing(*backend, coalescing_desc {});
+        caching_backend cache(coalescing, cache_desc);
 
-    throw_if_failed(vkCreateImageView(device, &image_view_create_info, nullptr, &image_view), "vkCreateImageView");
+        std::optional<tracing_backend> tracing;
+        if(!options.io_trace_path.empty()) {
+            tracing.emplace(cache, options.io_trace_path);
+        }
 
-    return image;
-}
+        stream_server server(options.stream_server_socket, tracing ? static_cast<storage_backend&>(*tracing) : cache, stream_desc, &cache, verifying ? &*verifying : nullptr);
+        server.run();
+        return;
+    }
+#endif
 
-void init() {
     if(SDL_Init(SDL_INIT_VIDEO) != 0) {
         throw std::runtime_error(std::format("{} failed: {}", "SDL_Init", SDL_GetError()));
     }
@@ -387,8 +528,17 @@ void init() {
 
     auto physical_device = physical_devices[0];
 
+    VkPhysicalDeviceDescriptorIndexingFeatures physical_device_descriptor_indexing_features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES
+    };
+
+    if(options.bindless) {
+        bindless_texture_table::enable_features(physical_device, physical_device_descriptor_indexing_features);
+    }
+
     VkPhysicalDeviceDynamicRenderingFeatures physical_device_dynamic_rendering_features = {
         .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES,
+        .pNext = options.bindless ? &physical_device_descriptor_indexing_features : nullptr,
         .dynamicRendering = VK_TRUE
     };
 
@@ -406,7 +556,22 @@ void init() {
     };
 
     std::vector<const char*> enabled_device_layers = {};
-    std::vector<const char*> enabled_device_extensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME, VK_KHR_EXTERNAL_MEMORY_WIN32_EXTENSION_NAME, VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME };
+    std::vector<const char*> enabled_device_extensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME, VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME };
+#ifdef _WIN32
+    enabled_device_extensions.push_back(VK_KHR_EXTERNAL_MEMORY_WIN32_EXTENSION_NAME);
+#endif
+
+    host_texture_uploader host_uploader;
+    if(options.host_upload) {
+        host_uploader.enable_device_features(physical_device, options.host_desc, enabled_device_extensions, physical_device_features);
+    }
+
+#ifndef _WIN32
+    shared_texture_client shared_client;
+    if(!options.shared_upload_socket.empty()) {
+        shared_texture_client::enable_device_extensions(enabled_device_extensions);
+    }
+#endif
 
     VkDeviceCreateInfo device_create_info = {
         .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
@@ -427,6 +592,166 @@ void init() {
     VkQueue queue;
     vkGetDeviceQueue(device, 0, 0, &queue);
 
+    VkSamplerCreateInfo sampler_create_info = {
+        .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+        .magFilter = VK_FILTER_LINEAR,
+        .minFilter = VK_FILTER_LINEAR,
+        .mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR,
+        .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER,
+        .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER,
+        .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER
+    };
+
+    VkSampler sampler;
+    throw_if_failed(vkCreateSampler(device, &sampler_create_info, nullptr, &sampler), "vkCreateSampler");
+
+    bindless_texture_table texture_table;
+    VkDescriptorSetLayout descriptor_set_layout;
+
+    if(options.bindless) {
+        texture_table.create(physical_device, device, sampler);
+        descriptor_set_layout = texture_table.descriptor_set_layout();
+    } else {
+        VkDescriptorSetLayoutBinding descriptor_set_layout_binding = {
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT
+        };
+
+        VkDescriptorSetLayoutCreateInfo descriptor_set_layout_create_info = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+            .flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR,
+            .bindingCount = 1,
+            .pBindings = &descriptor_set_layout_binding
+        };
+
+        throw_if_failed(vkCreateDescriptorSetLayout(device, &descriptor_set_layout_create_info, nullptr, &descriptor_set_layout), "vkCreateDescriptorSetLayout");
+    }
+
+    // Pipeline compilation, storage setup plus the first load, and the presentation objects below don't
+    // depend on each other, so the first two run on the job system while this thread does the third
+    job_system jobs(job_system::default_worker_count(), options.placement);
+
+    VkPipelineLayout pipeline_layout;
+    VkPipeline pipeline;
+
+    const auto pipeline_job = jobs.schedule([&] {
+        if(options.bindless) {
+            pipeline = create_pipeline(device, descriptor_set_layout, "bindless.vert.spv", "bindless.frag.spv", pipeline_layout);
+        } else {
+            pipeline = create_pipeline(device, descriptor_set_layout, "example.vert.spv", "example.frag.spv", pipeline_layout);
+        }
+    });
+
+    load_telemetry telemetry;
+    host_texture host_example_texture = {};
+    VkImageView example_image_view = VK_NULL_HANDLE;
+
+#ifdef _WIN32
+    ID3D12Device8* d3d12_device = nullptr;
+    IDStorageFactory* dstorage_factory = nullptr;
+    IDStorageQueue* dstorage_queue = nullptr;
+    // Outlives the submission queue, which asks it from its own thread
+    std::optional<streaming_budget> budget;
+    if(options.qos) {
+        budget.emplace(options.budget_desc);
+    }
+
+    std::unique_ptr<texture_loader> loader;
+    std::unique_ptr<load_submission_queue> submission_queue;
+    texture example_texture = {};
+    std::future<texture> example_load;
+#endif
+
+    job_handle loader_job;
+
+#ifndef _WIN32
+    if(!options.shared_upload_socket.empty()) {
+        loader_job = jobs.schedule([&] {
+            shared_client.create(physical_device, device, queue, 0, options.shared_upload_socket);
+            // The daemon reads raw texels, so it gets the offset of mip 0 past any container header
+            const auto layout = read_texture_layout("example.dds", 2048, 2048);
+            const auto& top_mip = layout.subresources[0];
+            shared_client.request("example.dds", top_mip.offset, top_mip.width, top_mip.height);
+
+            // The acquire is submitted to the render queue, which nothing else uses before the first frame
+            std::vector<shared_texture_completion> completions;
+            while(completions.empty()) {
+                shared_client.poll(completions);
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+
+            host_example_texture = completions[0].texture;
+            example_image_view = host_example_texture.image_view;
+        });
+    } else
+#endif
+    if(options.host_upload) {
+        loader_job = jobs.schedule([&] {
+            host_uploader.create(physical_device, device, queue, 0);
+
+#ifndef _WIN32
+            if(!options.stream_client_socket.empty()) {
+                // The server reads raw texels, so it gets the offset of mip 0 past any container header
+                const auto layout = read_texture_layout("example.dds", 2048, 2048);
+                const auto& top_mip = layout.subresources[0];
+                const auto size = static_cast<uint64_t>(top_mip.width) * top_mip.height * 4;
+
+                stream_client client(options.stream_client_socket, size);
+                client.submit("example.dds", top_mip.offset, top_mip.width, top_mip.height, 0, 0);
+
+                std::vector<stream_completion> completions;
+                while(completions.empty()) {
+                    client.wait();
+                    client.poll(completions);
+                }
+
+                if(!completions[0].success) {
+                    throw std::runtime_error("Stream server failed to read example.dds");
+                }
+
+                host_example_texture = host_uploader.upload(std::span<const uint8_t>(client.arena(), size), top_mip.width, top_mip.height);
+                example_image_view = host_example_texture.image_view;
+                return;
+            }
+#endif
+
+            // The host path uploads mip 0, which starts after any container header
+            const mapped_file example_file("example.dds");
+            const auto header_size = std::min<uint64_t>(example_file.size(), texture_header_size);
+            const auto layout = parse_texture_layout(std::span(example_file.data(), header_size), example_file.size(), 2048, 2048);
+            host_example_texture = host_uploader.upload(example_file, layout.subresources[0].offset, 2048, 2048);
+            example_image_view = host_example_texture.image_view;
+        });
+    } else {
+#ifdef _WIN32
+        const auto storage_job = jobs.schedule([&] {
+            throw_if_failed(D3D12CreateDevice(nullptr, D3D_FEATURE_LEVEL_12_0, IID_PPV_ARGS(&d3d12_device)), "D3D12CreateDevice");
+
+            DSTORAGE_QUEUE_DESC queue_desc = {
+                .SourceType = DSTORAGE_REQUEST_SOURCE_FILE,
+                .Capacity = DSTORAGE_MAX_QUEUE_CAPACITY,
+                .Priority = DSTORAGE_PRIORITY_NORMAL,
+                .Device = d3d12_device
+            };
+
+            throw_if_failed(DStorageGetFactory(IID_PPV_ARGS(&dstorage_factory)), "DStorageGetFactory");
+            throw_if_failed(dstorage_factory->CreateQueue(&queue_desc, IID_PPV_ARGS(&dstorage_queue)), "IDStorageFactory::CreateQueue");
+        });
+
+        const job_handle loader_dependencies[] = { storage_job };
+        loader_job = jobs.schedule([&] {
+            loader = std::make_unique<texture_loader>(device, d3d12_device, dstorage_factory, dstorage_queue, telemetry);
+            submission_queue = std::make_unique<load_submission_queue>(*loader, telemetry, jobs, budget ? &*budget : nullptr, options.placement);
+
+            // Waiting here would hold a worker for the whole load, and the load resumes on the job system
+            if(!options.stress) {
+                example_load = start_task(submission_queue->load_texture(L"example.dds", 2048, 2048));
+            }
+        }, loader_dependencies);
+#endif
+    }
+
     VkSwapchainCreateInfoKHR swapchain_create_info = {
         .sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
         .surface = surface,
@@ -508,61 +833,31 @@ void init() {
     VkCommandBuffer command_buffer;
     vkAllocateCommandBuffers(device, &command_buffer_allocate_info, &command_buffer);
 
-    VkDescriptorSetLayoutBinding descriptor_set_layout_binding = {
-        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-        .descriptorCount = 1,
-        .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT
-    };
+    jobs.wait(pipeline_job);
+    jobs.wait(loader_job);
 
-    VkDescriptorSetLayoutCreateInfo descriptor_set_layout_create_info = {
-        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
-        .flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR,
-        .bindingCount = 1,
-        .pBindings = &descriptor_set_layout_binding
-    };
-
-    VkDescriptorSetLayout descriptor_set_layout;
-    throw_if_failed(vkCreateDescriptorSetLayout(device, &descriptor_set_layout_create_info, nullptr, &descriptor_set_layout), "vkCreateDescriptorSetLayout");
-
-    VkPipelineLayout pipeline_layout;
-    auto pipeline = create_pipeline(device, descriptor_set_layout, pipeline_layout);
-
-    ID3D12Device8* d3d12_device;
-    throw_if_failed(D3D12CreateDevice(nullptr, D3D_FEATURE_LEVEL_12_0, IID_PPV_ARGS(&d3d12_device)), "D3D12CreateDevice");
-
-    DSTORAGE_QUEUE_DESC queue_desc = {
-        .SourceType = DSTORAGE_REQUEST_SOURCE_FILE,
-        .Capacity = DSTORAGE_MAX_QUEUE_CAPACITY,
-        .Priority = DSTORAGE_PRIORITY_NORMAL,
-        .Device = d3d12_device
-    };
-
-    IDStorageFactory* dstorage_factory;
-    throw_if_failed(DStorageGetFactory(IID_PPV_ARGS(&dstorage_factory)), "DStorageGetFactory");
-
-    IDStorageQueue* dstorage_queue;
-    throw_if_failed(dstorage_factory->CreateQueue(&queue_desc, IID_PPV_ARGS(&dstorage_queue)), "IDStorageFactory::CreateQueue");
-
-    VkDeviceMemory image_memory;
-    VkImageView image_view;
-    auto image = create_image(device, d3d12_device, dstorage_factory, dstorage_queue, L"example.dds", image_memory, image_view);
+#ifdef _WIN32
+    if(example_load.valid()) {
+        example_texture = example_load.get();
+        example_image_view = example_texture.image_view;
+    }
 
-    VkSamplerCreateInfo sampler_create_info = {
-        .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
-        .magFilter = VK_FILTER_LINEAR,
-        .minFilter = VK_FILTER_LINEAR,
-        .mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR,
-        .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER,
-        .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER,
-        .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER
-    };
+    std::unique_ptr<stress_scene> scene;
+    if(options.stress) {
+        scene = std::make_unique<stress_scene>(*loader, *submission_queue, texture_table, find_stress_assets(options), options.stress_desc);
+    }
+#endif
 
-    VkSampler sampler;
-    throw_if_failed(vkCreateSampler(device, &sampler_create_info, nullptr, &sampler), "vkCreateSampler");
+    if(options.bindless && !options.stress) {
+        const auto texture_index = texture_table.add_texture(example_image_view);
+        texture_table.set_instances(create_instance_grid(options.bindless_instance_count, texture_index));
+    }
 
     bool running = true;
     SDL_Event ev;
 
+    auto last_frame_time = std::chrono::steady_clock::now();
+
     while(running) {
         while(SDL_PollEvent(&ev)) {
             if(ev.type == SDL_QUIT) {
@@ -570,6 +865,17 @@ void init() {
             }
         }
 
+        const auto frame_time = std::chrono::steady_clock::now();
+        const auto frame_duration = frame_time - last_frame_time;
+        const auto frame_seconds = std::chrono::duration<double>(frame_duration).count();
+        last_frame_time = frame_time;
+
+#ifdef _WIN32
+        if(budget) {
+            budget->end_frame(frame_duration);
+        }
+#endif
+
         throw_if_failed(vkResetCommandBuffer(command_buffer, VK_COMMAND_BUFFER_RESET_RELEASE_RESOURCES_BIT), "vkResetCommandBuffer");
         throw_if_failed(vkResetCommandPool(device, command_pool, VK_COMMAND_POOL_RESET_RELEASE_RESOURCES_BIT), "vkResetCommandPool");
 
@@ -612,26 +918,18 @@ void init() {
             }
         };
 
-        static bool imageTransitioned = false;
-        VkImageMemoryBarrier image_image_memory_barrier = {
-            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-            .srcAccessMask = 0,
-            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
-            .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-            .newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-            .image = image,
-            .subresourceRange = VkImageSubresourceRange {
-                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-                .levelCount = 1,
-                .layerCount = 1
+#ifdef _WIN32
+        if(scene) {
+            scene->update(frame_seconds, command_buffer);
+            if(scene->finished()) {
+                running = false;
             }
-        };
+        }
 
-        if(!imageTransitioned) {
-            vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr,
-                                 1, &image_image_memory_barrier);
-            imageTransitioned = true;
+        if(loader) {
+            loader->record_transitions(command_buffer);
         }
+#endif
 
         VkRenderingInfo rendering_info = {
             .sType = VK_STRUCTURE_TYPE_RENDERING_INFO,
@@ -645,23 +943,28 @@ void init() {
 
         vkCmdBeginRendering(command_buffer, &rendering_info);
 
-        VkDescriptorImageInfo descriptor_image_info = {
-            .sampler = sampler,
-            .imageView = image_view,
-            .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
-        };
-
-        VkWriteDescriptorSet write_descriptor_set = {
-            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-            .descriptorCount = 1,
-            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-            .pImageInfo = &descriptor_image_info
-        };
-
-        vkCmdPushDescriptorSetKHR(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, 0, 1, &write_descriptor_set);
-
         vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
-        vkCmdDraw(command_buffer, 6, 1, 0, 0);
+
+        if(options.bindless) {
+            texture_table.bind(command_buffer, pipeline_layout);
+            vkCmdDraw(command_buffer, 6, texture_table.instance_count(), 0, 0);
+        } else {
+            VkDescriptorImageInfo descriptor_image_info = {
+                .sampler = sampler,
+                .imageView = example_image_view,
+                .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+            };
+
+            VkWriteDescriptorSet write_descriptor_set = {
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .descriptorCount = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                .pImageInfo = &descriptor_image_info
+            };
+
+            vkCmdPushDescriptorSetKHR(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, 0, 1, &write_descriptor_set);
+            vkCmdDraw(command_buffer, 6, 1, 0, 0);
+        }
 
         vkCmdEndRendering(command_buffer);
 
@@ -703,24 +1006,71 @@ void init() {
 
         throw_if_failed(vkWaitForFences(device, 1, &fence, VK_TRUE, std::numeric_limits<uint64_t>::max()), "vkWaitForFences");
         throw_if_failed(vkResetFences(device, 1, &fence), "vkResetFences");
+
+        telemetry.dump_if_due(std::chrono::seconds(5));
     }
 
     throw_if_failed(vkDeviceWaitIdle(device), "vkDeviceWaitIdle");
 
-    vkDestroySampler(device, sampler, nullptr);
+    telemetry.dump(stdout);
+
+    if(options.host_upload) {
+        host_uploader.destroy_texture(host_example_texture);
+        host_uploader.destroy();
+
+        const auto host_stats = host_uploader.stats();
+        printf("host uploads: %llu host image copies, %llu zero-copy, %llu staged, %llu import fallbacks, %llu bytes\n",
+               static_cast<unsigned long long>(host_stats.host_image_copies), static_cast<unsigned long long>(host_stats.zero_copy_uploads),
+               static_cast<unsigned long long>(host_stats.staged_uploads), static_cast<unsigned long long>(host_stats.import_fallbacks),
+               static_cast<unsigned long long>(host_stats.bytes_uploaded));
+    }
+
+#ifndef _WIN32
+    if(!options.shared_upload_socket.empty()) {
+        shared_client.destroy_texture(host_example_texture);
+        shared_client.destroy();
+    }
+#endif
+
+#ifdef _WIN32
+    if(budget) {
+        const auto budget_stats = budget->stats();
+        printf("streaming budget: %llu of %llu frames over target, %llu loads (%llu bytes) admitted, %llu deferrals (%llu at the frame byte cap, %llu at the frame CPU cap), final scale %.3f\n",
+               static_cast<unsigned long long>(budget_stats.slow_frames), static_cast<unsigned long long>(budget_stats.frames),
+               static_cast<unsigned long long>(budget_stats.admitted_loads), static_cast<unsigned long long>(budget_stats.admitted_bytes),
+               static_cast<unsigned long long>(budget_stats.deferrals), static_cast<unsigned long long>(budget_stats.frame_byte_caps),
+               static_cast<unsigned long long>(budget_stats.frame_cpu_caps), budget_stats.scale);
+    }
 
-    vkDestroyImageView(device, image_view, nullptr);
-    vkFreeMemory(device, image_memory, nullptr);
-    vkDestroyImage(device, image, nullptr);
+    if(scene) {
+        scene->report(stdout);
+        scene->release_all();
+        scene.reset();
+    } else if(loader) {
+        loader->release_texture(example_texture);
+    }
+
+    submission_queue.reset();
 
-    dstorage_queue->Release();
-    dstorage_factory->Release();
-    d3d12_device->Release();
+    loader.reset();
+
+    if(d3d12_device) {
+        dstorage_queue->Release();
+        dstorage_factory->Release();
+        d3d12_device->Release();
+    }
+#endif
 
     vkDestroyPipeline(device, pipeline, nullptr);
     vkDestroyPipelineLayout(device, pipeline_layout, nullptr);
 
-    vkDestroyDescriptorSetLayout(device, descriptor_set_layout, nullptr);
+    if(options.bindless) {
+        texture_table.destroy();
+    } else {
+        vkDestroyDescriptorSetLayout(device, descriptor_set_layout, nullptr);
+    }
+
+    vkDestroySampler(device, sampler, nullptr);
 
     vkFreeCommandBuffers(device, command_pool, 1, &command_buffer);
     vkDestroyCommandPool(device, command_pool, nullptr);
@@ -746,7 +1096,7 @@ void init() {
 
 int main(int argc, char** args) {
     try {
-        init();
+        init(parse_options(argc, args));
     } catch(const std::exception& ex) {
         printf("%s\n", ex.what());
         return 1;
@@ -0,0 +1,120 @@
+#include "mapped_file.hpp"
+#include <format>
+#include <stdexcept>
+#include <system_error>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    uint64_t align_up(uint64_t value, uint64_t alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    [[noreturn]] void throw_last_error(const std::string_view& message, const std::filesystem::path& path) {
+#ifdef _WIN32
+        const auto error = static_cast<int>(GetLastError());
+#else
+        const auto error = errno;
+#endif
+        throw std::runtime_error(std::format("{} failed for {}: {}", message, path.string(), std::system_category().message(error)));
+    }
+}
+
+#ifdef _WIN32
+
+mapped_file::mapped_file(const std::filesystem::path& path) {
+    _file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if(_file == INVALID_HANDLE_VALUE) {
+        throw_last_error("CreateFileW", path);
+    }
+
+    LARGE_INTEGER file_size;
+    if(!GetFileSizeEx(_file, &file_size)) {
+        CloseHandle(_file);
+        throw_last_error("GetFileSizeEx", path);
+    }
+
+    _size = static_cast<uint64_t>(file_size.QuadPart);
+    _mapped_size = align_up(_size, page_size());
+    if(_size == 0) {
+        return;
+    }
+
+    _mapping = CreateFileMappingW(_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if(!_mapping) {
+        CloseHandle(_file);
+        throw_last_error("CreateFileMappingW", path);
+    }
+
+    _data = static_cast<const uint8_t*>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0));
+    if(!_data) {
+        CloseHandle(_mapping);
+        CloseHandle(_file);
+        throw_last_error("MapViewOfFile", path);
+    }
+}
+
+mapped_file::~mapped_file() {
+    if(_data) {
+        UnmapViewOfFile(_data);
+    }
+    if(_mapping) {
+        CloseHandle(_mapping);
+    }
+    CloseHandle(_file);
+}
+
+uint64_t mapped_file::page_size() {
+    SYSTEM_INFO system_info;
+    GetSystemInfo(&system_info);
+    return system_info.dwPageSize;
+}
+
+#else
+
+mapped_file::mapped_file(const std::filesystem::path& path) {
+    const auto file = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(file < 0) {
+        throw_last_error("open", path);
+    }
+
+    struct stat file_status;
+    if(fstat(file, &file_status) != 0) {
+        close(file);
+        throw_last_error("fstat", path);
+    }
+
+    _size = static_cast<uint64_t>(file_status.st_size);
+    _mapped_size = align_up(_size, page_size());
+
+    if(_size > 0) {
+        const auto data = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, file, 0);
+        if(data == MAP_FAILED) {
+            close(file);
+            throw_last_error("mmap", path);
+        }
+        _data = static_cast<const uint8_t*>(data);
+    }
+
+    // The mapping keeps its own reference to the file
+    close(file);
+}
+
+mapped_file::~mapped_file() {
+    if(_data) {
+        munmap(const_cast<uint8_t*>(_data), _size);
+    }
+}
+
+uint64_t mapped_file::page_size() {
+    return static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+}
+
+#endif
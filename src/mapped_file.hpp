@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+
+// Read-only mapping of a whole file. The mapping covers whole pages, so mapped_size() can be larger
+// than size(); the bytes past the end of the file read as zero.
+class mapped_file {
+public:
+    explicit mapped_file(const std::filesystem::path& path);
+    ~mapped_file();
+
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+
+    const uint8_t* data() const { return _data; }
+    uint64_t size() const { return _size; }
+    uint64_t mapped_size() const { return _mapped_size; }
+
+    static uint64_t page_size();
+
+private:
+    const uint8_t* _data = nullptr;
+    uint64_t _size = 0;
+    uint64_t _mapped_size = 0;
+
+#ifdef _WIN32
+    void* _file = nullptr;
+    void* _mapping = nullptr;
+#endif
+};
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <utility>
+
+inline constexpr size_t cache_line_size = 64;
+
+// Bounded multi-producer single-consumer ring. Every slot carries a sequence number that tells
+// producers and the consumer whose turn it is: producers claim a slot with a single CAS on the tail,
+// and the consumer only ever writes the sequence of the slot it releases.
+template<typename T>
+class mpsc_ring {
+public:
+    explicit mpsc_ring(size_t capacity) : _capacity(std::bit_ceil(capacity)), _mask(_capacity - 1), _slots(std::make_unique<slot[]>(_capacity)) {
+        for(size_t i = 0; i < _capacity; i++) {
+            _slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    bool try_push(T value) {
+        auto position = _tail.load(std::memory_order_relaxed);
+
+        for(;;) {
+            auto& slot = _slots[position & _mask];
+            const auto sequence = slot.sequence.load(std::memory_order_acquire);
+            const auto difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+
+            if(difference == 0) {
+                if(_tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    slot.value = std::move(value);
+                    slot.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if(difference < 0) {
+                return false;
+            } else {
+                position = _tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    std::optional<T> try_pop() {
+        auto& slot = _slots[_head & _mask];
+        if(slot.sequence.load(std::memory_order_acquire) != _head + 1) {
+            return std::nullopt;
+        }
+
+        auto value = std::move(slot.value);
+        slot.sequence.store(_head + _capacity, std::memory_order_release);
+        _head++;
+
+        return value;
+    }
+
+    size_t capacity() const { return _capacity; }
+
+private:
+    struct alignas(cache_line_size) slot {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    const size_t _capacity;
+    const size_t _mask;
+    std::unique_ptr<slot[]> _slots;
+
+    alignas(cache_line_size) std::atomic<size_t> _tail = 0;
+    alignas(cache_line_size) size_t _head = 0;
+};
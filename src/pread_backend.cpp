@@ -0,0 +1,288 @@
+#include "pread_backend.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <format>
+#include <stdexcept>
+#include <system_error>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+pread_backend::pread_backend(const pread_desc& desc) : _desc(desc) {
+    _desc.max_vector = std::clamp<uint32_t>(_desc.max_vector, 1, IOV_MAX);
+    _desc.max_read_size = std::max<uint64_t>(_desc.max_read_size, 1);
+
+    for(uint32_t i = 0; i < std::max(_desc.thread_count, 1u); i++) {
+        _io_threads.emplace_back([this, i] { io_main(i); });
+    }
+}
+
+pread_backend::~pread_backend() {
+    submit();
+
+    {
+        std::unique_lock lock(_mutex);
+        _completion_available.wait(lock, [&] { return _submitted.empty() && _reading == 0; });
+        _stopping = true;
+    }
+
+    _work_available.notify_all();
+    for(auto& thread : _io_threads) {
+        thread.join();
+    }
+
+    for(const auto& [id, entry] : _files) {
+        close(entry.descriptor);
+    }
+}
+
+uint64_t pread_backend::open_file(const std::filesystem::path& path) {
+    const auto descriptor = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(descriptor < 0) {
+        throw std::runtime_error(std::format("open failed for {}: {}", path.string(), std::system_category().message(errno)));
+    }
+
+    struct stat file_status;
+    if(fstat(descriptor, &file_status) != 0) {
+        const auto error = errno;
+        close(descriptor);
+        throw std::runtime_error(std::format("fstat failed for {}: {}", path.string(), std::system_category().message(error)));
+    }
+
+    std::lock_guard lock(_mutex);
+
+    const auto file = _next_file++;
+    _files.emplace(file, open_file_entry {
+        .descriptor = descriptor,
+        .size = static_cast<uint64_t>(file_status.st_size),
+        .reads = 0,
+        .closing = false
+    });
+
+    return file;
+}
+
+uint64_t pread_backend::file_size(uint64_t file) const {
+    std::lock_guard lock(_mutex);
+    return _files.at(file).size;
+}
+
+void pread_backend::close_file(uint64_t file) {
+    std::lock_guard lock(_mutex);
+
+    const auto it = _files.find(file);
+    if(it == _files.end()) {
+        return;
+    }
+
+    // An I/O thread may be reading with the descriptor, so the last read to finish closes it
+    it->second.closing = true;
+    if(it->second.reads == 0) {
+        finish_read(file);
+    }
+}
+
+void pread_backend::finish_read(uint64_t file) {
+    auto& entry = _files.at(file);
+    if(entry.reads > 0) {
+        entry.reads--;
+    }
+
+    if(!entry.closing || entry.reads > 0) {
+        return;
+    }
+
+    close(entry.descriptor);
+    _files.erase(file);
+}
+
+void pread_backend::enqueue(const read_request& request) {
+    {
+        // Counts as one read until submit() splits it into pieces
+        std::lock_guard lock(_mutex);
+        _files.at(request.file).reads++;
+    }
+    _queued.push_back(request);
+}
+
+void pread_backend::submit() {
+    if(_queued.empty()) {
+        return;
+    }
+
+    {
+        std::lock_guard lock(_mutex);
+        for(const auto& request : _queued) {
+            auto& file = _files.at(request.file);
+            const auto pending_id = _next_pending_id++;
+            auto& pending = _pending[pending_id] = pending_request {
+                .user_data = request.user_data,
+                .reads_left = 0,
+                .success = true
+            };
+
+            uint64_t done = 0;
+            do {
+                auto piece = request;
+                piece.offset = request.offset + done;
+                piece.size = std::min(request.size - done, _desc.max_read_size);
+                piece.destination = static_cast<uint8_t*>(request.destination) + done;
+                piece.user_data = pending_id;
+
+                _submitted.push_back(submitted_request {
+                    .request = piece,
+                    .descriptor = file.descriptor
+                });
+                pending.reads_left++;
+                file.reads++;
+                done += piece.size;
+            } while(done < request.size);
+
+            finish_read(request.file);
+        }
+        _stats.requests += _queued.size();
+    }
+
+    _queued.clear();
+    _work_available.notify_all();
+}
+
+void pread_backend::poll(std::vector<read_completion>& completions) {
+    std::lock_guard lock(_mutex);
+
+    completions.insert(completions.end(), _completed.begin(), _completed.end());
+    _completed.clear();
+}
+
+void pread_backend::wait() {
+    std::unique_lock lock(_mutex);
+    _completion_available.wait(lock, [&] { return !_completed.empty() || (_submitted.empty() && _reading == 0); });
+}
+
+size_t pread_backend::in_flight() const {
+    std::lock_guard lock(_mutex);
+    return _queued.size() + _pending.size();
+}
+
+pread_stats pread_backend::stats() const {
+    std::lock_guard lock(_mutex);
+    return _stats;
+}
+
+bool pread_backend::read_remaining(const submitted_request& submitted, uint64_t done, uint64_t& syscalls) {
+    auto* destination = static_cast<uint8_t*>(submitted.request.destination);
+
+    while(done < submitted.request.size) {
+        syscalls++;
+        const auto result = pread(submitted.descriptor, destination + done, submitted.request.size - done, static_cast<off_t>(submitted.request.offset + done));
+        if(result < 0 && errno == EINTR) {
+            continue;
+        }
+        if(result <= 0) {
+            return false;
+        }
+        done += static_cast<uint64_t>(result);
+    }
+
+    return true;
+}
+
+void pread_backend::io_main(uint32_t thread_index) {
+    place_current_thread(_desc.placement, thread_role::io, thread_index);
+
+    std::vector<submitted_request> batch;
+    std::vector<iovec> buffers;
+    std::vector<read_completion> completions;
+
+    std::unique_lock lock(_mutex);
+
+    for(;;) {
+        _work_available.wait(lock, [&] { return _stopping || !_submitted.empty(); });
+        if(_stopping) {
+            return;
+        }
+
+        batch.clear();
+        batch.push_back(_submitted.front());
+        _submitted.pop_front();
+        auto batch_size = batch.front().request.size;
+
+        while(!_submitted.empty() && batch.size() < _desc.max_vector) {
+            const auto& last = batch.back();
+            const auto& next = _submitted.front();
+            if(next.descriptor != last.descriptor || next.request.offset != last.request.offset + last.request.size ||
+               batch_size + next.request.size > _desc.max_read_size) {
+                break;
+            }
+            batch.push_back(next);
+            batch_size += next.request.size;
+            _submitted.pop_front();
+        }
+
+        _reading += batch.size();
+
+        lock.unlock();
+
+        uint64_t syscalls = 0;
+        completions.clear();
+
+        if(batch.size() == 1) {
+            completions.push_back(read_completion {
+                .user_data = batch.front().request.user_data,
+                .success = read_remaining(batch.front(), 0, syscalls)
+            });
+        } else {
+            buffers.clear();
+            for(const auto& submitted : batch) {
+                buffers.push_back(iovec {
+                    .iov_base = submitted.request.destination,
+                    .iov_len = submitted.request.size
+                });
+            }
+
+            ssize_t result;
+            do {
+                syscalls++;
+                result = preadv(batch.front().descriptor, buffers.data(), static_cast<int>(buffers.size()), static_cast<off_t>(batch.front().request.offset));
+            } while(result < 0 && errno == EINTR);
+
+            // A short read leaves the requests past its end to pread, which also tells a failure from the end of the file
+            auto remaining = static_cast<uint64_t>(std::max<ssize_t>(result, 0));
+            for(const auto& submitted : batch) {
+                const auto done = std::min(remaining, submitted.request.size);
+                remaining -= done;
+
+                completions.push_back(read_completion {
+                    .user_data = submitted.request.user_data,
+                    .success = done == submitted.request.size || read_remaining(submitted, done, syscalls)
+                });
+            }
+        }
+
+        lock.lock();
+
+        _reading -= batch.size();
+        _stats.syscalls += syscalls;
+        if(batch.size() > 1) {
+            _stats.vectored_reads++;
+        }
+        for(const auto& submitted : batch) {
+            finish_read(submitted.request.file);
+        }
+        for(const auto& completion : completions) {
+            auto& pending = _pending.at(completion.user_data);
+            pending.success = pending.success && completion.success;
+            if(--pending.reads_left == 0) {
+                _completed.push_back(read_completion {
+                    .user_data = pending.user_data,
+                    .success = pending.success
+                });
+                _pending.erase(completion.user_data);
+            }
+        }
+
+        _completion_available.notify_all();
+    }
+}
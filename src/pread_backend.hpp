@@ -0,0 +1,99 @@
+#pragma once
+
+#include "cpu_topology.hpp"
+#include "storage_backend.hpp"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+struct pread_desc {
+    uint32_t thread_count = 4;
+    // Requests that continue each other in the same file are read by one preadv of up to this many buffers
+    uint32_t max_vector = 64;
+    // Longer requests are split into reads of this size, which the threads work on in parallel; a preadv
+    // doesn't merge past it either
+    uint64_t max_read_size = 8 * 1024 * 1024;
+    // The I/O threads are placed as thread_role::io
+    thread_placement_desc placement;
+};
+
+struct pread_stats {
+    uint64_t requests;
+    uint64_t syscalls;
+    uint64_t vectored_reads;
+};
+
+// storage_backend for POSIX systems without DirectStorage or io_uring. submit() hands the queued
+// requests to a shared queue that a fixed pool of I/O threads drains in submission order. A thread
+// takes the request at the front together with the requests right behind it that continue it in the
+// same file, and reads them with one preadv; everything else is read with pread. Requests longer than
+// max_read_size are queued as several reads and complete when the last of them has.
+class pread_backend final : public storage_backend {
+public:
+    explicit pread_backend(const pread_desc& desc = {});
+    ~pread_backend() override;
+
+    uint64_t open_file(const std::filesystem::path& path) override;
+    uint64_t file_size(uint64_t file) const override;
+    void close_file(uint64_t file) override;
+
+    void enqueue(const read_request& request) override;
+    void submit() override;
+    void poll(std::vector<read_completion>& completions) override;
+    void wait() override;
+
+    size_t in_flight() const override;
+
+    pread_stats stats() const;
+
+private:
+    struct open_file_entry {
+        int descriptor;
+        uint64_t size;
+        // Queued and submitted reads, which need the descriptor until they are done
+        size_t reads;
+        bool closing;
+    };
+
+    struct pending_request {
+        uint64_t user_data;
+        uint32_t reads_left;
+        bool success;
+    };
+
+    // A read of a request or of a piece of it; the user data of the request is its pending id
+    struct submitted_request {
+        read_request request;
+        int descriptor;
+    };
+
+    void io_main(uint32_t thread_index);
+    // Called with the mutex held; closes the file once it is closing and its last read is done
+    void finish_read(uint64_t file);
+    // Reads the rest of a request with pread, starting done bytes in
+    static bool read_remaining(const submitted_request& submitted, uint64_t done, uint64_t& syscalls);
+
+    pread_desc _desc;
+
+    mutable std::mutex _mutex;
+    std::condition_variable _work_available;
+    std::condition_variable _completion_available;
+    bool _stopping = false;
+
+    std::unordered_map<uint64_t, open_file_entry> _files;
+    uint64_t _next_file = 1;
+
+    std::vector<read_request> _queued;
+    std::unordered_map<uint64_t, pending_request> _pending;
+    uint64_t _next_pending_id = 1;
+    std::deque<submitted_request> _submitted;
+    std::vector<read_completion> _completed;
+    size_t _reading = 0;
+
+    pread_stats _stats = {};
+
+    std::vector<std::thread> _io_threads;
+};
@@ -0,0 +1,300 @@
+#include "shared_texture_client.hpp"
+#include <cstring>
+#include <format>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+
+void shared_texture_client::enable_device_extensions(std::vector<const char*>& enabled_device_extensions) {
+    enabled_device_extensions.push_back(VK_KHR_EXTERNAL_MEMORY_FD_EXTENSION_NAME);
+    enabled_device_extensions.push_back(VK_KHR_EXTERNAL_SEMAPHORE_FD_EXTENSION_NAME);
+}
+
+void shared_texture_client::create(VkPhysicalDevice physical_device, VkDevice device, VkQueue queue, uint32_t queue_family_index, const std::filesystem::path& socket_path) {
+    _physical_device = physical_device;
+    _device = device;
+    _queue = queue;
+    _queue_family_index = queue_family_index;
+
+    VkCommandPoolCreateInfo command_pool_create_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+        .queueFamilyIndex = queue_family_index
+    };
+
+    throw_if_failed(vkCreateCommandPool(device, &command_pool_create_info, nullptr, &_command_pool), "vkCreateCommandPool");
+
+    _socket = connect_to_socket(socket_path);
+
+    VkPhysicalDeviceIDProperties id_properties = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES
+    };
+
+    VkPhysicalDeviceProperties2 physical_device_properties = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+        .pNext = &id_properties
+    };
+
+    vkGetPhysicalDeviceProperties2(physical_device, &physical_device_properties);
+
+    shared_device_hello hello;
+    memcpy(hello.device_uuid, id_properties.deviceUUID, VK_UUID_SIZE);
+    memcpy(hello.driver_uuid, id_properties.driverUUID, VK_UUID_SIZE);
+
+    send_message(_socket, &hello, sizeof(hello));
+}
+
+void shared_texture_client::destroy() {
+    for(const auto& acquire : _pending_acquires) {
+        vkWaitForFences(_device, 1, &acquire.fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+        vkDestroyFence(_device, acquire.fence, nullptr);
+        vkDestroySemaphore(_device, acquire.semaphore, nullptr);
+        destroy_texture(acquire.texture);
+    }
+    _pending_acquires.clear();
+
+    if(_socket >= 0) {
+        close(_socket);
+    }
+
+    vkDestroyCommandPool(_device, _command_pool, nullptr);
+}
+
+uint64_t shared_texture_client::request(const std::filesystem::path& path, uint64_t offset, uint32_t width, uint32_t height) {
+    shared_texture_request request = {
+        .request_id = _next_request_id++,
+        .offset = offset,
+        .width = width,
+        .height = height
+    };
+
+    const auto absolute_path = std::filesystem::absolute(path).string();
+    if(absolute_path.size() >= shared_texture_max_path) {
+        throw std::runtime_error(std::format("Path {} is too long to send to the stream daemon", absolute_path));
+    }
+    memcpy(request.path, absolute_path.c_str(), absolute_path.size() + 1);
+
+    send_message(_socket, &request, sizeof(request));
+    _requests_in_flight++;
+
+    return request.request_id;
+}
+
+void shared_texture_client::poll(std::vector<shared_texture_completion>& completions) {
+    for(;;) {
+        shared_texture_reply reply;
+        std::vector<int> fds;
+
+        const auto result = receive_message(_socket, &reply, sizeof(reply), fds, false);
+        if(result == receive_result::no_message) {
+            break;
+        }
+        if(result == receive_result::closed) {
+            throw std::runtime_error("Stream daemon closed the connection");
+        }
+
+        _requests_in_flight--;
+
+        if(!reply.success || fds.size() != 2) {
+            for(const auto fd : fds) {
+                close(fd);
+            }
+            throw std::runtime_error(std::format("Stream daemon failed to load request {}", reply.request_id));
+        }
+
+        import_texture(reply, fds[0], fds[1]);
+    }
+
+    std::erase_if(_pending_acquires, [&](const pending_acquire& acquire) {
+        if(vkGetFenceStatus(_device, acquire.fence) != VK_SUCCESS) {
+            return false;
+        }
+
+        vkDestroyFence(_device, acquire.fence, nullptr);
+        vkDestroySemaphore(_device, acquire.semaphore, nullptr);
+        vkFreeCommandBuffers(_device, _command_pool, 1, &acquire.command_buffer);
+
+        completions.push_back(shared_texture_completion {
+            .request_id = acquire.request_id,
+            .texture = acquire.texture
+        });
+
+        return true;
+    });
+}
+
+void shared_texture_client::destroy_texture(const host_texture& texture) {
+    vkDestroyImageView(_device, texture.image_view, nullptr);
+    vkDestroyImage(_device, texture.image, nullptr);
+    vkFreeMemory(_device, texture.memory, nullptr);
+}
+
+size_t shared_texture_client::in_flight() const {
+    return _requests_in_flight + _pending_acquires.size();
+}
+
+void shared_texture_client::import_texture(const shared_texture_reply& reply, int memory_fd, int semaphore_fd) {
+    pending_acquire acquire = {
+        .request_id = reply.request_id,
+        .texture = {
+            .size_bytes = static_cast<uint64_t>(reply.width) * reply.height * 4
+        }
+    };
+
+    // Vulkan owns an fd once it has been imported successfully, until then it's closed here
+    try {
+        VkExternalMemoryImageCreateInfo external_memory_image_create_info = {
+            .sType = VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_IMAGE_CREATE_INFO,
+            .handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT
+        };
+
+        // Has to match the daemon's image exactly, the memory only carries texels and no description
+        VkImageCreateInfo image_create_info = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+            .pNext = &external_memory_image_create_info,
+            .imageType = VK_IMAGE_TYPE_2D,
+            .format = VK_FORMAT_R8G8B8A8_UNORM,
+            .extent = { .width = reply.width, .height = reply.height, .depth = 1 },
+            .mipLevels = 1,
+            .arrayLayers = 1,
+            .samples = VK_SAMPLE_COUNT_1_BIT,
+            .tiling = VK_IMAGE_TILING_OPTIMAL,
+            .usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT
+        };
+
+        throw_if_failed(vkCreateImage(_device, &image_create_info, nullptr, &acquire.texture.image), "vkCreateImage");
+
+        VkMemoryRequirements memory_requirements;
+        vkGetImageMemoryRequirements(_device, acquire.texture.image, &memory_requirements);
+
+        VkMemoryDedicatedAllocateInfo memory_dedicated_allocate_info = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO,
+            .image = acquire.texture.image
+        };
+
+        VkImportMemoryFdInfoKHR import_memory_fd_info = {
+            .sType = VK_STRUCTURE_TYPE_IMPORT_MEMORY_FD_INFO_KHR,
+            .pNext = &memory_dedicated_allocate_info,
+            .handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT,
+            .fd = memory_fd
+        };
+
+        VkMemoryAllocateInfo memory_allocate_info = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+            .pNext = &import_memory_fd_info,
+            .allocationSize = reply.allocation_size,
+            .memoryTypeIndex = find_memory_type(_physical_device, memory_requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
+        };
+
+        throw_if_failed(vkAllocateMemory(_device, &memory_allocate_info, nullptr, &acquire.texture.memory), "vkAllocateMemory");
+        memory_fd = -1;
+
+        throw_if_failed(vkBindImageMemory(_device, acquire.texture.image, acquire.texture.memory, 0), "vkBindImageMemory");
+
+        VkSemaphoreCreateInfo semaphore_create_info = {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO
+        };
+
+        throw_if_failed(vkCreateSemaphore(_device, &semaphore_create_info, nullptr, &acquire.semaphore), "vkCreateSemaphore");
+
+        VkImportSemaphoreFdInfoKHR import_semaphore_fd_info = {
+            .sType = VK_STRUCTURE_TYPE_IMPORT_SEMAPHORE_FD_INFO_KHR,
+            .semaphore = acquire.semaphore,
+            .flags = VK_SEMAPHORE_IMPORT_TEMPORARY_BIT,
+            .handleType = VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_SYNC_FD_BIT,
+            .fd = semaphore_fd
+        };
+
+        throw_if_failed(vkImportSemaphoreFdKHR(_device, &import_semaphore_fd_info), "vkImportSemaphoreFdKHR");
+        semaphore_fd = -1;
+    } catch(...) {
+        if(memory_fd >= 0) {
+            close(memory_fd);
+        }
+        if(semaphore_fd >= 0) {
+            close(semaphore_fd);
+        }
+        vkDestroySemaphore(_device, acquire.semaphore, nullptr);
+        destroy_texture(acquire.texture);
+        throw;
+    }
+
+    VkImageViewCreateInfo image_view_create_info = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .image = acquire.texture.image,
+        .viewType = VK_IMAGE_VIEW_TYPE_2D,
+        .format = VK_FORMAT_R8G8B8A8_UNORM,
+        .components = VkComponentMapping {
+            .r = VK_COMPONENT_SWIZZLE_IDENTITY,
+            .g = VK_COMPONENT_SWIZZLE_IDENTITY,
+            .b = VK_COMPONENT_SWIZZLE_IDENTITY,
+            .a = VK_COMPONENT_SWIZZLE_IDENTITY
+        },
+        .subresourceRange = VkImageSubresourceRange {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .levelCount = 1,
+            .layerCount = 1
+        }
+    };
+
+    throw_if_failed(vkCreateImageView(_device, &image_view_create_info, nullptr, &acquire.texture.image_view), "vkCreateImageView");
+
+    VkCommandBufferAllocateInfo command_buffer_allocate_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = _command_pool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1
+    };
+
+    throw_if_failed(vkAllocateCommandBuffers(_device, &command_buffer_allocate_info, &acquire.command_buffer), "vkAllocateCommandBuffers");
+
+    VkCommandBufferBeginInfo command_buffer_begin_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+    };
+
+    throw_if_failed(vkBeginCommandBuffer(acquire.command_buffer, &command_buffer_begin_info), "vkBeginCommandBuffer");
+
+    // Acquire half of the daemon's release barrier
+    VkImageMemoryBarrier image_memory_barrier = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = 0,
+        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_EXTERNAL,
+        .dstQueueFamilyIndex = _queue_family_index,
+        .image = acquire.texture.image,
+        .subresourceRange = VkImageSubresourceRange {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .levelCount = 1,
+            .layerCount = 1
+        }
+    };
+
+    vkCmdPipelineBarrier(acquire.command_buffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &image_memory_barrier);
+
+    throw_if_failed(vkEndCommandBuffer(acquire.command_buffer), "vkEndCommandBuffer");
+
+    VkFenceCreateInfo fence_create_info = {
+        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO
+    };
+
+    throw_if_failed(vkCreateFence(_device, &fence_create_info, nullptr, &acquire.fence), "vkCreateFence");
+
+    const VkPipelineStageFlags wait_dst_stage_mask = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+    VkSubmitInfo submit_info = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .waitSemaphoreCount = 1,
+        .pWaitSemaphores = &acquire.semaphore,
+        .pWaitDstStageMask = &wait_dst_stage_mask,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &acquire.command_buffer
+    };
+
+    throw_if_failed(vkQueueSubmit(_queue, 1, &submit_info, acquire.fence), "vkQueueSubmit");
+
+    _pending_acquires.push_back(acquire);
+}
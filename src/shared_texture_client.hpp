@@ -0,0 +1,56 @@
+#pragma once
+
+#include "host_texture_uploader.hpp"
+#include "shared_texture_ipc.hpp"
+#include "vulkan_utils.hpp"
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+struct shared_texture_completion {
+    uint64_t request_id;
+    host_texture texture;
+};
+
+// Renderer half of the loader-process/renderer-process mode. Requests textures from a stream_daemon
+// and imports the exported memory without copying it; every import is acquired from
+// VK_QUEUE_FAMILY_EXTERNAL by a small submission that waits on the daemon's sync fd, and poll() only
+// hands a texture out once that submission has finished.
+class shared_texture_client {
+public:
+    static void enable_device_extensions(std::vector<const char*>& enabled_device_extensions);
+
+    void create(VkPhysicalDevice physical_device, VkDevice device, VkQueue queue, uint32_t queue_family_index, const std::filesystem::path& socket_path);
+    void destroy();
+
+    uint64_t request(const std::filesystem::path& path, uint64_t offset, uint32_t width, uint32_t height);
+
+    // Never blocks; appends every texture that is ready to be sampled
+    void poll(std::vector<shared_texture_completion>& completions);
+
+    void destroy_texture(const host_texture& texture);
+
+    size_t in_flight() const;
+
+private:
+    struct pending_acquire {
+        uint64_t request_id;
+        host_texture texture;
+        VkSemaphore semaphore;
+        VkCommandBuffer command_buffer;
+        VkFence fence;
+    };
+
+    void import_texture(const shared_texture_reply& reply, int memory_fd, int semaphore_fd);
+
+    VkPhysicalDevice _physical_device = VK_NULL_HANDLE;
+    VkDevice _device = VK_NULL_HANDLE;
+    VkQueue _queue = VK_NULL_HANDLE;
+    uint32_t _queue_family_index = 0;
+    VkCommandPool _command_pool = VK_NULL_HANDLE;
+    int _socket = -1;
+
+    uint64_t _next_request_id = 0;
+    size_t _requests_in_flight = 0;
+    std::vector<pending_acquire> _pending_acquires;
+};
@@ -0,0 +1,153 @@
+#include "shared_texture_ipc.hpp"
+#include <cerrno>
+#include <cstring>
+#include <format>
+#include <stdexcept>
+#include <system_error>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+    constexpr size_t max_fds_per_message = 4;
+
+    [[noreturn]] void throw_errno(const std::string_view& message) {
+        throw std::runtime_error(std::format("{} failed: {}", message, std::system_category().message(errno)));
+    }
+
+    sockaddr_un socket_address(const std::filesystem::path& socket_path) {
+        sockaddr_un address = {
+            .sun_family = AF_UNIX
+        };
+
+        const auto& path = socket_path.native();
+        if(path.size() >= sizeof(address.sun_path)) {
+            throw std::runtime_error(std::format("Socket path {} is too long", path));
+        }
+        memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+        return address;
+    }
+}
+
+int listen_on_socket(const std::filesystem::path& socket_path) {
+    const auto address = socket_address(socket_path);
+    unlink(address.sun_path);
+
+    const auto listen_socket = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if(listen_socket < 0) {
+        throw_errno("socket");
+    }
+
+    if(bind(listen_socket, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        close(listen_socket);
+        throw_errno("bind");
+    }
+
+    if(listen(listen_socket, 16) != 0) {
+        close(listen_socket);
+        throw_errno("listen");
+    }
+
+    return listen_socket;
+}
+
+int connect_to_socket(const std::filesystem::path& socket_path) {
+    const auto address = socket_address(socket_path);
+
+    const auto connection = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if(connection < 0) {
+        throw_errno("socket");
+    }
+
+    if(connect(connection, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        close(connection);
+        throw_errno("connect");
+    }
+
+    return connection;
+}
+
+void send_message(int socket, const void* message, size_t size, std::span<const int> fds) {
+    if(fds.size() > max_fds_per_message) {
+        throw std::runtime_error("Too many descriptors for one message");
+    }
+
+    iovec io = {
+        .iov_base = const_cast<void*>(message),
+        .iov_len = size
+    };
+
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * max_fds_per_message)] = {};
+
+    msghdr header = {
+        .msg_iov = &io,
+        .msg_iovlen = 1
+    };
+
+    if(!fds.empty()) {
+        header.msg_control = control;
+        header.msg_controllen = CMSG_SPACE(sizeof(int) * fds.size());
+
+        auto* control_message = CMSG_FIRSTHDR(&header);
+        control_message->cmsg_level = SOL_SOCKET;
+        control_message->cmsg_type = SCM_RIGHTS;
+        control_message->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+        memcpy(CMSG_DATA(control_message), fds.data(), sizeof(int) * fds.size());
+    }
+
+    if(sendmsg(socket, &header, MSG_NOSIGNAL) != static_cast<ssize_t>(size)) {
+        throw_errno("sendmsg");
+    }
+}
+
+receive_result receive_message(int socket, void* message, size_t size, std::vector<int>& fds, bool wait) {
+    iovec io = {
+        .iov_base = message,
+        .iov_len = size
+    };
+
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * max_fds_per_message)] = {};
+
+    msghdr header = {
+        .msg_iov = &io,
+        .msg_iovlen = 1,
+        .msg_control = control,
+        .msg_controllen = sizeof(control)
+    };
+
+    const auto received = recvmsg(socket, &header, MSG_CMSG_CLOEXEC | (wait ? 0 : MSG_DONTWAIT));
+    if(received < 0) {
+        if(errno == EAGAIN || errno == EWOULDBLOCK) {
+            return receive_result::no_message;
+        }
+        if(errno == ECONNRESET) {
+            return receive_result::closed;
+        }
+        throw_errno("recvmsg");
+    }
+
+    // fds may still hold descriptors from earlier messages, which belong to the caller
+    const auto first_received = fds.size();
+    for(auto* control_message = CMSG_FIRSTHDR(&header); control_message; control_message = CMSG_NXTHDR(&header, control_message)) {
+        if(control_message->cmsg_level == SOL_SOCKET && control_message->cmsg_type == SCM_RIGHTS) {
+            const auto count = (control_message->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            const auto* received_fds = reinterpret_cast<const int*>(CMSG_DATA(control_message));
+            fds.insert(fds.end(), received_fds, received_fds + count);
+        }
+    }
+
+    if(received == 0) {
+        return receive_result::closed;
+    }
+
+    if(static_cast<size_t>(received) != size || (header.msg_flags & (MSG_TRUNC | MSG_CTRUNC))) {
+        for(auto i = first_received; i < fds.size(); i++) {
+            close(fds[i]);
+        }
+        fds.resize(first_received);
+        throw std::runtime_error(std::format("Malformed message of {} bytes, expected {}", received, size));
+    }
+
+    return receive_result::message;
+}
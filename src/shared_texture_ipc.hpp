@@ -0,0 +1,47 @@
+#pragma once
+
+#include "vulkan_utils.hpp"
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <vector>
+
+inline constexpr size_t shared_texture_max_path = 512;
+
+// First message of every connection; the daemon creates its device on the physical device the
+// renderer uses, since exported memory can only be imported by the same device and driver
+struct shared_device_hello {
+    uint8_t device_uuid[VK_UUID_SIZE];
+    uint8_t driver_uuid[VK_UUID_SIZE];
+};
+
+struct shared_texture_request {
+    uint64_t request_id;
+    uint64_t offset;
+    uint32_t width;
+    uint32_t height;
+    char path[shared_texture_max_path];
+};
+
+// A successful reply carries two descriptors: the image memory as an opaque fd and a sync fd that
+// signals once the daemon's upload has finished. The image is released to VK_QUEUE_FAMILY_EXTERNAL
+// in SHADER_READ_ONLY_OPTIMAL and has to be acquired by the renderer.
+struct shared_texture_reply {
+    uint64_t request_id;
+    uint64_t allocation_size;
+    uint32_t width;
+    uint32_t height;
+    uint32_t success;
+};
+
+enum class receive_result {
+    message,
+    no_message,
+    closed
+};
+
+int listen_on_socket(const std::filesystem::path& socket_path);
+int connect_to_socket(const std::filesystem::path& socket_path);
+
+void send_message(int socket, const void* message, size_t size, std::span<const int> fds = {});
+receive_result receive_message(int socket, void* message, size_t size, std::vector<int>& fds, bool wait);
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "mpsc_ring.hpp"
+
+// Bounded single-producer single-consumer ring. Each side owns one index and caches its last view of
+// the other one, so the shared cache lines are only touched when the cached view runs out.
+template<typename T>
+class spsc_ring {
+public:
+    explicit spsc_ring(size_t capacity) : _capacity(std::bit_ceil(capacity)), _mask(_capacity - 1), _slots(std::make_unique<T[]>(_capacity)) {
+    }
+
+    bool try_push(T value) {
+        const auto tail = _tail.load(std::memory_order_relaxed);
+        if(tail - _cached_head == _capacity) {
+            _cached_head = _head.load(std::memory_order_acquire);
+            if(tail - _cached_head == _capacity) {
+                return false;
+            }
+        }
+
+        _slots[tail & _mask] = std::move(value);
+        _tail.store(tail + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    std::optional<T> try_pop() {
+        const auto head = _head.load(std::memory_order_relaxed);
+        if(head == _cached_tail) {
+            _cached_tail = _tail.load(std::memory_order_acquire);
+            if(head == _cached_tail) {
+                return std::nullopt;
+            }
+        }
+
+        auto value = std::move(_slots[head & _mask]);
+        _head.store(head + 1, std::memory_order_release);
+
+        return value;
+    }
+
+    size_t capacity() const { return _capacity; }
+
+private:
+    const size_t _capacity;
+    const size_t _mask;
+    std::unique_ptr<T[]> _slots;
+
+    alignas(cache_line_size) std::atomic<size_t> _tail = 0;
+    size_t _cached_head = 0;
+
+    alignas(cache_line_size) std::atomic<size_t> _head = 0;
+    size_t _cached_tail = 0;
+};
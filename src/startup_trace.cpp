@@ -0,0 +1,85 @@
+#include "startup_trace.hpp"
+#include <format>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+    constexpr std::string_view trace_header = "dsvk-startup-trace 1";
+}
+
+startup_trace_recorder::startup_trace_recorder(std::chrono::milliseconds window) : _window(window) {
+}
+
+void startup_trace_recorder::record(const std::string& path, uint64_t offset, uint64_t size) {
+    const auto now = clock::now();
+    if(!_start) {
+        _start = now;
+    } else if(now - *_start > _window) {
+        return;
+    }
+
+    if(!_recorded.insert(std::format("{}:{}:{}", offset, size, path)).second) {
+        return;
+    }
+
+    _accesses.push_back(startup_access {
+        .time_us = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(now - *_start).count()),
+        .path = path,
+        .offset = offset,
+        .size = size
+    });
+}
+
+bool startup_trace_recorder::finished() const {
+    return _start && clock::now() - *_start > _window;
+}
+
+void startup_trace_recorder::save(const std::filesystem::path& path) const {
+    // Written next to the old trace and renamed, so a crash never leaves half a trace behind
+    auto temporary_path = path;
+    temporary_path += ".tmp";
+
+    {
+        std::ofstream file(temporary_path, std::ios::trunc);
+        if(!file) {
+            throw std::runtime_error(std::format("Can't write startup trace {}", temporary_path.string()));
+        }
+
+        file << trace_header << '\n';
+        for(const auto& access : _accesses) {
+            file << access.time_us << ' ' << access.offset << ' ' << access.size << ' ' << access.path << '\n';
+        }
+    }
+
+    std::filesystem::rename(temporary_path, path);
+}
+
+std::vector<startup_access> load_startup_trace(const std::filesystem::path& path) {
+    std::ifstream file(path);
+    if(!file) {
+        return {};
+    }
+
+    std::string line;
+    if(!std::getline(file, line) || line != trace_header) {
+        throw std::runtime_error(std::format("{} is not a startup trace", path.string()));
+    }
+
+    std::vector<startup_access> accesses;
+    while(std::getline(file, line)) {
+        std::istringstream fields(line);
+
+        startup_access access;
+        if(!(fields >> access.time_us >> access.offset >> access.size)) {
+            throw std::runtime_error(std::format("Malformed line in startup trace {}: {}", path.string(), line));
+        }
+
+        // The path is the rest of the line and may contain spaces
+        fields.get();
+        std::getline(fields, access.path);
+        accesses.push_back(std::move(access));
+    }
+
+    return accesses;
+}
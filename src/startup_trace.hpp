@@ -0,0 +1,45 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+struct startup_access {
+    uint64_t time_us;
+    std::string path;
+    uint64_t offset;
+    uint64_t size;
+};
+
+// Records which byte ranges were requested, and when, during the first window of a run. The window
+// starts with the first request, so idle time before any client shows up doesn't count. Only the first
+// request for each range is kept.
+class startup_trace_recorder {
+public:
+    explicit startup_trace_recorder(std::chrono::milliseconds window);
+
+    void record(const std::string& path, uint64_t offset, uint64_t size);
+
+    bool started() const { return _start.has_value(); }
+    // True once the window has passed; nothing is recorded after that
+    bool finished() const;
+
+    void save(const std::filesystem::path& path) const;
+
+    size_t size() const { return _accesses.size(); }
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    std::chrono::milliseconds _window;
+    std::optional<clock::time_point> _start;
+    std::vector<startup_access> _accesses;
+    std::unordered_set<std::string> _recorded;
+};
+
+// Empty when the file doesn't exist; throws when it exists but isn't a startup trace
+std::vector<startup_access> load_startup_trace(const std::filesystem::path& path);
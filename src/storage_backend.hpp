@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+// Same levels as DSTORAGE_PRIORITY
+enum class read_priority : uint8_t {
+    low,
+    normal,
+    high,
+    realtime
+};
+
+// Backends treat both alike; the kind is carried so traces show where payloads went
+enum class read_destination : uint8_t {
+    private_memory,
+    shared_memory
+};
+
+struct read_request {
+    uint64_t file;
+    uint64_t offset;
+    uint64_t size;
+    void* destination;
+    uint64_t user_data;
+    read_priority priority = read_priority::normal;
+    read_destination destination_kind = read_destination::private_memory;
+};
+
+struct read_completion {
+    uint64_t user_data;
+    bool success;
+};
+
+// Reads file ranges into host memory. Requests are queued by enqueue() and handed to the device
+// together on submit(); poll() never blocks and returns whatever has finished since the last call.
+class storage_backend {
+public:
+    virtual ~storage_backend() = default;
+
+    virtual uint64_t open_file(const std::filesystem::path& path) = 0;
+    virtual uint64_t file_size(uint64_t file) const = 0;
+    virtual void close_file(uint64_t file) = 0;
+
+    virtual void enqueue(const read_request& request) = 0;
+    virtual void submit() = 0;
+    virtual void poll(std::vector<read_completion>& completions) = 0;
+    virtual void wait() = 0;
+
+    virtual size_t in_flight() const = 0;
+};
@@ -0,0 +1,47 @@
+#include "storage_selection.hpp"
+#include <format>
+#include <stdexcept>
+
+storage_backend_kind parse_storage_backend_kind(std::string_view name) {
+    if(name == "auto" || name == "automatic") {
+        return storage_backend_kind::automatic;
+    }
+    if(name == "io_uring") {
+        return storage_backend_kind::io_uring;
+    }
+    if(name == "pread") {
+        return storage_backend_kind::pread;
+    }
+
+    throw std::runtime_error(std::format("Unknown storage backend {}, expected auto, io_uring or pread", name));
+}
+
+const char* storage_backend_name(storage_backend_kind kind) {
+    switch(kind) {
+        case storage_backend_kind::io_uring:
+            return "io_uring";
+        case storage_backend_kind::pread:
+            return "pread";
+        default:
+            return "auto";
+    }
+}
+
+selected_storage_backend create_storage_backend(const storage_selection_desc& desc) {
+    if(desc.kind == storage_backend_kind::io_uring) {
+        if(!io_uring_backend::supported()) {
+            throw std::runtime_error("io_uring is not available on this host");
+        }
+        return { std::make_unique<io_uring_backend>(desc.uring), storage_backend_kind::io_uring };
+    }
+
+    if(desc.kind == storage_backend_kind::automatic && io_uring_backend::supported()) {
+        // The probe ring is tiny, so the real one can still be refused, e.g. by RLIMIT_MEMLOCK on older kernels
+        try {
+            return { std::make_unique<io_uring_backend>(desc.uring), storage_backend_kind::io_uring };
+        } catch(const std::runtime_error&) {
+        }
+    }
+
+    return { std::make_unique<pread_backend>(desc.pread), storage_backend_kind::pread };
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "io_uring_backend.hpp"
+#include "pread_backend.hpp"
+#include <memory>
+#include <string_view>
+
+enum class storage_backend_kind {
+    automatic,
+    io_uring,
+    pread
+};
+
+struct storage_selection_desc {
+    storage_backend_kind kind = storage_backend_kind::automatic;
+    io_uring_desc uring;
+    pread_desc pread;
+};
+
+// automatic, io_uring or pread
+storage_backend_kind parse_storage_backend_kind(std::string_view name);
+const char* storage_backend_name(storage_backend_kind kind);
+
+struct selected_storage_backend {
+    std::unique_ptr<storage_backend> backend;
+    // io_uring or pread, never automatic
+    storage_backend_kind kind;
+};
+
+// Creates the device backend for this host. automatic uses io_uring when the kernel supports it and
+// the ring can be created, and the pread thread pool otherwise, so loading keeps working where
+// io_uring is disabled. An explicitly requested io_uring throws instead of falling back.
+selected_storage_backend create_storage_backend(const storage_selection_desc& desc);
@@ -0,0 +1,136 @@
+#include "stream_client.hpp"
+#include "shared_texture_ipc.hpp"
+#include <cerrno>
+#include <cstring>
+#include <format>
+#include <stdexcept>
+#include <system_error>
+#include <poll.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+stream_client::stream_client(const std::filesystem::path& socket_path, uint64_t arena_size) {
+    _socket = connect_to_socket(socket_path);
+
+    try {
+        const stream_attach_request attach_request = {
+            .arena_size = arena_size
+        };
+
+        send_message(_socket, &attach_request, sizeof(attach_request));
+
+        std::vector<int> fds;
+        stream_attach_reply reply;
+        const auto result = receive_message(_socket, &reply, sizeof(reply), fds, true);
+        if(result != receive_result::message || fds.size() != 3) {
+            for(const auto fd : fds) {
+                close(fd);
+            }
+            throw std::runtime_error("Stream server refused the client");
+        }
+
+        _request_event = fds[1];
+        _completion_event = fds[2];
+
+        auto* mapping = mmap(nullptr, reply.region_size, PROT_READ | PROT_WRITE, MAP_SHARED, fds[0], 0);
+        close(fds[0]);
+        if(mapping == MAP_FAILED) {
+            throw std::runtime_error(std::format("mmap failed: {}", std::system_category().message(errno)));
+        }
+
+        _region = static_cast<stream_shared_region*>(mapping);
+        _region_size = reply.region_size;
+
+        if(_region->magic != stream_region_magic) {
+            throw std::runtime_error("Stream server sent an invalid region");
+        }
+
+        _arena = static_cast<uint8_t*>(mapping) + _region->arena_offset;
+    } catch(...) {
+        release();
+        throw;
+    }
+}
+
+stream_client::~stream_client() {
+    release();
+}
+
+void stream_client::release() {
+    if(_region) {
+        munmap(_region, _region_size);
+        _region = nullptr;
+    }
+    if(_completion_event >= 0) {
+        close(_completion_event);
+        _completion_event = -1;
+    }
+    if(_request_event >= 0) {
+        close(_request_event);
+        _request_event = -1;
+    }
+    if(_socket >= 0) {
+        close(_socket);
+        _socket = -1;
+    }
+}
+
+bool stream_client::submit(const std::filesystem::path& path, uint64_t file_offset, uint32_t width, uint32_t height, uint64_t arena_offset, uint64_t user_data) {
+    stream_request request = {
+        .user_data = user_data,
+        .file_offset = file_offset,
+        .arena_offset = arena_offset,
+        .width = width,
+        .height = height
+    };
+
+    // The server runs in another working directory
+    const auto absolute_path = std::filesystem::absolute(path).string();
+    if(absolute_path.size() >= stream_max_path) {
+        throw std::runtime_error(std::format("Path {} is too long to send to the stream server", absolute_path));
+    }
+    memcpy(request.path, absolute_path.c_str(), absolute_path.size() + 1);
+
+    if(!_region->requests.try_push(request)) {
+        return false;
+    }
+
+    const uint64_t value = 1;
+    if(write(_request_event, &value, sizeof(value)) != sizeof(value)) {
+        throw std::runtime_error(std::format("write failed: {}", std::system_category().message(errno)));
+    }
+
+    _in_flight++;
+    return true;
+}
+
+void stream_client::poll(std::vector<stream_completion>& completions) {
+    stream_completion completion;
+    while(_region->completions.try_pop(completion)) {
+        completions.push_back(completion);
+        _in_flight--;
+    }
+}
+
+void stream_client::wait() {
+    pollfd poll_fds[] = {
+        { .fd = _completion_event, .events = POLLIN },
+        { .fd = _socket, .events = POLLIN }
+    };
+
+    // The event is only a wakeup; anything it announced may already have been taken by poll()
+    while(_region->completions.head.load(std::memory_order_relaxed) == _region->completions.tail.load(std::memory_order_acquire)) {
+        if(::poll(poll_fds, std::size(poll_fds), -1) < 0 && errno != EINTR) {
+            throw std::runtime_error(std::format("poll failed: {}", std::system_category().message(errno)));
+        }
+
+        if(poll_fds[1].revents & (POLLIN | POLLHUP | POLLERR)) {
+            throw std::runtime_error("Stream server closed the connection");
+        }
+
+        if(poll_fds[0].revents & POLLIN) {
+            uint64_t value;
+            [[maybe_unused]] const auto read_size = read(_completion_event, &value, sizeof(value));
+        }
+    }
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "stream_protocol.hpp"
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+// Attaches to a stream_server. The client owns the layout of its arena: every request names the arena
+// offset its payload is read into, and that range must not be touched until its completion arrives.
+// Only one thread may use a client.
+class stream_client {
+public:
+    stream_client(const std::filesystem::path& socket_path, uint64_t arena_size);
+    ~stream_client();
+
+    stream_client(const stream_client&) = delete;
+    stream_client& operator=(const stream_client&) = delete;
+
+    uint8_t* arena() const { return _arena; }
+    uint64_t arena_size() const { return _region->arena_size; }
+
+    // False when the request ring is full
+    bool submit(const std::filesystem::path& path, uint64_t file_offset, uint32_t width, uint32_t height, uint64_t arena_offset, uint64_t user_data);
+    void poll(std::vector<stream_completion>& completions);
+    // Blocks until the server has delivered completions that poll() hasn't returned yet
+    void wait();
+
+    size_t in_flight() const { return _in_flight; }
+
+private:
+    void release();
+
+    int _socket = -1;
+    int _request_event = -1;
+    int _completion_event = -1;
+    stream_shared_region* _region = nullptr;
+    uint64_t _region_size = 0;
+    uint8_t* _arena = nullptr;
+    size_t _in_flight = 0;
+};
@@ -0,0 +1,415 @@
+#include "stream_daemon.hpp"
+#include "mapped_file.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <format>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+
+stream_daemon::stream_daemon(const std::filesystem::path& socket_path) : _socket_path(socket_path) {
+    _listen_socket = listen_on_socket(socket_path);
+}
+
+stream_daemon::~stream_daemon() {
+    if(_device) {
+        vkDeviceWaitIdle(_device);
+        vkDestroyFence(_device, _fence, nullptr);
+        vkFreeCommandBuffers(_device, _command_pool, 1, &_command_buffer);
+        vkDestroyCommandPool(_device, _command_pool, nullptr);
+        vkDestroyDevice(_device, nullptr);
+    }
+    if(_instance) {
+        vkDestroyInstance(_instance, nullptr);
+    }
+
+    close(_listen_socket);
+    unlink(_socket_path.c_str());
+}
+
+void stream_daemon::run() {
+    printf("stream daemon listening on %s\n", _socket_path.c_str());
+
+    for(;;) {
+        const auto client = accept4(_listen_socket, nullptr, nullptr, SOCK_CLOEXEC);
+        if(client < 0) {
+            continue;
+        }
+
+        try {
+            serve(client);
+        } catch(const std::exception& ex) {
+            printf("stream daemon client failed: %s\n", ex.what());
+        }
+
+        close(client);
+
+        printf("stream daemon: %llu textures exported, %llu bytes uploaded, %llu failed requests\n",
+               static_cast<unsigned long long>(_stats.textures_exported), static_cast<unsigned long long>(_stats.bytes_uploaded),
+               static_cast<unsigned long long>(_stats.failed_requests));
+    }
+}
+
+stream_daemon_stats stream_daemon::stats() const {
+    return _stats;
+}
+
+void stream_daemon::serve(int client) {
+    std::vector<int> fds;
+
+    shared_device_hello hello;
+    if(receive_message(client, &hello, sizeof(hello), fds, true) != receive_result::message) {
+        return;
+    }
+
+    if(!_device) {
+        create_device(hello);
+    } else if(memcmp(&hello, &_device_id, sizeof(hello)) != 0) {
+        throw std::runtime_error("Client renders on a different device than the daemon's");
+    }
+
+    for(;;) {
+        shared_texture_request request;
+        if(receive_message(client, &request, sizeof(request), fds, true) != receive_result::message) {
+            return;
+        }
+
+        request.path[shared_texture_max_path - 1] = '\0';
+        handle_request(client, request);
+    }
+}
+
+void stream_daemon::create_device(const shared_device_hello& hello) {
+    throw_if_failed(volkInitialize(), "volkInitialize");
+
+    VkApplicationInfo application_info = {
+        .sType = VK_STRUCTURE_TYPE_APPLICATION_INFO,
+        .pApplicationName = "direct_storage_stream_daemon",
+        .applicationVersion = VK_MAKE_API_VERSION(0, 0, 1, 0),
+        .pEngineName = "direct_storage_example",
+        .engineVersion = VK_MAKE_API_VERSION(0, 0, 1, 0),
+        .apiVersion = VK_API_VERSION_1_3
+    };
+
+    VkInstanceCreateInfo instance_create_info = {
+        .sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
+        .pApplicationInfo = &application_info
+    };
+
+    throw_if_failed(vkCreateInstance(&instance_create_info, nullptr, &_instance), "vkCreateInstance");
+
+    volkLoadInstance(_instance);
+
+    uint32_t num_physical_devices;
+    throw_if_failed(vkEnumeratePhysicalDevices(_instance, &num_physical_devices, nullptr), "vkEnumeratePhysicalDevices");
+
+    std::vector<VkPhysicalDevice> physical_devices(num_physical_devices);
+
+    throw_if_failed(vkEnumeratePhysicalDevices(_instance, &num_physical_devices, physical_devices.data()), "vkEnumeratePhysicalDevices");
+
+    for(const auto physical_device : physical_devices) {
+        VkPhysicalDeviceIDProperties id_properties = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES
+        };
+
+        VkPhysicalDeviceProperties2 physical_device_properties = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+            .pNext = &id_properties
+        };
+
+        vkGetPhysicalDeviceProperties2(physical_device, &physical_device_properties);
+
+        if(memcmp(id_properties.deviceUUID, hello.device_uuid, VK_UUID_SIZE) == 0 && memcmp(id_properties.driverUUID, hello.driver_uuid, VK_UUID_SIZE) == 0) {
+            _physical_device = physical_device;
+            break;
+        }
+    }
+
+    if(!_physical_device) {
+        throw std::runtime_error("No physical device matches the client's device and driver");
+    }
+
+    _device_id = hello;
+
+    // The daemon only records copies and barriers, which graphics and compute queues support without reporting the transfer bit
+    uint32_t num_queue_families;
+    vkGetPhysicalDeviceQueueFamilyProperties(_physical_device, &num_queue_families, nullptr);
+
+    std::vector<VkQueueFamilyProperties> queue_families(num_queue_families);
+    vkGetPhysicalDeviceQueueFamilyProperties(_physical_device, &num_queue_families, queue_families.data());
+
+    const auto queue_family = std::find_if(queue_families.begin(), queue_families.end(), [](const VkQueueFamilyProperties& properties) {
+        return properties.queueCount > 0 && (properties.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT));
+    });
+    if(queue_family == queue_families.end()) {
+        throw std::runtime_error("The client's device has no queue family that can copy");
+    }
+    _queue_family_index = static_cast<uint32_t>(queue_family - queue_families.begin());
+
+    const float single_priority = 1.0f;
+
+    VkDeviceQueueCreateInfo device_queue_create_info = {
+        .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+        .queueFamilyIndex = _queue_family_index,
+        .queueCount = 1,
+        .pQueuePriorities = &single_priority
+    };
+
+    const char* enabled_device_extensions[] = { VK_KHR_EXTERNAL_MEMORY_FD_EXTENSION_NAME, VK_KHR_EXTERNAL_SEMAPHORE_FD_EXTENSION_NAME };
+
+    VkDeviceCreateInfo device_create_info = {
+        .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+        .queueCreateInfoCount = 1,
+        .pQueueCreateInfos = &device_queue_create_info,
+        .enabledExtensionCount = static_cast<uint32_t>(std::size(enabled_device_extensions)),
+        .ppEnabledExtensionNames = enabled_device_extensions
+    };
+
+    throw_if_failed(vkCreateDevice(_physical_device, &device_create_info, nullptr, &_device), "vkCreateDevice");
+
+    volkLoadDevice(_device);
+
+    vkGetDeviceQueue(_device, _queue_family_index, 0, &_queue);
+
+    VkCommandPoolCreateInfo command_pool_create_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+        .queueFamilyIndex = _queue_family_index
+    };
+
+    throw_if_failed(vkCreateCommandPool(_device, &command_pool_create_info, nullptr, &_command_pool), "vkCreateCommandPool");
+
+    VkCommandBufferAllocateInfo command_buffer_allocate_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = _command_pool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1
+    };
+
+    throw_if_failed(vkAllocateCommandBuffers(_device, &command_buffer_allocate_info, &_command_buffer), "vkAllocateCommandBuffers");
+
+    VkFenceCreateInfo fence_create_info = {
+        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO
+    };
+
+    throw_if_failed(vkCreateFence(_device, &fence_create_info, nullptr, &_fence), "vkCreateFence");
+}
+
+void stream_daemon::handle_request(int client, const shared_texture_request& request) {
+    shared_texture_reply reply = {
+        .request_id = request.request_id,
+        .width = request.width,
+        .height = request.height
+    };
+
+    exported_texture texture = {};
+    try {
+        upload(request, texture, reply.allocation_size);
+    } catch(const std::exception& ex) {
+        destroy_texture(texture);
+        printf("stream daemon failed to load %s: %s\n", request.path, ex.what());
+        _stats.failed_requests++;
+        send_message(client, &reply, sizeof(reply));
+        return;
+    }
+
+    // The semaphore's payload is only exportable as a sync fd once its signal has been submitted
+    VkSemaphoreGetFdInfoKHR semaphore_get_fd_info = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_GET_FD_INFO_KHR,
+        .semaphore = texture.semaphore,
+        .handleType = VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_SYNC_FD_BIT
+    };
+
+    VkMemoryGetFdInfoKHR memory_get_fd_info = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_GET_FD_INFO_KHR,
+        .memory = texture.memory,
+        .handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT
+    };
+
+    int fds[2] = { -1, -1 };
+    throw_if_failed(vkGetMemoryFdKHR(_device, &memory_get_fd_info, &fds[0]), "vkGetMemoryFdKHR");
+    throw_if_failed(vkGetSemaphoreFdKHR(_device, &semaphore_get_fd_info, &fds[1]), "vkGetSemaphoreFdKHR");
+
+    reply.success = 1;
+
+    try {
+        send_message(client, &reply, sizeof(reply), fds);
+    } catch(...) {
+        close(fds[0]);
+        close(fds[1]);
+        throw;
+    }
+
+    close(fds[0]);
+    close(fds[1]);
+
+    // The renderer's import holds its own reference to the memory, so the daemon's handles can go
+    // as soon as the upload has finished
+    throw_if_failed(vkWaitForFences(_device, 1, &_fence, VK_TRUE, std::numeric_limits<uint64_t>::max()), "vkWaitForFences");
+    throw_if_failed(vkResetFences(_device, 1, &_fence), "vkResetFences");
+
+    destroy_texture(texture);
+
+    _stats.textures_exported++;
+    _stats.bytes_uploaded += static_cast<uint64_t>(request.width) * request.height * 4;
+}
+
+void stream_daemon::upload(const shared_texture_request& request, exported_texture& texture, uint64_t& allocation_size) {
+    const mapped_file file(request.path);
+
+    const uint64_t size = static_cast<uint64_t>(request.width) * request.height * 4;
+    if(request.offset + size > file.size()) {
+        throw std::runtime_error(std::format("Texture region {}+{} exceeds the file size {}", request.offset, size, file.size()));
+    }
+
+    VkExternalMemoryImageCreateInfo external_memory_image_create_info = {
+        .sType = VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_IMAGE_CREATE_INFO,
+        .handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT
+    };
+
+    VkImageCreateInfo image_create_info = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .pNext = &external_memory_image_create_info,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .format = VK_FORMAT_R8G8B8A8_UNORM,
+        .extent = { .width = request.width, .height = request.height, .depth = 1 },
+        .mipLevels = 1,
+        .arrayLayers = 1,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT
+    };
+
+    throw_if_failed(vkCreateImage(_device, &image_create_info, nullptr, &texture.image), "vkCreateImage");
+
+    VkMemoryRequirements memory_requirements;
+    vkGetImageMemoryRequirements(_device, texture.image, &memory_requirements);
+
+    VkMemoryDedicatedAllocateInfo memory_dedicated_allocate_info = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO,
+        .image = texture.image
+    };
+
+    VkExportMemoryAllocateInfo export_memory_allocate_info = {
+        .sType = VK_STRUCTURE_TYPE_EXPORT_MEMORY_ALLOCATE_INFO,
+        .pNext = &memory_dedicated_allocate_info,
+        .handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT
+    };
+
+    VkMemoryAllocateInfo memory_allocate_info = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .pNext = &export_memory_allocate_info,
+        .allocationSize = memory_requirements.size,
+        .memoryTypeIndex = find_memory_type(_physical_device, memory_requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
+    };
+
+    throw_if_failed(vkAllocateMemory(_device, &memory_allocate_info, nullptr, &texture.memory), "vkAllocateMemory");
+    throw_if_failed(vkBindImageMemory(_device, texture.image, texture.memory, 0), "vkBindImageMemory");
+
+    allocation_size = memory_requirements.size;
+
+    VkBufferCreateInfo buffer_create_info = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = size,
+        .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE
+    };
+
+    throw_if_failed(vkCreateBuffer(_device, &buffer_create_info, nullptr, &texture.staging_buffer), "vkCreateBuffer");
+
+    vkGetBufferMemoryRequirements(_device, texture.staging_buffer, &memory_requirements);
+
+    VkMemoryAllocateInfo staging_allocate_info = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .allocationSize = memory_requirements.size,
+        .memoryTypeIndex = find_memory_type(_physical_device, memory_requirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+    };
+
+    throw_if_failed(vkAllocateMemory(_device, &staging_allocate_info, nullptr, &texture.staging_memory), "vkAllocateMemory");
+    throw_if_failed(vkBindBufferMemory(_device, texture.staging_buffer, texture.staging_memory, 0), "vkBindBufferMemory");
+
+    void* mapped;
+    throw_if_failed(vkMapMemory(_device, texture.staging_memory, 0, size, 0, &mapped), "vkMapMemory");
+    memcpy(mapped, file.data() + request.offset, size);
+    vkUnmapMemory(_device, texture.staging_memory);
+
+    VkExportSemaphoreCreateInfo export_semaphore_create_info = {
+        .sType = VK_STRUCTURE_TYPE_EXPORT_SEMAPHORE_CREATE_INFO,
+        .handleTypes = VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_SYNC_FD_BIT
+    };
+
+    VkSemaphoreCreateInfo semaphore_create_info = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+        .pNext = &export_semaphore_create_info
+    };
+
+    throw_if_failed(vkCreateSemaphore(_device, &semaphore_create_info, nullptr, &texture.semaphore), "vkCreateSemaphore");
+
+    VkCommandBufferBeginInfo command_buffer_begin_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+    };
+
+    throw_if_failed(vkBeginCommandBuffer(_command_buffer, &command_buffer_begin_info), "vkBeginCommandBuffer");
+
+    VkImageMemoryBarrier image_memory_barrier = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = 0,
+        .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = texture.image,
+        .subresourceRange = VkImageSubresourceRange {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .levelCount = 1,
+            .layerCount = 1
+        }
+    };
+
+    vkCmdPipelineBarrier(_command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &image_memory_barrier);
+
+    VkBufferImageCopy buffer_image_copy = {
+        .imageSubresource = {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .layerCount = 1
+        },
+        .imageExtent = { .width = request.width, .height = request.height, .depth = 1 }
+    };
+
+    vkCmdCopyBufferToImage(_command_buffer, texture.staging_buffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &buffer_image_copy);
+
+    // Release to the renderer's process, which acquires with the matching barrier
+    image_memory_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    image_memory_barrier.dstAccessMask = 0;
+    image_memory_barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    image_memory_barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    image_memory_barrier.srcQueueFamilyIndex = _queue_family_index;
+    image_memory_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_EXTERNAL;
+
+    vkCmdPipelineBarrier(_command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &image_memory_barrier);
+
+    throw_if_failed(vkEndCommandBuffer(_command_buffer), "vkEndCommandBuffer");
+
+    VkSubmitInfo submit_info = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &_command_buffer,
+        .signalSemaphoreCount = 1,
+        .pSignalSemaphores = &texture.semaphore
+    };
+
+    throw_if_failed(vkQueueSubmit(_queue, 1, &submit_info, _fence), "vkQueueSubmit");
+}
+
+void stream_daemon::destroy_texture(const exported_texture& texture) {
+    vkDestroySemaphore(_device, texture.semaphore, nullptr);
+    vkDestroyBuffer(_device, texture.staging_buffer, nullptr);
+    vkFreeMemory(_device, texture.staging_memory, nullptr);
+    vkDestroyImage(_device, texture.image, nullptr);
+    vkFreeMemory(_device, texture.memory, nullptr);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "shared_texture_ipc.hpp"
+#include "vulkan_utils.hpp"
+#include <cstdint>
+#include <filesystem>
+
+struct stream_daemon_stats {
+    uint64_t textures_exported;
+    uint64_t bytes_uploaded;
+    uint64_t failed_requests;
+};
+
+// Loader half of the loader-process/renderer-process mode. Listens on a unix socket, creates a headless
+// Vulkan device on the physical device named by the first client, and answers every request by filling
+// a dedicated exportable image and sending its memory as an opaque fd together with a sync fd for the
+// upload, so the texels are never copied again on the renderer side. Clients are served one at a time.
+class stream_daemon {
+public:
+    explicit stream_daemon(const std::filesystem::path& socket_path);
+    ~stream_daemon();
+
+    // Serves clients until the process is killed
+    void run();
+
+    stream_daemon_stats stats() const;
+
+private:
+    struct exported_texture {
+        VkImage image;
+        VkDeviceMemory memory;
+        VkBuffer staging_buffer;
+        VkDeviceMemory staging_memory;
+        VkSemaphore semaphore;
+    };
+
+    void serve(int client);
+    void create_device(const shared_device_hello& hello);
+    void handle_request(int client, const shared_texture_request& request);
+    // Fills texture as it goes, so whatever was created can be destroyed when it throws
+    void upload(const shared_texture_request& request, exported_texture& texture, uint64_t& allocation_size);
+    void destroy_texture(const exported_texture& texture);
+
+    std::filesystem::path _socket_path;
+    int _listen_socket = -1;
+
+    VkInstance _instance = VK_NULL_HANDLE;
+    VkPhysicalDevice _physical_device = VK_NULL_HANDLE;
+    VkDevice _device = VK_NULL_HANDLE;
+    VkQueue _queue = VK_NULL_HANDLE;
+    uint32_t _queue_family_index = 0;
+    VkCommandPool _command_pool = VK_NULL_HANDLE;
+    VkCommandBuffer _command_buffer = VK_NULL_HANDLE;
+    VkFence _fence = VK_NULL_HANDLE;
+    shared_device_hello _device_id = {};
+
+    stream_daemon_stats _stats = {};
+};
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+inline constexpr uint64_t stream_region_magic = 0x6473766b5f726e67;
+inline constexpr uint32_t stream_ring_capacity = 256;
+inline constexpr size_t stream_max_path = 512;
+
+// width * height RGBA8 texels read from file_offset in the file, delivered into the client's arena at
+// arena_offset. The server doesn't look for a container header; clients pass the offset of the
+// subresource they want from the texture's layout.
+struct stream_request {
+    uint64_t user_data;
+    uint64_t file_offset;
+    uint64_t arena_offset;
+    uint32_t width;
+    uint32_t height;
+    char path[stream_max_path];
+};
+
+struct stream_completion {
+    uint64_t user_data;
+    uint64_t size;
+    uint32_t success;
+};
+
+// Single-producer single-consumer ring that lives in memory shared between two processes. It has no
+// constructor: zero-filled memory is an empty ring, which is what a fresh memfd provides.
+template<typename T, uint32_t Capacity>
+struct shared_spsc_ring {
+    static_assert((Capacity & (Capacity - 1)) == 0);
+    static_assert(std::atomic<uint64_t>::is_always_lock_free);
+
+    alignas(64) std::atomic<uint64_t> tail;
+    alignas(64) std::atomic<uint64_t> head;
+    alignas(64) T slots[Capacity];
+
+    bool try_push(const T& value) {
+        const auto position = tail.load(std::memory_order_relaxed);
+        if(position - head.load(std::memory_order_acquire) == Capacity) {
+            return false;
+        }
+
+        slots[position & (Capacity - 1)] = value;
+        tail.store(position + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    bool try_pop(T& value) {
+        const auto position = head.load(std::memory_order_relaxed);
+        if(position == tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        value = slots[position & (Capacity - 1)];
+        head.store(position + 1, std::memory_order_release);
+
+        return true;
+    }
+};
+
+// Start of every client's shared region; the payload arena follows at arena_offset
+struct stream_shared_region {
+    uint64_t magic;
+    uint64_t arena_offset;
+    uint64_t arena_size;
+    shared_spsc_ring<stream_request, stream_ring_capacity> requests;
+    shared_spsc_ring<stream_completion, stream_ring_capacity> completions;
+};
+
+// Sent by the client when it connects; the server answers with stream_attach_reply carrying the
+// region's memfd and two eventfds, one the client writes after submitting and one the server writes
+// after completing
+struct stream_attach_request {
+    uint64_t arena_size;
+};
+
+struct stream_attach_reply {
+    uint64_t region_size;
+};
@@ -0,0 +1,495 @@
+#include "stream_server.hpp"
+#include "host_memory.hpp"
+#include "mapped_file.hpp"
+#include "shared_texture_ipc.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <format>
+#include <stdexcept>
+#include <system_error>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+    constexpr uint64_t max_arena_size = 1ull << 32;
+
+    [[noreturn]] void throw_errno(const std::string_view& message) {
+        throw std::runtime_error(std::format("{} failed: {}", message, std::system_category().message(errno)));
+    }
+
+    void signal_event(int event) {
+        const uint64_t value = 1;
+        [[maybe_unused]] const auto written = write(event, &value, sizeof(value));
+    }
+
+    void clear_event(int event) {
+        uint64_t value;
+        [[maybe_unused]] const auto read_size = read(event, &value, sizeof(value));
+    }
+}
+
+stream_server::stream_server(const std::filesystem::path& socket_path, storage_backend& backend, const stream_server_desc& desc, const caching_backend* cache,
+                             const verifying_backend* verifier)
+    : _socket_path(socket_path), _backend(backend), _desc(desc), _cache(cache), _verifier(verifier) {
+    if(!_desc.startup_trace.empty()) {
+        auto trace = load_startup_trace(_desc.startup_trace);
+        if(!trace.empty() && !_cache) {
+            printf("stream server: no cache to prefetch %s into, ignoring it\n", _desc.startup_trace.c_str());
+        } else {
+            _prefetch_queue.assign(trace.begin(), trace.end());
+        }
+
+        // Every run records a fresh trace, so the prefetch follows the content as it changes
+        _recorder.emplace(_desc.startup_window);
+    }
+
+    _listen_socket = listen_on_socket(socket_path);
+}
+
+stream_server::~stream_server() {
+    while(_backend.in_flight() > 0) {
+        _backend.wait();
+        _backend_completions.clear();
+        _backend.poll(_backend_completions);
+    }
+
+    for(auto& [id, client] : _clients) {
+        destroy_client(client);
+    }
+    for(const auto socket : _handshaking) {
+        close(socket);
+    }
+
+    for(const auto& [path, file] : _files) {
+        _backend.close_file(file);
+    }
+
+    close(_listen_socket);
+    unlink(_socket_path.c_str());
+}
+
+void stream_server::run() {
+    printf("stream server listening on %s\n", _socket_path.c_str());
+
+    std::vector<pollfd> poll_fds;
+    std::vector<uint64_t> poll_clients;
+
+    for(;;) {
+        poll_fds.clear();
+        poll_clients.clear();
+
+        poll_fds.push_back(pollfd { .fd = _listen_socket, .events = POLLIN });
+        for(const auto& [id, client] : _clients) {
+            if(!client.closing) {
+                poll_fds.push_back(pollfd { .fd = client.socket, .events = POLLIN });
+                poll_fds.push_back(pollfd { .fd = client.request_event, .events = POLLIN });
+                poll_clients.push_back(id);
+            }
+        }
+
+        const auto backend_event_index = poll_fds.size();
+        if(_desc.backend_event >= 0) {
+            poll_fds.push_back(pollfd { .fd = _desc.backend_event, .events = POLLIN });
+        }
+
+        const auto handshake_index = poll_fds.size();
+        for(const auto socket : _handshaking) {
+            poll_fds.push_back(pollfd { .fd = socket, .events = POLLIN });
+        }
+
+        // Without a backend event, reads in flight are polled every millisecond
+        const auto backlog = std::any_of(_clients.begin(), _clients.end(), [](const auto& entry) { return !entry.second.backlog.empty(); });
+        const auto poll_backend = _backend.in_flight() > 0 && _desc.backend_event < 0;
+        // The first prefetch batch goes out right away; while a trace is being recorded the loop wakes up to save it
+        const auto prefetch_pending = !_prefetch_queue.empty() && _prefetch_bytes_in_flight == 0;
+        const auto recording = _recorder && _recorder->started();
+        const auto timeout = prefetch_pending ? 0 : poll_backend || backlog ? 1 : recording ? 100 : -1;
+
+        if(poll(poll_fds.data(), poll_fds.size(), timeout) < 0 && errno != EINTR) {
+            throw_errno("poll");
+        }
+
+        // A client that connects and never sends its attach request only ever holds its own socket
+        std::vector<int> attaching;
+        for(size_t i = 0; i < _handshaking.size(); i++) {
+            if(poll_fds[handshake_index + i].revents & (POLLIN | POLLHUP | POLLERR)) {
+                attaching.push_back(_handshaking[i]);
+            }
+        }
+        for(const auto socket : attaching) {
+            std::erase(_handshaking, socket);
+            try {
+                attach_client(socket);
+            } catch(const std::exception& ex) {
+                printf("stream server failed to attach a client: %s\n", ex.what());
+            }
+        }
+
+        if(poll_fds[0].revents & POLLIN) {
+            accept_client();
+        }
+
+        for(size_t i = 0; i < poll_clients.size(); i++) {
+            auto& client = _clients.at(poll_clients[i]);
+
+            // Clients never send anything after attaching, so a readable socket means it hung up
+            if(poll_fds[1 + i * 2].revents & (POLLIN | POLLHUP | POLLERR)) {
+                client.closing = true;
+                continue;
+            }
+
+            if(poll_fds[2 + i * 2].revents & POLLIN) {
+                clear_event(client.request_event);
+            }
+
+            drain_requests(poll_clients[i], client);
+        }
+
+        // Cleared before polling the backend, so completions that arrive afterwards signal it again
+        if(_desc.backend_event >= 0 && (poll_fds[backend_event_index].revents & POLLIN)) {
+            clear_event(_desc.backend_event);
+        }
+
+        issue_prefetches();
+        _backend.submit();
+
+        _backend_completions.clear();
+        _backend.poll(_backend_completions);
+
+        for(const auto& backend_completion : _backend_completions) {
+            auto operation = _operations.extract(backend_completion.user_data);
+            auto& mapped = operation.mapped();
+
+            if(mapped.client_id == 0) {
+                _prefetch_bytes_in_flight -= mapped.completion.size;
+                if(backend_completion.success) {
+                    _stats.prefetches++;
+                    _stats.bytes_prefetched += mapped.completion.size;
+                } else {
+                    _stats.failed_prefetches++;
+                }
+                continue;
+            }
+
+            auto& client = _clients.at(mapped.client_id);
+            if(backend_completion.success && !client.closing) {
+                memcpy(client.arena + mapped.arena_offset, mapped.staging.data(), mapped.completion.size);
+            }
+
+            mapped.completion.success = backend_completion.success;
+            complete(mapped.client_id, mapped.completion);
+        }
+
+        update_startup_trace();
+
+        for(auto it = _clients.begin(); it != _clients.end();) {
+            auto& client = it->second;
+            flush_completions(client);
+
+            // Completions of a client that left are still counted against it, so it stays until they are in
+            if(client.closing && client.outstanding == 0) {
+                destroy_client(client);
+                it = _clients.erase(it);
+
+                printf("stream server: %llu clients, %llu requests, %llu failed, %llu bytes delivered, %llu prefetches (%llu failed, %llu bytes)\n",
+                       static_cast<unsigned long long>(_stats.clients), static_cast<unsigned long long>(_stats.requests),
+                       static_cast<unsigned long long>(_stats.failed_requests), static_cast<unsigned long long>(_stats.bytes_delivered),
+                       static_cast<unsigned long long>(_stats.prefetches), static_cast<unsigned long long>(_stats.failed_prefetches),
+                       static_cast<unsigned long long>(_stats.bytes_prefetched));
+
+                if(_cache) {
+                    const auto& cache_stats = _cache->stats();
+                    printf("stream cache: %llu ram hits, %llu disk hits, %llu misses, %llu/%llu/%llu bytes from ram/disk/storage, %llu ram bytes, %llu disk bytes\n",
+                           static_cast<unsigned long long>(cache_stats.ram_hits), static_cast<unsigned long long>(cache_stats.disk_hits),
+                           static_cast<unsigned long long>(cache_stats.misses), static_cast<unsigned long long>(cache_stats.bytes_from_ram),
+                           static_cast<unsigned long long>(cache_stats.bytes_from_disk), static_cast<unsigned long long>(cache_stats.bytes_from_backend),
+                           static_cast<unsigned long long>(cache_stats.ram_bytes), static_cast<unsigned long long>(cache_stats.disk_bytes));
+                }
+
+                if(_verifier) {
+                    const auto& verify_stats = _verifier->stats();
+                    printf("stream verification: %llu/%llu files with checksums, %llu with corrupt checksums, %llu chunks and %llu bytes verified, %llu bytes unverified, %llu mismatched chunks, %llu retries, %llu failed, %.1f ms hashing\n",
+                           static_cast<unsigned long long>(verify_stats.verified_files),
+                           static_cast<unsigned long long>(verify_stats.verified_files + verify_stats.unverified_files + verify_stats.corrupt_checksum_files),
+                           static_cast<unsigned long long>(verify_stats.corrupt_checksum_files),
+                           static_cast<unsigned long long>(verify_stats.verified_chunks), static_cast<unsigned long long>(verify_stats.verified_bytes),
+                           static_cast<unsigned long long>(verify_stats.unverified_bytes), static_cast<unsigned long long>(verify_stats.mismatched_chunks),
+                           static_cast<unsigned long long>(verify_stats.retries), static_cast<unsigned long long>(verify_stats.failed_requests),
+                           std::chrono::duration<double, std::milli>(verify_stats.hash_time).count());
+                }
+
+                const auto memory_stats = host_memory_statistics();
+                printf("stream host memory: %llu bytes in %llu buffers, %llu on explicit huge pages, %llu advised for transparent huge pages (%llu resident), %llu fell back to small pages\n",
+                       static_cast<unsigned long long>(memory_stats.bytes), static_cast<unsigned long long>(memory_stats.buffers),
+                       static_cast<unsigned long long>(memory_stats.explicit_huge_page_bytes),
+                       static_cast<unsigned long long>(memory_stats.transparent_huge_page_bytes),
+                       static_cast<unsigned long long>(resident_transparent_huge_page_bytes()), static_cast<unsigned long long>(memory_stats.fallbacks));
+            } else {
+                ++it;
+            }
+        }
+    }
+}
+
+void stream_server::accept_client() {
+    const auto socket = accept4(_listen_socket, nullptr, nullptr, SOCK_CLOEXEC);
+    if(socket >= 0) {
+        _handshaking.push_back(socket);
+    }
+}
+
+void stream_server::attach_client(int socket) {
+    client client = {
+        .socket = socket,
+        .request_event = -1,
+        .completion_event = -1
+    };
+
+    int region_fd = -1;
+
+    try {
+        std::vector<int> fds;
+        stream_attach_request attach_request;
+        if(receive_message(socket, &attach_request, sizeof(attach_request), fds, false) != receive_result::message) {
+            throw std::runtime_error("Client left before attaching");
+        }
+
+        if(attach_request.arena_size == 0 || attach_request.arena_size > max_arena_size) {
+            throw std::runtime_error(std::format("Invalid arena size {}", attach_request.arena_size));
+        }
+
+        const auto page_size = mapped_file::page_size();
+        const auto arena_offset = (sizeof(stream_shared_region) + page_size - 1) / page_size * page_size;
+        client.region_size = arena_offset + (attach_request.arena_size + page_size - 1) / page_size * page_size;
+
+        region_fd = memfd_create("dsvk_stream_region", MFD_CLOEXEC);
+        if(region_fd < 0) {
+            throw_errno("memfd_create");
+        }
+
+        if(ftruncate(region_fd, static_cast<off_t>(client.region_size)) != 0) {
+            throw_errno("ftruncate");
+        }
+
+        auto* mapping = mmap(nullptr, client.region_size, PROT_READ | PROT_WRITE, MAP_SHARED, region_fd, 0);
+        if(mapping == MAP_FAILED) {
+            throw_errno("mmap");
+        }
+
+        client.region = static_cast<stream_shared_region*>(mapping);
+        client.region->arena_offset = arena_offset;
+        client.region->arena_size = attach_request.arena_size;
+        client.region->magic = stream_region_magic;
+        client.arena = static_cast<uint8_t*>(mapping) + arena_offset;
+        client.arena_size = attach_request.arena_size;
+
+        client.request_event = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        client.completion_event = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if(client.request_event < 0 || client.completion_event < 0) {
+            throw_errno("eventfd");
+        }
+
+        const stream_attach_reply reply = {
+            .region_size = client.region_size
+        };
+
+        const int reply_fds[] = { region_fd, client.request_event, client.completion_event };
+        send_message(socket, &reply, sizeof(reply), reply_fds);
+    } catch(...) {
+        if(region_fd >= 0) {
+            close(region_fd);
+        }
+        destroy_client(client);
+        throw;
+    }
+
+    close(region_fd);
+
+    _stats.clients++;
+    _clients.emplace(_next_client_id++, std::move(client));
+}
+
+void stream_server::drain_requests(uint64_t client_id, client& client) {
+    // Completions that couldn't be delivered yet count as outstanding, so the ring can't outgrow them
+    stream_request request;
+    while(client.outstanding < stream_ring_capacity && client.region->requests.try_pop(request)) {
+        request.path[stream_max_path - 1] = '\0';
+        start_request(client_id, client, request);
+    }
+}
+
+void stream_server::start_request(uint64_t client_id, client& client, const stream_request& request) {
+    _stats.requests++;
+    client.outstanding++;
+
+    stream_completion completion = {
+        .user_data = request.user_data,
+        .size = static_cast<uint64_t>(request.width) * request.height * 4,
+        .success = 0
+    };
+
+    if(_recorder) {
+        _recorder->record(request.path, request.file_offset, completion.size);
+    }
+
+    uint64_t file;
+    try {
+        file = open_file(request.path);
+    } catch(const std::exception& ex) {
+        printf("stream server failed to open %s: %s\n", request.path, ex.what());
+        complete(client_id, completion);
+        return;
+    }
+
+    // Checked against the server's own copy of the arena size, which the client can't change
+    const auto file_size = _backend.file_size(file);
+    if(request.file_offset > file_size || completion.size > file_size - request.file_offset ||
+       request.arena_offset > client.arena_size || completion.size > client.arena_size - request.arena_offset) {
+        complete(client_id, completion);
+        return;
+    }
+
+    const auto operation_id = _next_operation_id++;
+    auto& started = _operations.emplace(operation_id, operation {
+        .client_id = client_id,
+        .arena_offset = request.arena_offset,
+        .completion = completion,
+        .staging = host_buffer(completion.size, _desc.huge_pages, _desc.numa_node)
+    }).first->second;
+
+    _backend.enqueue(read_request {
+        .file = file,
+        .offset = request.file_offset,
+        .size = completion.size,
+        .destination = started.staging.data(),
+        .user_data = operation_id
+    });
+}
+
+void stream_server::complete(uint64_t client_id, const stream_completion& completion) {
+    auto& client = _clients.at(client_id);
+
+    if(completion.success) {
+        _stats.bytes_delivered += completion.size;
+    } else {
+        _stats.failed_requests++;
+    }
+
+    client.backlog.push_back(completion);
+}
+
+void stream_server::flush_completions(client& client) {
+    if(client.backlog.empty()) {
+        return;
+    }
+
+    size_t delivered = 0;
+    if(!client.closing) {
+        while(delivered < client.backlog.size() && client.region->completions.try_push(client.backlog[delivered])) {
+            delivered++;
+        }
+    } else {
+        delivered = client.backlog.size();
+    }
+
+    client.backlog.erase(client.backlog.begin(), client.backlog.begin() + static_cast<ptrdiff_t>(delivered));
+    client.outstanding -= delivered;
+
+    if(delivered > 0 && !client.closing) {
+        signal_event(client.completion_event);
+    }
+}
+
+void stream_server::issue_prefetches() {
+    while(!_prefetch_queue.empty()) {
+        const auto& access = _prefetch_queue.front();
+
+        // One read may exceed the budget on its own, as long as it's the only one in flight
+        if(_prefetch_bytes_in_flight > 0 && _prefetch_bytes_in_flight + access.size > _desc.prefetch_budget) {
+            return;
+        }
+
+        uint64_t file;
+        try {
+            file = open_file(access.path);
+        } catch(const std::exception&) {
+            // Assets that went away since the trace was recorded are simply not prefetched
+            _stats.failed_prefetches++;
+            _prefetch_queue.pop_front();
+            continue;
+        }
+
+        if(access.size == 0 || access.offset > _backend.file_size(file) || access.size > _backend.file_size(file) - access.offset) {
+            _stats.failed_prefetches++;
+            _prefetch_queue.pop_front();
+            continue;
+        }
+
+        const auto operation_id = _next_operation_id++;
+        auto& prefetch = _operations.emplace(operation_id, operation {
+            .client_id = 0,
+            .arena_offset = 0,
+            .completion = stream_completion {
+                .size = access.size
+            },
+            .staging = host_buffer(access.size, _desc.huge_pages, _desc.numa_node)
+        }).first->second;
+
+        _backend.enqueue(read_request {
+            .file = file,
+            .offset = access.offset,
+            .size = access.size,
+            .destination = prefetch.staging.data(),
+            .user_data = operation_id,
+            .priority = read_priority::low
+        });
+
+        _prefetch_bytes_in_flight += access.size;
+        _prefetch_queue.pop_front();
+    }
+}
+
+void stream_server::update_startup_trace() {
+    if(!_recorder || !_recorder->finished()) {
+        return;
+    }
+
+    try {
+        _recorder->save(_desc.startup_trace);
+        printf("stream server: saved %zu startup accesses to %s\n", _recorder->size(), _desc.startup_trace.c_str());
+    } catch(const std::exception& ex) {
+        printf("stream server failed to save the startup trace: %s\n", ex.what());
+    }
+
+    _recorder.reset();
+}
+
+uint64_t stream_server::open_file(const std::string& path) {
+    const auto it = _files.find(path);
+    if(it != _files.end()) {
+        return it->second;
+    }
+
+    const auto file = _backend.open_file(path);
+    _files.emplace(path, file);
+
+    return file;
+}
+
+void stream_server::destroy_client(client& client) {
+    if(client.region) {
+        munmap(client.region, client.region_size);
+    }
+    if(client.completion_event >= 0) {
+        close(client.completion_event);
+    }
+    if(client.request_event >= 0) {
+        close(client.request_event);
+    }
+    close(client.socket);
+}
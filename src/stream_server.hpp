@@ -0,0 +1,127 @@
+#pragma once
+
+#include "caching_backend.hpp"
+#include "host_memory.hpp"
+#include "startup_trace.hpp"
+#include "storage_backend.hpp"
+#include "stream_protocol.hpp"
+#include "verifying_backend.hpp"
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct stream_server_desc {
+    // An empty path disables startup tracing
+    std::filesystem::path startup_trace;
+    std::chrono::milliseconds startup_window = std::chrono::seconds(10);
+    // Bytes of prefetch reads allowed in flight at once
+    uint64_t prefetch_budget = 64 * 1024 * 1024;
+    // Becomes readable whenever the backend has completions to poll; without it reads in flight are
+    // polled every millisecond
+    int backend_event = -1;
+    // Pages and node of the staging memory reads land in before they are copied to clients
+    huge_page_mode huge_pages = huge_page_mode::automatic;
+    int32_t numa_node = -1;
+};
+
+struct stream_server_stats {
+    uint64_t clients;
+    uint64_t requests;
+    uint64_t failed_requests;
+    uint64_t bytes_delivered;
+    uint64_t prefetches;
+    uint64_t failed_prefetches;
+    uint64_t bytes_prefetched;
+};
+
+// Local streaming server that several render processes share, so each asset is opened and read by one
+// I/O engine instead of once per process. Clients attach over a unix socket and get a memfd holding a
+// request ring, a completion ring and a payload arena. Reads land in staging memory of the server's own
+// and are copied into the arena once they have finished: clients can write to their arenas at any time,
+// and a read's bytes are also handed to other requests and to the cache. Files are opened once for all
+// clients; with a coalescing_backend as the backend, identical requests from different clients that
+// are in flight together share one read. When the backend chain contains a caching_backend, passing it
+// as cache adds its counters to the report printed whenever a client leaves; passing a verifying_backend
+// as verifier does the same for its checksum counters.
+//
+// With a startup trace configured, the server records which assets were requested during the first
+// seconds after the first request and saves them once that window has passed. The next run replays the
+// saved trace through the cache before clients ask for anything: reads are issued in recorded order,
+// bounded by prefetch_budget, and every batch goes to the backend together so the coalescing_backend can
+// merge neighbouring offsets. Prefetching needs the cache, since that is where the payloads are kept.
+class stream_server {
+public:
+    stream_server(const std::filesystem::path& socket_path, storage_backend& backend, const stream_server_desc& desc, const caching_backend* cache = nullptr,
+                  const verifying_backend* verifier = nullptr);
+    ~stream_server();
+
+    stream_server(const stream_server&) = delete;
+    stream_server& operator=(const stream_server&) = delete;
+
+    // Serves clients until the process is killed
+    void run();
+
+    const stream_server_stats& stats() const { return _stats; }
+
+private:
+    struct client {
+        int socket;
+        int request_event;
+        int completion_event;
+        stream_shared_region* region;
+        uint64_t region_size;
+        uint8_t* arena;
+        uint64_t arena_size;
+        size_t outstanding;
+        bool closing;
+        std::vector<stream_completion> backlog;
+    };
+
+    struct operation {
+        // 0 for prefetches, which have no client
+        uint64_t client_id;
+        uint64_t arena_offset;
+        stream_completion completion;
+        host_buffer staging;
+    };
+
+    void accept_client();
+    void attach_client(int socket);
+    void drain_requests(uint64_t client_id, client& client);
+    void start_request(uint64_t client_id, client& client, const stream_request& request);
+    void complete(uint64_t client_id, const stream_completion& completion);
+    void flush_completions(client& client);
+    void issue_prefetches();
+    void update_startup_trace();
+    uint64_t open_file(const std::string& path);
+    void destroy_client(client& client);
+
+    std::filesystem::path _socket_path;
+    int _listen_socket = -1;
+    storage_backend& _backend;
+    stream_server_desc _desc;
+    const caching_backend* _cache;
+    const verifying_backend* _verifier;
+
+    std::optional<startup_trace_recorder> _recorder;
+    std::deque<startup_access> _prefetch_queue;
+    uint64_t _prefetch_bytes_in_flight = 0;
+
+    std::unordered_map<uint64_t, client> _clients;
+    uint64_t _next_client_id = 1;
+    // Accepted sockets whose attach request hasn't arrived yet; the loop polls them instead of waiting
+    std::vector<int> _handshaking;
+
+    std::unordered_map<std::string, uint64_t> _files;
+    std::unordered_map<uint64_t, operation> _operations;
+    uint64_t _next_operation_id = 1;
+    std::vector<read_completion> _backend_completions;
+
+    stream_server_stats _stats = {};
+};
@@ -0,0 +1,85 @@
+#include "streaming_budget.hpp"
+#include <algorithm>
+
+streaming_budget::streaming_budget(const streaming_budget_desc& desc) : _desc(desc) {
+    for(size_t i = 0; i < _tokens.size(); i++) {
+        _tokens[i] = static_cast<double>(_desc.burst_bytes[i]);
+    }
+    _stats.scale = _scale;
+}
+
+void streaming_budget::end_frame(clock::duration frame_time) {
+    std::lock_guard lock(_mutex);
+
+    _stats.frames++;
+    if(frame_time > _desc.target_frame_time) {
+        _stats.slow_frames++;
+        _scale = std::max(_scale * _desc.backoff, _desc.min_scale);
+    } else {
+        _scale = std::min(_scale * _desc.recovery, 1.0);
+    }
+    _stats.scale = _scale;
+
+    _frame_bytes = 0;
+    _frame_cpu_time = {};
+}
+
+void streaming_budget::refill(clock::time_point now) {
+    const auto seconds = std::chrono::duration<double>(now - _last_refill).count();
+    _last_refill = now;
+
+    for(size_t i = 0; i < _tokens.size(); i++) {
+        const auto burst = static_cast<double>(_desc.burst_bytes[i]) * _scale;
+        _tokens[i] = std::min(_tokens[i] + static_cast<double>(_desc.bytes_per_second[i]) * _scale * seconds, burst);
+    }
+}
+
+bool streaming_budget::try_admit(read_priority priority, uint64_t bytes) {
+    std::lock_guard lock(_mutex);
+
+    const auto index = static_cast<size_t>(priority);
+    if(priority == read_priority::realtime || _desc.bytes_per_second[index] == 0) {
+        _stats.admitted_loads++;
+        _stats.admitted_bytes += bytes;
+        _frame_bytes += bytes;
+        return true;
+    }
+
+    const auto first_of_frame = _frame_bytes == 0 && _frame_cpu_time == clock::duration::zero();
+    if(!first_of_frame) {
+        if(static_cast<double>(_frame_bytes + bytes) > static_cast<double>(_desc.frame_upload_bytes) * _scale) {
+            _stats.frame_byte_caps++;
+            _stats.deferrals++;
+            return false;
+        }
+        if(std::chrono::duration<double>(_frame_cpu_time) > std::chrono::duration<double>(_desc.frame_cpu_time) * _scale) {
+            _stats.frame_cpu_caps++;
+            _stats.deferrals++;
+            return false;
+        }
+    }
+
+    refill(clock::now());
+
+    const auto burst = static_cast<double>(_desc.burst_bytes[index]) * _scale;
+    if(_tokens[index] < std::min(static_cast<double>(bytes), burst)) {
+        _stats.deferrals++;
+        return false;
+    }
+
+    _tokens[index] -= static_cast<double>(bytes);
+    _frame_bytes += bytes;
+    _stats.admitted_loads++;
+    _stats.admitted_bytes += bytes;
+    return true;
+}
+
+void streaming_budget::record_cpu_time(clock::duration time) {
+    std::lock_guard lock(_mutex);
+    _frame_cpu_time += time;
+}
+
+streaming_budget_stats streaming_budget::stats() const {
+    std::lock_guard lock(_mutex);
+    return _stats;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "storage_backend.hpp"
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+struct streaming_budget_desc {
+    // Sustained rate and burst of each read_priority class, indexed by priority; realtime loads are never held back
+    std::array<uint64_t, 4> bytes_per_second = { 64ull << 20, 256ull << 20, 1024ull << 20, 0 };
+    std::array<uint64_t, 4> burst_bytes = { 32ull << 20, 64ull << 20, 128ull << 20, 0 };
+    // Caps on what the loader may start within one frame
+    uint64_t frame_upload_bytes = 64ull << 20;
+    std::chrono::microseconds frame_cpu_time = std::chrono::milliseconds(4);
+    // Frames slower than this shrink the budget by backoff; faster ones grow it back by recovery
+    std::chrono::microseconds target_frame_time = std::chrono::microseconds(16667);
+    double backoff = 0.5;
+    double recovery = 1.1;
+    double min_scale = 1.0 / 16.0;
+};
+
+struct streaming_budget_stats {
+    uint64_t frames;
+    uint64_t slow_frames;
+    uint64_t admitted_loads;
+    uint64_t admitted_bytes;
+    // Times a load was asked for and held back
+    uint64_t deferrals;
+    uint64_t frame_byte_caps;
+    uint64_t frame_cpu_caps;
+    double scale;
+};
+
+// Paces streaming against the render loop. Every priority class draws from its own token bucket, and
+// all loads started in a frame share a cap on upload bytes and on the CPU time the loader spends on
+// them. The render thread reports every frame time through end_frame(): a frame over the target scales
+// rates and caps down by backoff, and every frame within it lets them recover, so heavy streaming gives
+// way as soon as it shows in frame times. A load is admitted when its bucket holds tokens for it (or
+// is full, so loads larger than the burst still go through), and the first load of a frame always fits
+// the frame caps. Thread-safe: the loader asks from its own thread.
+class streaming_budget {
+public:
+    using clock = std::chrono::steady_clock;
+
+    explicit streaming_budget(const streaming_budget_desc& desc);
+
+    void end_frame(clock::duration frame_time);
+
+    bool try_admit(read_priority priority, uint64_t bytes);
+    void record_cpu_time(clock::duration time);
+
+    streaming_budget_stats stats() const;
+
+private:
+    void refill(clock::time_point now);
+
+    streaming_budget_desc _desc;
+
+    mutable std::mutex _mutex;
+    double _scale = 1.0;
+    std::array<double, 4> _tokens;
+    clock::time_point _last_refill = clock::now();
+    uint64_t _frame_bytes = 0;
+    clock::duration _frame_cpu_time = {};
+    streaming_budget_stats _stats = {};
+};
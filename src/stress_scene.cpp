@@ -0,0 +1,225 @@
+#include "stress_scene.hpp"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <stdexcept>
+
+stress_scene::stress_scene(texture_loader& loader, load_submission_queue& submission_queue, bindless_texture_table& texture_table,
+                           std::vector<std::wstring> asset_paths, const stress_scene_desc& desc)
+    : _loader(loader), _submission_queue(submission_queue), _texture_table(texture_table), _asset_paths(std::move(asset_paths)), _desc(desc) {
+    if(_asset_paths.empty()) {
+        throw std::runtime_error("Stress scene needs at least one asset");
+    }
+
+    _tiles.resize(static_cast<size_t>(desc.grid_size) * desc.grid_size);
+    _visible.resize(_tiles.size());
+    _stats.requests_per_mip.resize(std::bit_width(desc.texture_size));
+
+    _initial_bytes_loaded = loader.bytes_loaded();
+    _initial_deduplicated_requests = loader.deduplicated_requests();
+}
+
+stress_scene::camera stress_scene::camera_at(uint64_t frame_index) const {
+    const auto time = static_cast<double>(frame_index) / 60.0;
+    const auto half_grid = static_cast<double>(_desc.grid_size) * 0.5;
+    const auto amplitude = std::max(half_grid - 8.0, 0.0);
+
+    return camera {
+        .center_x = half_grid + amplitude * std::sin(time * 0.13),
+        .center_y = half_grid + amplitude * std::sin(time * 0.21 + 1.0),
+        .tiles_across = 10.0 + 6.0 * std::sin(time * 0.37)
+    };
+}
+
+uint32_t stress_scene::mip_level_for(double tile_pixels) const {
+    const auto ratio = static_cast<double>(_desc.texture_size) / std::max(tile_pixels, 1.0);
+    const auto mip_level = ratio > 1.0 ? static_cast<uint32_t>(std::floor(std::log2(ratio))) : 0;
+    return std::min(mip_level, static_cast<uint32_t>(_stats.requests_per_mip.size() - 1));
+}
+
+read_priority stress_scene::priority_for(double distance_x, double distance_y, double half_width, double half_height) {
+    // Distance of the tile's center from the camera in half views: below 1 the center is on screen
+    const auto distance = std::max(std::abs(distance_x) / half_width, std::abs(distance_y) / half_height);
+    if(distance < 0.5) {
+        return read_priority::high;
+    }
+    return distance < 1.0 ? read_priority::normal : read_priority::low;
+}
+
+void stress_scene::update(double frame_seconds, VkCommandBuffer command_buffer) {
+    _stats.frames++;
+    _stats.elapsed_seconds += frame_seconds;
+    _stats.max_frame_seconds = std::max(_stats.max_frame_seconds, frame_seconds);
+    if(_frame_index > 0 && frame_seconds > _desc.hitch_threshold_seconds) {
+        _stats.hitches++;
+    }
+
+    const auto view = camera_at(_frame_index);
+    const auto aspect = static_cast<double>(_desc.screen_height) / static_cast<double>(_desc.screen_width);
+    const auto tiles_down = view.tiles_across * aspect;
+    const auto tile_pixels = static_cast<double>(_desc.screen_width) / view.tiles_across;
+    const auto mip_level = mip_level_for(tile_pixels);
+
+    const auto min_x = view.center_x - view.tiles_across * 0.5;
+    const auto min_y = view.center_y - tiles_down * 0.5;
+    const auto grid_size = static_cast<int64_t>(_desc.grid_size);
+
+    const auto first_x = std::clamp<int64_t>(static_cast<int64_t>(std::floor(min_x)), 0, grid_size);
+    const auto last_x = std::clamp<int64_t>(static_cast<int64_t>(std::ceil(min_x + view.tiles_across)), 0, grid_size);
+    const auto first_y = std::clamp<int64_t>(static_cast<int64_t>(std::floor(min_y)), 0, grid_size);
+    const auto last_y = std::clamp<int64_t>(static_cast<int64_t>(std::ceil(min_y + tiles_down)), 0, grid_size);
+
+    std::fill(_visible.begin(), _visible.end(), 0);
+
+    for(auto y = first_y; y < last_y; y++) {
+        for(auto x = first_x; x < last_x; x++) {
+            const auto tile_index = static_cast<uint32_t>(y * grid_size + x);
+            auto& tile = _tiles[tile_index];
+            _visible[tile_index] = 1;
+
+            if(tile.state == tile_state::unloaded || tile.state == tile_state::cancelled) {
+                const auto& path = _asset_paths[tile_index % _asset_paths.size()];
+                const auto request_id = _next_request_id++;
+                const auto priority = priority_for(static_cast<double>(x) + 0.5 - view.center_x, static_cast<double>(y) + 0.5 - view.center_y,
+                                                   view.tiles_across * 0.5, tiles_down * 0.5);
+                // Only the mips the tile shows at its size on screen are read
+                if(!_submission_queue.enqueue(path, _desc.texture_size, _desc.texture_size, request_id, priority, mip_level)) {
+                    continue;
+                }
+
+                if(tile.state == tile_state::cancelled) {
+                    _tile_by_request.erase(tile.request_id);
+                }
+
+                tile.request_id = request_id;
+                tile.state = tile_state::loading;
+                _tile_by_request[request_id] = tile_index;
+
+                _stats.requests++;
+                _stats.requests_per_mip[mip_level]++;
+            }
+        }
+    }
+
+    for(auto i = 0u; i < _tiles.size(); i++) {
+        if(!_visible[i]) {
+            release_tile(_tiles[i]);
+        }
+    }
+
+    // Completed loads are retired after releases so a texture never gets a barrier recorded and is destroyed in the same frame
+    retire_loads(command_buffer);
+
+    _instances.clear();
+
+    for(auto y = first_y; y < last_y; y++) {
+        for(auto x = first_x; x < last_x; x++) {
+            const auto& tile = _tiles[static_cast<uint32_t>(y * grid_size + x)];
+            if(tile.state != tile_state::resident) {
+                _stats.residency_misses++;
+                continue;
+            }
+
+            _instances.push_back(bindless_instance {
+                .rect = {
+                    static_cast<float>((static_cast<double>(x) - min_x) / view.tiles_across * 2.0 - 1.0),
+                    static_cast<float>((static_cast<double>(y) - min_y) / tiles_down * 2.0 - 1.0),
+                    static_cast<float>(2.0 / view.tiles_across),
+                    static_cast<float>(2.0 / tiles_down)
+                },
+                .texture_index = tile.texture_index
+            });
+        }
+    }
+
+    _texture_table.set_instances(_instances);
+
+    _stats.bytes_loaded = _loader.bytes_loaded() - _initial_bytes_loaded;
+    _stats.deduplicated_requests = _loader.deduplicated_requests() - _initial_deduplicated_requests;
+
+    _frame_index++;
+}
+
+void stress_scene::retire_loads(VkCommandBuffer command_buffer) {
+    _completions.clear();
+    _submission_queue.drain(_completions);
+
+    for(const auto& completion : _completions) {
+        const auto it = _tile_by_request.find(completion.user_data);
+        if(completion.error) {
+            // The tile asks again on the next frame it is still in view
+            if(it != _tile_by_request.end()) {
+                _tiles[it->second].state = tile_state::unloaded;
+                _tile_by_request.erase(it);
+            }
+            _stats.failed_loads++;
+            continue;
+        }
+
+        if(it == _tile_by_request.end()) {
+            _loader.release_texture(completion.result);
+            _stats.cancelled_loads++;
+            continue;
+        }
+
+        auto& tile = _tiles[it->second];
+        _tile_by_request.erase(it);
+
+        if(tile.state != tile_state::loading) {
+            tile.state = tile_state::unloaded;
+            _loader.release_texture(completion.result);
+            _stats.cancelled_loads++;
+            continue;
+        }
+
+        tile.state = tile_state::resident;
+        tile.resident_texture = completion.result;
+        tile.texture_index = _texture_table.add_texture(completion.result.image_view);
+    }
+
+    _loader.record_transitions(command_buffer);
+}
+
+void stress_scene::release_tile(tile& tile) {
+    switch(tile.state) {
+        case tile_state::loading:
+            tile.state = tile_state::cancelled;
+            _stats.releases++;
+            break;
+        case tile_state::resident:
+            _texture_table.remove_texture(tile.texture_index);
+            _loader.release_texture(tile.resident_texture);
+            tile.resident_texture = {};
+            tile.state = tile_state::unloaded;
+            _stats.releases++;
+            break;
+        default:
+            break;
+    }
+}
+
+void stress_scene::release_all() {
+    for(auto& tile : _tiles) {
+        release_tile(tile);
+    }
+}
+
+void stress_scene::report(FILE* file) const {
+    const auto megabytes = static_cast<double>(_stats.bytes_loaded) / (1024.0 * 1024.0);
+    const auto bandwidth = _stats.elapsed_seconds > 0.0 ? megabytes / _stats.elapsed_seconds : 0.0;
+
+    fprintf(file, "stress scene: %llu frames in %.2f s, %llu hitches (> %.1f ms), max frame %.1f ms\n",
+            static_cast<unsigned long long>(_stats.frames), _stats.elapsed_seconds, static_cast<unsigned long long>(_stats.hitches),
+            _desc.hitch_threshold_seconds * 1000.0, _stats.max_frame_seconds * 1000.0);
+    fprintf(file, "  residency misses %llu, requests %llu (%llu deduplicated), releases %llu, cancelled %llu, failed %llu\n",
+            static_cast<unsigned long long>(_stats.residency_misses), static_cast<unsigned long long>(_stats.requests),
+            static_cast<unsigned long long>(_stats.deduplicated_requests), static_cast<unsigned long long>(_stats.releases),
+            static_cast<unsigned long long>(_stats.cancelled_loads), static_cast<unsigned long long>(_stats.failed_loads));
+    fprintf(file, "  loaded %.1f MiB, %.1f MiB/s\n", megabytes, bandwidth);
+
+    fprintf(file, "  requests per mip:");
+    for(auto i = 0u; i < _stats.requests_per_mip.size(); i++) {
+        fprintf(file, " %u:%llu", i, static_cast<unsigned long long>(_stats.requests_per_mip[i]));
+    }
+    fprintf(file, "\n");
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "bindless_texture_table.hpp"
+#include "load_submission_queue.hpp"
+#include "texture_loader.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct stress_scene_desc {
+    uint32_t grid_size = 64;
+    uint32_t frame_count = 3600;
+    uint32_t texture_size = 2048;
+    uint32_t screen_width = 1600;
+    uint32_t screen_height = 900;
+    double hitch_threshold_seconds = 2.0 / 60.0;
+};
+
+struct stress_scene_stats {
+    uint64_t frames;
+    uint64_t hitches;
+    uint64_t residency_misses;
+    uint64_t requests;
+    uint64_t deduplicated_requests;
+    uint64_t releases;
+    uint64_t cancelled_loads;
+    uint64_t failed_loads;
+    uint64_t bytes_loaded;
+    double elapsed_seconds;
+    double max_frame_seconds;
+    std::vector<uint64_t> requests_per_mip;
+};
+
+// Grid of quads, each backed by its own asset, viewed by a camera that follows a fixed path derived
+// from the frame index only, so every run issues the same sequence of loads and releases. Tiles that
+// enter the view are requested, tiles that leave it are released immediately. A tile loads only the mips
+// from the one its size on screen needs down. Tiles near the middle of the view are requested at high
+// priority and tiles only partly in view at low priority.
+class stress_scene {
+public:
+    stress_scene(texture_loader& loader, load_submission_queue& submission_queue, bindless_texture_table& texture_table, std::vector<std::wstring> asset_paths,
+                 const stress_scene_desc& desc);
+
+    void update(double frame_seconds, VkCommandBuffer command_buffer);
+    void release_all();
+
+    bool finished() const { return _frame_index >= _desc.frame_count; }
+    const stress_scene_stats& stats() const { return _stats; }
+    void report(FILE* file) const;
+
+private:
+    enum class tile_state {
+        unloaded,
+        loading,
+        cancelled,
+        resident
+    };
+
+    struct tile {
+        tile_state state = tile_state::unloaded;
+        uint64_t request_id = 0;
+        texture resident_texture = {};
+        uint32_t texture_index = 0;
+    };
+
+    struct camera {
+        double center_x;
+        double center_y;
+        double tiles_across;
+    };
+
+    camera camera_at(uint64_t frame_index) const;
+    uint32_t mip_level_for(double tile_pixels) const;
+    static read_priority priority_for(double distance_x, double distance_y, double half_width, double half_height);
+
+    void retire_loads(VkCommandBuffer command_buffer);
+    void release_tile(tile& tile);
+
+    texture_loader& _loader;
+    load_submission_queue& _submission_queue;
+    bindless_texture_table& _texture_table;
+    std::vector<std::wstring> _asset_paths;
+    stress_scene_desc _desc;
+
+    std::vector<tile> _tiles;
+    std::unordered_map<uint64_t, uint32_t> _tile_by_request;
+    std::vector<uint8_t> _visible;
+    std::vector<bindless_instance> _instances;
+    std::vector<streamed_texture> _completions;
+
+    uint64_t _next_request_id = 1;
+    uint64_t _frame_index = 0;
+    uint64_t _initial_bytes_loaded = 0;
+    uint64_t _initial_deduplicated_requests = 0;
+    stress_scene_stats _stats = {};
+};
@@ -0,0 +1,261 @@
+#pragma once
+
+#include "job_system.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <exception>
+#include <future>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+template<typename T>
+class task;
+
+namespace detail {
+    struct task_promise_base {
+        struct final_awaiter {
+            bool await_ready() const noexcept { return false; }
+
+            template<typename Promise>
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+                return handle.promise().continuation;
+            }
+
+            void await_resume() const noexcept {}
+        };
+
+        std::suspend_always initial_suspend() const noexcept { return {}; }
+        final_awaiter final_suspend() const noexcept { return {}; }
+        void unhandled_exception() { exception = std::current_exception(); }
+
+        std::coroutine_handle<> continuation = std::noop_coroutine();
+        std::exception_ptr exception;
+    };
+
+    template<typename T>
+    struct task_promise : task_promise_base {
+        task<T> get_return_object();
+        void return_value(T value) { result.emplace(std::move(value)); }
+
+        T take_result() {
+            if(exception) {
+                std::rethrow_exception(exception);
+            }
+            return std::move(*result);
+        }
+
+        std::optional<T> result;
+    };
+
+    template<>
+    struct task_promise<void> : task_promise_base {
+        task<void> get_return_object();
+        void return_void() const noexcept {}
+
+        void take_result() {
+            if(exception) {
+                std::rethrow_exception(exception);
+            }
+        }
+    };
+
+    // Eagerly started coroutine that owns its own frame; used to drive tasks from outside a coroutine
+    struct detached_task {
+        struct promise_type {
+            detached_task get_return_object() const noexcept { return {}; }
+            std::suspend_never initial_suspend() const noexcept { return {}; }
+            std::suspend_never final_suspend() const noexcept { return {}; }
+            void return_void() const noexcept {}
+            void unhandled_exception() const noexcept { std::terminate(); }
+        };
+    };
+}
+
+// Lazily started coroutine. Awaiting a task starts it and resumes the awaiting coroutine on whichever
+// thread the task finishes on; exceptions thrown inside the task are rethrown by co_await.
+template<typename T = void>
+class [[nodiscard]] task {
+public:
+    using promise_type = detail::task_promise<T>;
+
+    task() = default;
+    explicit task(std::coroutine_handle<promise_type> handle) : _handle(handle) {}
+    task(task&& other) noexcept : _handle(std::exchange(other._handle, nullptr)) {}
+
+    task& operator=(task&& other) noexcept {
+        if(this != &other) {
+            if(_handle) {
+                _handle.destroy();
+            }
+            _handle = std::exchange(other._handle, nullptr);
+        }
+        return *this;
+    }
+
+    ~task() {
+        if(_handle) {
+            _handle.destroy();
+        }
+    }
+
+    bool await_ready() const noexcept { return false; }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) noexcept {
+        _handle.promise().continuation = continuation;
+        return _handle;
+    }
+
+    T await_resume() { return _handle.promise().take_result(); }
+
+private:
+    std::coroutine_handle<promise_type> _handle;
+};
+
+template<typename T>
+task<T> detail::task_promise<T>::get_return_object() {
+    return task<T>(std::coroutine_handle<task_promise<T>>::from_promise(*this));
+}
+
+inline task<void> detail::task_promise<void>::get_return_object() {
+    return task<void>(std::coroutine_handle<task_promise<void>>::from_promise(*this));
+}
+
+// co_await schedule_on(jobs) continues the coroutine as a job on the given job system
+inline auto schedule_on(job_system& jobs) {
+    struct awaiter {
+        job_system& jobs;
+
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> handle) { (void)jobs.schedule([handle] { handle.resume(); }); }
+        void await_resume() const noexcept {}
+    };
+
+    return awaiter { jobs };
+}
+
+namespace detail {
+    template<typename T>
+    struct when_all_state {
+        explicit when_all_state(size_t count) : remaining(count + 1), results(count) {}
+
+        std::atomic<size_t> remaining;
+        std::coroutine_handle<> continuation;
+        std::vector<std::optional<T>> results;
+        std::exception_ptr exception;
+        std::atomic_flag exception_set;
+    };
+
+    template<typename T>
+    detached_task run_when_all_entry(task<T> awaited, when_all_state<T>& state, size_t index) {
+        try {
+            state.results[index].emplace(co_await awaited);
+        } catch(...) {
+            if(!state.exception_set.test_and_set()) {
+                state.exception = std::current_exception();
+            }
+        }
+
+        if(state.remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            state.continuation.resume();
+        }
+    }
+
+    template<typename T>
+    struct when_all_awaiter {
+        when_all_state<T>& state;
+        std::vector<task<T>>& tasks;
+
+        bool await_ready() const noexcept { return false; }
+
+        bool await_suspend(std::coroutine_handle<> continuation) {
+            state.continuation = continuation;
+            for(size_t i = 0; i < tasks.size(); i++) {
+                run_when_all_entry(std::move(tasks[i]), state, i);
+            }
+            return state.remaining.fetch_sub(1, std::memory_order_acq_rel) != 1;
+        }
+
+        void await_resume() const noexcept {}
+    };
+
+    template<typename T>
+    struct sync_wait_state {
+        std::mutex mutex;
+        std::condition_variable condition;
+        bool done = false;
+        std::optional<T> result;
+        std::exception_ptr exception;
+    };
+
+    template<typename T>
+    detached_task run_sync_wait(task<T>& awaited, sync_wait_state<T>& state) {
+        try {
+            state.result.emplace(co_await awaited);
+        } catch(...) {
+            state.exception = std::current_exception();
+        }
+
+        // Notify under the lock so the waiting thread can't destroy the state before this returns
+        std::lock_guard lock(state.mutex);
+        state.done = true;
+        state.condition.notify_one();
+    }
+
+    template<typename T>
+    detached_task run_start_task(task<T> awaited, std::promise<T> promise) {
+        try {
+            promise.set_value(co_await awaited);
+        } catch(...) {
+            promise.set_exception(std::current_exception());
+        }
+    }
+}
+
+// Runs all tasks concurrently and completes once the last one has finished, without blocking a
+// thread in between. Results keep the order of the input; the first exception is rethrown.
+template<typename T>
+task<std::vector<T>> when_all(std::vector<task<T>> tasks) {
+    detail::when_all_state<T> state(tasks.size());
+    co_await detail::when_all_awaiter<T> { state, tasks };
+
+    if(state.exception) {
+        std::rethrow_exception(state.exception);
+    }
+
+    std::vector<T> results;
+    results.reserve(state.results.size());
+    for(auto& result : state.results) {
+        results.push_back(std::move(*result));
+    }
+
+    co_return results;
+}
+
+// Blocks the calling thread until the task has finished; meant for code outside of coroutines
+template<typename T>
+T sync_wait(task<T> awaited) {
+    detail::sync_wait_state<T> state;
+    detail::run_sync_wait(awaited, state);
+
+    std::unique_lock lock(state.mutex);
+    state.condition.wait(lock, [&] { return state.done; });
+
+    if(state.exception) {
+        std::rethrow_exception(state.exception);
+    }
+
+    return std::move(*state.result);
+}
+
+// Starts the task right away and returns without waiting for it. The future is for threads outside the
+// job system; jobs would block a worker on it, and should await the task instead.
+template<typename T>
+std::future<T> start_task(task<T> awaited) {
+    std::promise<T> promise;
+    auto result = promise.get_future();
+    detail::run_start_task(std::move(awaited), std::move(promise));
+    return result;
+}
@@ -0,0 +1,232 @@
+#include "texture_layout.hpp"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+    constexpr uint32_t dds_magic = 0x20534444; // "DDS "
+    constexpr size_t dds_header_size = 124;
+    constexpr size_t dx10_header_size = 20;
+    constexpr uint32_t bytes_per_texel = 4;
+
+    constexpr uint32_t ddsd_mipmapcount = 0x20000;
+    constexpr uint32_t ddsd_depth = 0x800000;
+    constexpr uint32_t ddpf_fourcc = 0x4;
+    constexpr uint32_t ddpf_rgb = 0x40;
+    constexpr uint32_t ddscaps2_cubemap = 0x200;
+    constexpr uint32_t dx10_fourcc = 0x30315844; // "DX10"
+    constexpr uint32_t dx10_misc_texturecube = 0x4;
+    constexpr uint32_t dx10_dimension_texture2d = 3;
+
+    // DXGI_FORMAT_R8G8B8A8_TYPELESS, _UNORM and _UNORM_SRGB
+    constexpr uint32_t dxgi_rgba8_first = 27;
+    constexpr uint32_t dxgi_rgba8_last = 29;
+
+    uint32_t read_u32(std::span<const uint8_t> bytes, size_t offset) {
+        uint32_t value;
+        memcpy(&value, bytes.data() + offset, sizeof(value));
+        return value;
+    }
+
+    // DDS stores every mip of layer 0, then every mip of layer 1, which is already subresource order
+    void add_subresources(texture_layout& layout) {
+        auto offset = layout.header_size;
+
+        for(uint32_t layer = 0; layer < layout.array_layers; layer++) {
+            for(uint32_t mip = 0; mip < layout.mip_levels; mip++) {
+                const auto width = std::max(layout.width >> mip, 1u);
+                const auto height = std::max(layout.height >> mip, 1u);
+                const auto row_pitch = static_cast<uint64_t>(width) * bytes_per_texel;
+
+                layout.subresources.push_back(subresource_layout {
+                    .mip_level = mip,
+                    .array_layer = layer,
+                    .width = width,
+                    .height = height,
+                    .offset = offset,
+                    .row_pitch = row_pitch,
+                    .slice_pitch = row_pitch * height
+                });
+                offset += row_pitch * height;
+            }
+        }
+    }
+
+    texture_layout parse_dds_layout(std::span<const uint8_t> header, uint32_t width, uint32_t height) {
+        if(header.size() < 4 + dds_header_size) {
+            throw std::runtime_error("DDS header is truncated");
+        }
+
+        const auto dds = header.subspan(4);
+        const auto flags = read_u32(dds, 4);
+        const auto file_height = read_u32(dds, 8);
+        const auto file_width = read_u32(dds, 12);
+        const auto depth = read_u32(dds, 20);
+        const auto mip_count = read_u32(dds, 24);
+        const auto format_flags = read_u32(dds, 76);
+        const auto fourcc = read_u32(dds, 80);
+        const auto caps2 = read_u32(dds, 108);
+
+        if(file_width != width || file_height != height) {
+            throw std::runtime_error(std::format("DDS is {}x{}, expected {}x{}", file_width, file_height, width, height));
+        }
+        if((flags & ddsd_depth) && depth > 1) {
+            throw std::runtime_error("Volume DDS textures are not supported");
+        }
+
+        texture_layout layout = {
+            .width = width,
+            .height = height,
+            .mip_levels = (flags & ddsd_mipmapcount) && mip_count > 0 ? mip_count : 1,
+            .array_layers = 1,
+            .header_size = 4 + dds_header_size,
+            .subresources = {}
+        };
+
+        if((format_flags & ddpf_fourcc) && fourcc == dx10_fourcc) {
+            if(header.size() < 4 + dds_header_size + dx10_header_size) {
+                throw std::runtime_error("DDS DX10 header is truncated");
+            }
+
+            const auto dx10 = dds.subspan(dds_header_size);
+            const auto format = read_u32(dx10, 0);
+            const auto dimension = read_u32(dx10, 4);
+            const auto misc_flags = read_u32(dx10, 8);
+            const auto array_size = read_u32(dx10, 12);
+
+            if(format < dxgi_rgba8_first || format > dxgi_rgba8_last || dimension != dx10_dimension_texture2d) {
+                throw std::runtime_error(std::format("DDS format {} is not a 2D R8G8B8A8 texture", format));
+            }
+
+            // Checked before the cube faces multiply it, which could wrap
+            if(array_size > texture_max_array_layers) {
+                throw std::runtime_error(std::format("DDS has {} array elements, at most {} are supported", array_size, texture_max_array_layers));
+            }
+
+            layout.header_size += dx10_header_size;
+            layout.array_layers = std::max(array_size, 1u) * (misc_flags & dx10_misc_texturecube ? 6 : 1);
+        } else {
+            const auto bit_count = read_u32(dds, 84);
+            const auto red_mask = read_u32(dds, 88);
+            const auto green_mask = read_u32(dds, 92);
+            const auto blue_mask = read_u32(dds, 96);
+
+            if(!(format_flags & ddpf_rgb) || bit_count != 32 || red_mask != 0x000000ff || green_mask != 0x0000ff00 || blue_mask != 0x00ff0000) {
+                throw std::runtime_error("Only 32-bit RGBA DDS textures are supported");
+            }
+
+            if(caps2 & ddscaps2_cubemap) {
+                layout.array_layers = 6;
+            }
+        }
+
+        if(layout.array_layers > texture_max_array_layers) {
+            throw std::runtime_error(std::format("DDS has {} array layers, at most {} are supported", layout.array_layers, texture_max_array_layers));
+        }
+
+        const auto max_mips = std::bit_width(std::max(width, height));
+        if(layout.mip_levels > static_cast<uint32_t>(max_mips)) {
+            throw std::runtime_error(std::format("DDS has {} mip levels, a {}x{} texture has at most {}", layout.mip_levels, width, height, max_mips));
+        }
+
+        return layout;
+    }
+}
+
+texture_layout parse_texture_layout(std::span<const uint8_t> header, uint64_t file_size, uint32_t width, uint32_t height) {
+    texture_layout layout;
+
+    if(header.size() >= 4 && read_u32(header, 0) == dds_magic) {
+        layout = parse_dds_layout(header, width, height);
+    } else {
+        layout = {
+            .width = width,
+            .height = height,
+            .mip_levels = 1,
+            .array_layers = 1,
+            .header_size = 0,
+            .subresources = {}
+        };
+    }
+
+    add_subresources(layout);
+
+    const auto& last = layout.subresources.back();
+    if(file_size < last.offset + last.slice_pitch) {
+        throw std::runtime_error(std::format("Texture file is {} bytes, its layout needs {}", file_size, last.offset + last.slice_pitch));
+    }
+
+    return layout;
+}
+
+texture_layout read_texture_layout(const std::filesystem::path& path, uint32_t width, uint32_t height) {
+    std::ifstream file(path, std::ios::binary);
+    if(!file) {
+        throw std::runtime_error(std::format("Failed to open {}", path.string()));
+    }
+
+    uint8_t header[texture_header_size];
+    file.read(reinterpret_cast<char*>(header), sizeof(header));
+
+    try {
+        return parse_texture_layout(std::span(header, static_cast<size_t>(file.gcount())), std::filesystem::file_size(path), width, height);
+    } catch(const std::runtime_error& e) {
+        throw std::runtime_error(std::format("{}: {}", path.string(), e.what()));
+    }
+}
+
+texture_layout drop_top_mips(const texture_layout& layout, uint32_t first_mip) {
+    first_mip = std::min(first_mip, layout.mip_levels - 1);
+
+    texture_layout dropped = {
+        .width = std::max(layout.width >> first_mip, 1u),
+        .height = std::max(layout.height >> first_mip, 1u),
+        .mip_levels = layout.mip_levels - first_mip,
+        .array_layers = layout.array_layers,
+        .header_size = layout.header_size,
+        .subresources = {}
+    };
+
+    // Keeping the remaining mips in order keeps them in subresource order for the smaller chain
+    for(auto subresource : layout.subresources) {
+        if(subresource.mip_level >= first_mip) {
+            subresource.mip_level -= first_mip;
+            dropped.subresources.push_back(subresource);
+        }
+    }
+
+    return dropped;
+}
+
+std::vector<subresource_read> build_subresource_reads(const texture_layout& layout, uint64_t max_read_size, uint64_t row_pitch_alignment) {
+    std::vector<subresource_read> reads;
+
+    for(uint32_t index = 0; index < layout.subresources.size(); index++) {
+        const auto& subresource = layout.subresources[index];
+
+        uint32_t band_rows = 1;
+        if(subresource.row_pitch % row_pitch_alignment == 0) {
+            band_rows = static_cast<uint32_t>(std::clamp<uint64_t>(max_read_size / subresource.row_pitch, 1, subresource.height));
+        }
+
+        for(uint32_t top = 0; top < subresource.height; top += band_rows) {
+            const auto rows = std::min(band_rows, subresource.height - top);
+
+            reads.push_back(subresource_read {
+                .subresource = index,
+                .mip_level = subresource.mip_level,
+                .array_layer = subresource.array_layer,
+                .width = subresource.width,
+                .first_row = top,
+                .row_count = rows,
+                .offset = subresource.offset + top * subresource.row_pitch,
+                .size = (rows - 1) * subresource.row_pitch + static_cast<uint64_t>(subresource.width) * bytes_per_texel
+            });
+        }
+    }
+
+    return reads;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <vector>
+
+// Where one mip level of one array layer lives in a texture file. Rows are row_pitch apart and the
+// whole subresource covers slice_pitch bytes from offset.
+struct subresource_layout {
+    uint32_t mip_level;
+    uint32_t array_layer;
+    uint32_t width;
+    uint32_t height;
+    uint64_t offset;
+    uint64_t row_pitch;
+    uint64_t slice_pitch;
+};
+
+// R8G8B8A8 texels only, which is all the loaders create. Subresources are ordered like D3D12 and Vulkan
+// index them: mip_level + array_layer * mip_levels.
+struct texture_layout {
+    uint32_t width;
+    uint32_t height;
+    uint32_t mip_levels;
+    uint32_t array_layers;
+    uint64_t header_size;
+    std::vector<subresource_layout> subresources;
+};
+
+// One read of a band of rows of a subresource
+struct subresource_read {
+    uint32_t subresource;
+    uint32_t mip_level;
+    uint32_t array_layer;
+    uint32_t width;
+    uint32_t first_row;
+    uint32_t row_count;
+    uint64_t offset;
+    uint64_t size;
+};
+
+// Bytes of a file parse_texture_layout() needs to see: the DDS magic, header and DX10 extension
+inline constexpr size_t texture_header_size = 4 + 124 + 20;
+
+// Most array layers (cube faces included) a DDS may have; the D3D12 and common Vulkan limit
+inline constexpr uint32_t texture_max_array_layers = 2048;
+
+// Files starting with a DDS header get the layout it describes, which has to match width and height;
+// anything else is taken as width * height texels from the start of the file. Throws when the file is
+// too short for its layout, the DDS holds a format other than 32-bit RGBA, or it has more mips or array
+// layers than a texture of its size can.
+texture_layout parse_texture_layout(std::span<const uint8_t> header, uint64_t file_size, uint32_t width, uint32_t height);
+texture_layout read_texture_layout(const std::filesystem::path& path, uint32_t width, uint32_t height);
+
+// The layout of the texture made of mips first_mip and smaller, which a texture seen from far away
+// needs: the size is that of first_mip and mip levels count from it. first_mip is clamped to the
+// smallest mip.
+texture_layout drop_top_mips(const texture_layout& layout, uint32_t first_mip);
+
+// One read per subresource at its exact offset, split into bands of whole rows of at most max_read_size.
+// Destinations that need row_pitch_alignment get one read per row where the file's rows aren't aligned
+// to it, since a single row has no pitch.
+std::vector<subresource_read> build_subresource_reads(const texture_layout& layout, uint64_t max_read_size, uint64_t row_pitch_alignment = 1);
@@ -0,0 +1,528 @@
+#include "texture_loader.hpp"
+#include <algorithm>
+#include <format>
+#include <memory>
+#include <stdexcept>
+
+namespace {
+    struct com_release {
+        void operator()(IUnknown* object) const { object->Release(); }
+    };
+}
+
+texture_loader::texture_loader(VkDevice device, ID3D12Device8* d3d12_device, IDStorageFactory* dstorage_factory, IDStorageQueue* dstorage_queue,
+                               load_telemetry& telemetry)
+    : _device(device), _d3d12_device(d3d12_device), _dstorage_factory(dstorage_factory), _dstorage_queue(dstorage_queue), _telemetry(telemetry) {
+    throw_if_failed(d3d12_device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&_fence)), "ID3D12Device::CreateFence");
+
+    _fence_event = CreateEvent(nullptr, false, false, nullptr);
+    if(!_fence_event) {
+        throw std::runtime_error("CreateEvent failed");
+    }
+}
+
+texture_loader::~texture_loader() {
+    if(!_pending.empty()) {
+        submit_batch();
+
+        _fence->SetEventOnCompletion(_fence_value, _fence_event);
+        if(_fence->GetCompletedValue() < _fence_value) {
+            WaitForSingleObject(_fence_event, INFINITE);
+        }
+
+        retire_completed();
+    }
+
+    for(const auto& [key, shared] : _textures) {
+        destroy_texture(shared.target);
+    }
+
+    for(auto* status_array : _status_arrays) {
+        status_array->Release();
+    }
+
+    CloseHandle(_fence_event);
+    _fence->Release();
+}
+
+texture_loader::load_ticket texture_loader::enqueue(const std::wstring_view& path, uint32_t width, uint32_t height, uint32_t first_mip, uint64_t telemetry_id) {
+    std::unique_lock lock(_mutex);
+
+    const auto ticket = _next_ticket++;
+    const texture_key key = {
+        .path = std::wstring(path),
+        .first_mip = first_mip
+    };
+
+    const auto existing = _textures.find(key);
+    if(existing != _textures.end()) {
+        auto& shared = existing->second;
+        if(shared.width != width || shared.height != height) {
+            throw std::runtime_error("Texture requested again with a different size");
+        }
+
+        shared.references++;
+        _deduplicated_requests++;
+
+        if(telemetry_id) {
+            _telemetry.cancel_request(telemetry_id);
+        }
+
+        if(shared.loaded) {
+            _completed.push_back(completion {
+                .ticket = ticket,
+                .result = shared.target
+            });
+        } else {
+            shared.waiting_tickets.push_back(ticket);
+        }
+
+        return ticket;
+    }
+
+    if(!telemetry_id) {
+        telemetry_id = _telemetry.begin_request();
+    }
+
+    // Later requests for the same path and first mip attach to this entry while its resources are created unlocked
+    _textures.emplace(key, shared_texture {
+        .target = {},
+        .width = width,
+        .height = height,
+        .references = 1,
+        .loaded = false,
+        .waiting_tickets = { ticket }
+    });
+
+    lock.unlock();
+
+    std::unique_ptr<IDStorageFile, com_release> dstorage_file;
+    texture target = {};
+    std::vector<subresource_read> reads;
+    uint32_t status_entry;
+    try {
+        // Container headers stay in the file: every subresource is read from its own offset into its own
+        // mip level and array layer, in bands of whole rows so any size stays under the request limit and
+        // DirectStorage can read the bands in parallel
+        const auto layout = drop_top_mips(read_texture_layout(path, width, height), first_mip);
+        reads = build_subresource_reads(layout, dstorage_max_request_size, D3D12_TEXTURE_DATA_PITCH_ALIGNMENT);
+
+        IDStorageFile* opened_file;
+        throw_if_failed(_dstorage_factory->OpenFile(std::wstring(path).c_str(), IID_PPV_ARGS(&opened_file)), "IDStorageFactory::OpenFile");
+        dstorage_file.reset(opened_file);
+
+        target = create_texture(layout);
+
+        lock.lock();
+        status_entry = acquire_status_entry();
+    } catch(const std::exception&) {
+        if(!lock.owns_lock()) {
+            lock.lock();
+        }
+
+        if(target.image) {
+            destroy_texture(target);
+        }
+        _telemetry.cancel_request(telemetry_id);
+
+        // This caller gets the exception; requests that attached to the entry meanwhile get it as their completion
+        std::erase(_textures.at(key).waiting_tickets, ticket);
+        fail_load(key, std::current_exception());
+        _load_started.notify_all();
+        throw;
+    }
+
+    _telemetry.mark(telemetry_id, load_stage::dispatch);
+
+    for(const auto& read : reads) {
+        DSTORAGE_REQUEST request = {
+            .Options = {
+                .SourceType = DSTORAGE_REQUEST_SOURCE_FILE,
+                .DestinationType = DSTORAGE_REQUEST_DESTINATION_TEXTURE_REGION,
+            },
+            .Source = {
+                .File = {
+                    .Source = dstorage_file.get(),
+                    .Offset = read.offset,
+                    .Size = static_cast<uint32_t>(read.size)
+                }
+            },
+            .Destination = {
+                .Texture = {
+                    .Resource = target.resource,
+                    .SubresourceIndex = read.subresource,
+                    .Region = {
+                        .left = 0,
+                        .top = read.first_row,
+                        .front = 0,
+                        .right = read.width,
+                        .bottom = read.first_row + read.row_count,
+                        .back = 1
+                    }
+                }
+            },
+            .UncompressedSize = static_cast<uint32_t>(read.size)
+        };
+
+        _dstorage_queue->EnqueueRequest(&request);
+    }
+
+    // The status entry reports the first failure among the requests enqueued since the previous one, which
+    // the lock keeps to exactly this load's reads
+    _dstorage_queue->EnqueueStatus(_status_arrays[status_entry / status_array_capacity], status_entry % status_array_capacity);
+
+    _textures.at(key).target = target;
+    _keys_by_image.emplace(target.image, key);
+
+    _pending.push_back(pending_load {
+        .key = key,
+        .telemetry_id = telemetry_id,
+        .fence_value = 0,
+        .status_entry = status_entry,
+        .file = dstorage_file.release()
+    });
+    _load_started.notify_all();
+
+    return ticket;
+}
+
+texture texture_loader::create_texture(const texture_layout& layout) {
+    // The resource desc holds both in 16 bits
+    if(layout.array_layers > D3D12_REQ_TEXTURE2D_ARRAY_AXIS_DIMENSION || layout.mip_levels > D3D12_REQ_MIP_LEVELS) {
+        throw std::runtime_error(std::format("{} array layers and {} mip levels don't fit a D3D12 texture", layout.array_layers, layout.mip_levels));
+    }
+
+    D3D12_RESOURCE_DESC resource_desc = {
+        .Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D,
+        .Width = layout.width,
+        .Height = layout.height,
+        .DepthOrArraySize = static_cast<UINT16>(layout.array_layers),
+        .MipLevels = static_cast<UINT16>(layout.mip_levels),
+        .Format = DXGI_FORMAT_R8G8B8A8_UNORM,
+        .SampleDesc = { .Count = 1, .Quality = 0 },
+        .Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN,
+        .Flags = D3D12_RESOURCE_FLAG_NONE
+    };
+
+    D3D12_HEAP_PROPERTIES heap_properties = {
+        .Type = D3D12_HEAP_TYPE_DEFAULT
+    };
+
+    ID3D12Resource* resource;
+    throw_if_failed(_d3d12_device->CreateCommittedResource(&heap_properties, D3D12_HEAP_FLAG_SHARED, &resource_desc, D3D12_RESOURCE_STATE_COMMON, nullptr, IID_PPV_ARGS(&resource)),
+                    "ID3D12Device::CreateCommittedResource");
+
+    HANDLE handle;
+    throw_if_failed(_d3d12_device->CreateSharedHandle(resource, nullptr, GENERIC_ALL, nullptr, &handle), "ID3D12Device::CreateSharedHandle");
+
+    VkExternalMemoryImageCreateInfo external_memory_image_create_info = {
+        .sType = VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_IMAGE_CREATE_INFO,
+        .handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_D3D12_RESOURCE_BIT
+    };
+
+    VkImageCreateInfo image_create_info = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .pNext = &external_memory_image_create_info,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .format = VK_FORMAT_R8G8B8A8_UNORM,
+        .extent = { .width = layout.width, .height = layout.height, .depth = 1 },
+        .mipLevels = layout.mip_levels,
+        .arrayLayers = layout.array_layers,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .usage = VK_IMAGE_USAGE_SAMPLED_BIT
+    };
+
+    VkImage image;
+    throw_if_failed(vkCreateImage(_device, &image_create_info, nullptr, &image), "vkCreateImage");
+
+    VkImportMemoryWin32HandleInfoKHR import_memory_win32_handle_info = {
+        .sType = VK_STRUCTURE_TYPE_IMPORT_MEMORY_WIN32_HANDLE_INFO_KHR,
+        .handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_D3D12_RESOURCE_BIT,
+        .handle = handle
+    };
+
+    VkMemoryAllocateInfo memory_allocate_info = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .pNext = &import_memory_win32_handle_info
+    };
+
+    VkDeviceMemory memory;
+    throw_if_failed(vkAllocateMemory(_device, &memory_allocate_info, nullptr, &memory), "vkAllocateMemory");
+    CloseHandle(handle);
+
+    throw_if_failed(vkBindImageMemory(_device, image, memory, 0), "vkBindImageMemory");
+
+    uint64_t size_bytes = 0;
+    for(const auto& subresource : layout.subresources) {
+        size_bytes += subresource.slice_pitch;
+    }
+
+    return texture {
+        .image = image,
+        .memory = memory,
+        .image_view = VK_NULL_HANDLE,
+        .resource = resource,
+        .size_bytes = size_bytes
+    };
+}
+
+void texture_loader::submit() {
+    std::lock_guard lock(_mutex);
+    submit_batch();
+}
+
+void texture_loader::submit_batch() {
+    if(std::none_of(_pending.begin(), _pending.end(), [](const pending_load& load) { return load.fence_value == 0; })) {
+        return;
+    }
+
+    _fence_value++;
+    _dstorage_queue->EnqueueSignal(_fence, _fence_value);
+
+    for(auto& load : _pending) {
+        if(load.fence_value == 0) {
+            load.fence_value = _fence_value;
+            _telemetry.mark(load.telemetry_id, load_stage::io_issue);
+        }
+    }
+
+    _dstorage_queue->Submit();
+}
+
+void texture_loader::poll(std::vector<completion>& completions) {
+    std::lock_guard lock(_mutex);
+    retire_completed();
+
+    completions.insert(completions.end(), _completed.begin(), _completed.end());
+    _completed.clear();
+}
+
+texture texture_loader::wait(load_ticket ticket) {
+    std::unique_lock lock(_mutex);
+
+    const auto is_waiting = [ticket](const shared_texture& shared) {
+        return std::find(shared.waiting_tickets.begin(), shared.waiting_tickets.end(), ticket) != shared.waiting_tickets.end();
+    };
+    const auto is_pending = [&](const texture_key& key) {
+        return std::any_of(_pending.begin(), _pending.end(), [&](const pending_load& load) { return load.key == key; });
+    };
+
+    // A ticket may have attached to a load whose resources another thread is still creating unlocked
+    _load_started.wait(lock, [&] {
+        return std::none_of(_textures.begin(), _textures.end(), [&](const auto& entry) { return is_waiting(entry.second) && !is_pending(entry.first); });
+    });
+
+    const auto it = std::find_if(_pending.begin(), _pending.end(), [&](const pending_load& load) { return is_waiting(_textures.at(load.key)); });
+    if(it != _pending.end()) {
+        if(it->fence_value == 0) {
+            submit_batch();
+        }
+
+        const auto fence_value = it->fence_value;
+        lock.unlock();
+
+        _fence->SetEventOnCompletion(fence_value, _fence_event);
+        if(_fence->GetCompletedValue() < fence_value) {
+            WaitForSingleObject(_fence_event, INFINITE);
+        }
+
+        lock.lock();
+    }
+
+    retire_completed();
+
+    const auto completed = std::find_if(_completed.begin(), _completed.end(), [ticket](const completion& completion) { return completion.ticket == ticket; });
+    if(completed == _completed.end()) {
+        throw std::runtime_error(std::format("Unknown texture load ticket {}", ticket));
+    }
+
+    const auto result = *completed;
+    _completed.erase(completed);
+
+    if(result.error) {
+        std::rethrow_exception(result.error);
+    }
+
+    return result.result;
+}
+
+uint32_t texture_loader::acquire_status_entry() {
+    if(_free_status_entries.empty()) {
+        IDStorageStatusArray* status_array;
+        throw_if_failed(_dstorage_factory->CreateStatusArray(status_array_capacity, "texture_loader", IID_PPV_ARGS(&status_array)),
+                        "IDStorageFactory::CreateStatusArray");
+
+        const auto first = static_cast<uint32_t>(_status_arrays.size()) * status_array_capacity;
+        _status_arrays.push_back(status_array);
+        for(auto entry = first + status_array_capacity; entry-- > first;) {
+            _free_status_entries.push_back(entry);
+        }
+    }
+
+    const auto entry = _free_status_entries.back();
+    _free_status_entries.pop_back();
+    return entry;
+}
+
+void texture_loader::retire_completed() {
+    const auto completed_value = _fence->GetCompletedValue();
+    if(_pending.empty() || completed_value == 0) {
+        return;
+    }
+
+    // The queue's error record only keeps its first failure, so every load checks its own status entry instead
+    std::erase_if(_pending, [&](pending_load& load) {
+        if(load.fence_value == 0 || load.fence_value > completed_value) {
+            return false;
+        }
+
+        const auto result = _status_arrays[load.status_entry / status_array_capacity]->GetHResult(load.status_entry % status_array_capacity);
+        _free_status_entries.push_back(load.status_entry);
+        load.file->Release();
+
+        try {
+            throw_if_failed(result, "DirectStorage request");
+            finish_load(load);
+        } catch(const std::exception&) {
+            _telemetry.cancel_request(load.telemetry_id);
+            fail_load(load.key, std::current_exception());
+        }
+        return true;
+    });
+}
+
+void texture_loader::finish_load(pending_load& load) {
+    // DirectStorage reads, decompresses and copies into the texture behind a single fence signal
+    _telemetry.mark(load.telemetry_id, load_stage::gpu_copy_submitted);
+
+    auto& shared = _textures.at(load.key);
+
+    VkImageViewCreateInfo image_view_create_info = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .image = shared.target.image,
+        .viewType = VK_IMAGE_VIEW_TYPE_2D,
+        .format = VK_FORMAT_R8G8B8A8_UNORM,
+        .components = VkComponentMapping {
+            .r = VK_COMPONENT_SWIZZLE_IDENTITY,
+            .g = VK_COMPONENT_SWIZZLE_IDENTITY,
+            .b = VK_COMPONENT_SWIZZLE_IDENTITY,
+            .a = VK_COMPONENT_SWIZZLE_IDENTITY
+        },
+        // The shaders sample 2D textures, so arrays show their first layer with its whole mip chain
+        .subresourceRange = VkImageSubresourceRange {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .levelCount = VK_REMAINING_MIP_LEVELS,
+            .layerCount = 1
+        }
+    };
+
+    throw_if_failed(vkCreateImageView(_device, &image_view_create_info, nullptr, &shared.target.image_view), "vkCreateImageView");
+
+    _telemetry.mark(load.telemetry_id, load_stage::image_usable);
+
+    shared.loaded = true;
+    _bytes_loaded += shared.target.size_bytes;
+    _untransitioned_images.push_back(shared.target.image);
+
+    for(const auto ticket : shared.waiting_tickets) {
+        _completed.push_back(completion {
+            .ticket = ticket,
+            .result = shared.target
+        });
+    }
+    shared.waiting_tickets.clear();
+}
+
+void texture_loader::fail_load(const texture_key& key, const std::exception_ptr& error) {
+    const auto shared = _textures.find(key);
+
+    for(const auto ticket : shared->second.waiting_tickets) {
+        _completed.push_back(completion {
+            .ticket = ticket,
+            .result = {},
+            .error = error
+        });
+    }
+
+    // Requests after this one load the path again
+    if(shared->second.target.image) {
+        _keys_by_image.erase(shared->second.target.image);
+        destroy_texture(shared->second.target);
+    }
+    _textures.erase(shared);
+}
+
+void texture_loader::record_transitions(VkCommandBuffer command_buffer) {
+    std::lock_guard lock(_mutex);
+
+    if(_untransitioned_images.empty()) {
+        return;
+    }
+
+    std::vector<VkImageMemoryBarrier> image_memory_barriers;
+    for(const auto image : _untransitioned_images) {
+        image_memory_barriers.push_back(VkImageMemoryBarrier {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .srcAccessMask = 0,
+            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+            .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+            .newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            .image = image,
+            .subresourceRange = VkImageSubresourceRange {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .levelCount = VK_REMAINING_MIP_LEVELS,
+                .layerCount = VK_REMAINING_ARRAY_LAYERS
+            }
+        });
+    }
+
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr,
+                         static_cast<uint32_t>(image_memory_barriers.size()), image_memory_barriers.data());
+
+    _untransitioned_images.clear();
+}
+
+void texture_loader::release_texture(const texture& texture) {
+    std::lock_guard lock(_mutex);
+
+    const auto key = _keys_by_image.find(texture.image);
+    if(key == _keys_by_image.end()) {
+        return;
+    }
+
+    const auto shared = _textures.find(key->second);
+    if(--shared->second.references > 0) {
+        return;
+    }
+
+    std::erase(_untransitioned_images, texture.image);
+    destroy_texture(shared->second.target);
+
+    _textures.erase(shared);
+    _keys_by_image.erase(key);
+}
+
+size_t texture_loader::in_flight() const {
+    std::lock_guard lock(_mutex);
+    return _pending.size();
+}
+
+uint64_t texture_loader::deduplicated_requests() const {
+    std::lock_guard lock(_mutex);
+    return _deduplicated_requests;
+}
+
+uint64_t texture_loader::bytes_loaded() const {
+    std::lock_guard lock(_mutex);
+    return _bytes_loaded;
+}
+
+void texture_loader::destroy_texture(const texture& texture) {
+    if(texture.image_view) {
+        vkDestroyImageView(_device, texture.image_view, nullptr);
+    }
+    vkFreeMemory(_device, texture.memory, nullptr);
+    vkDestroyImage(_device, texture.image, nullptr);
+    texture.resource->Release();
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include "d3d12_utils.hpp"
+#include "vulkan_utils.hpp"
+#include "load_telemetry.hpp"
+#include "texture_layout.hpp"
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+struct texture {
+    VkImage image;
+    VkDeviceMemory memory;
+    VkImageView image_view;
+    ID3D12Resource* resource;
+    uint64_t size_bytes;
+};
+
+// Loads textures into D3D12 resources shared with Vulkan. Requests are batched until submit(), every
+// batch is followed by a fence signal, and poll() hands out the textures whose batch has completed.
+// Requests for a path and first mip that are already loading or resident attach to that texture instead
+// of reading it again; every completion holds one reference, which release_texture() drops. A request
+// with a first mip above 0 loads only that mip and the smaller ones, into a texture the size of first_mip. All public functions
+// may be called from different threads, and concurrent enqueue() calls create their resources in parallel.
+// A load whose reads fail completes every ticket waiting on it with the error instead of a texture.
+class texture_loader {
+public:
+    using load_ticket = uint64_t;
+
+    struct completion {
+        load_ticket ticket;
+        texture result;
+        // Set when the load failed, and result is empty
+        std::exception_ptr error;
+    };
+
+    texture_loader(VkDevice device, ID3D12Device8* d3d12_device, IDStorageFactory* dstorage_factory, IDStorageQueue* dstorage_queue, load_telemetry& telemetry);
+    ~texture_loader();
+
+    texture_loader(const texture_loader&) = delete;
+    texture_loader& operator=(const texture_loader&) = delete;
+
+    // width and height are those of the file's mip 0
+    load_ticket enqueue(const std::wstring_view& path, uint32_t width, uint32_t height, uint32_t first_mip = 0, uint64_t telemetry_id = 0);
+    void submit();
+    void poll(std::vector<completion>& completions);
+    texture wait(load_ticket ticket);
+    void record_transitions(VkCommandBuffer command_buffer);
+
+    void release_texture(const texture& texture);
+
+    size_t in_flight() const;
+    uint64_t deduplicated_requests() const;
+    uint64_t bytes_loaded() const;
+
+private:
+    struct texture_key {
+        std::wstring path;
+        uint32_t first_mip;
+
+        bool operator==(const texture_key&) const = default;
+    };
+
+    struct texture_key_hash {
+        size_t operator()(const texture_key& key) const { return std::hash<std::wstring>()(key.path) * 31 + key.first_mip; }
+    };
+
+    struct shared_texture {
+        texture target;
+        uint32_t width;
+        uint32_t height;
+        uint32_t references;
+        bool loaded;
+        std::vector<load_ticket> waiting_tickets;
+    };
+
+    struct pending_load {
+        texture_key key;
+        uint64_t telemetry_id;
+        uint64_t fence_value;
+        uint32_t status_entry;
+        IDStorageFile* file;
+    };
+
+    // Status entries are reused once their load retires; the arrays can't grow, so more are added as needed
+    static constexpr uint32_t status_array_capacity = 256;
+
+    texture create_texture(const texture_layout& layout);
+    void submit_batch();
+    void retire_completed();
+    void finish_load(pending_load& load);
+    void fail_load(const texture_key& key, const std::exception_ptr& error);
+    uint32_t acquire_status_entry();
+    void destroy_texture(const texture& texture);
+
+    VkDevice _device;
+    ID3D12Device8* _d3d12_device;
+    IDStorageFactory* _dstorage_factory;
+    IDStorageQueue* _dstorage_queue;
+    load_telemetry& _telemetry;
+
+    mutable std::mutex _mutex;
+    // Signalled when a load becomes pending or fails before it could start
+    std::condition_variable _load_started;
+    ID3D12Fence* _fence = nullptr;
+    HANDLE _fence_event = nullptr;
+    uint64_t _fence_value = 0;
+    load_ticket _next_ticket = 1;
+    uint64_t _deduplicated_requests = 0;
+    uint64_t _bytes_loaded = 0;
+
+    std::vector<IDStorageStatusArray*> _status_arrays;
+    std::vector<uint32_t> _free_status_entries;
+
+    std::vector<pending_load> _pending;
+    std::vector<completion> _completed;
+    std::unordered_map<texture_key, shared_texture, texture_key_hash> _textures;
+    std::unordered_map<VkImage, texture_key> _keys_by_image;
+    std::vector<VkImage> _untransitioned_images;
+};
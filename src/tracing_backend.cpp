@@ -0,0 +1,90 @@
+#include "tracing_backend.hpp"
+
+tracing_backend::tracing_backend(storage_backend& backend, const std::filesystem::path& trace_path) : _backend(backend), _writer(trace_path) {
+}
+
+uint64_t tracing_backend::now() const {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - _start).count());
+}
+
+uint64_t tracing_backend::open_file(const std::filesystem::path& path) {
+    const auto file = _backend.open_file(path);
+
+    const auto utf8_path = std::filesystem::absolute(path).u8string();
+    _writer.write(io_trace_record {
+        .time_ns = now(),
+        .file = file,
+        .size = _backend.file_size(file),
+        .event = io_trace_event::open_file
+    }, std::string(utf8_path.begin(), utf8_path.end()));
+
+    return file;
+}
+
+void tracing_backend::close_file(uint64_t file) {
+    _writer.write(io_trace_record {
+        .time_ns = now(),
+        .file = file,
+        .event = io_trace_event::close_file
+    });
+
+    _backend.close_file(file);
+}
+
+void tracing_backend::enqueue(const read_request& request) {
+    const auto request_id = _next_request_id++;
+    _user_data.emplace(request_id, request.user_data);
+
+    _writer.write(io_trace_record {
+        .time_ns = now(),
+        .file = request.file,
+        .offset = request.offset,
+        .size = request.size,
+        .request_id = request_id,
+        .event = io_trace_event::enqueue,
+        .priority = request.priority,
+        .destination_kind = request.destination_kind
+    });
+
+    auto traced_request = request;
+    traced_request.user_data = request_id;
+    _backend.enqueue(traced_request);
+}
+
+void tracing_backend::submit() {
+    _writer.write(io_trace_record {
+        .time_ns = now(),
+        .event = io_trace_event::submit
+    });
+
+    _backend.submit();
+}
+
+void tracing_backend::poll(std::vector<read_completion>& completions) {
+    _backend_completions.clear();
+    _backend.poll(_backend_completions);
+
+    if(_backend_completions.empty()) {
+        return;
+    }
+
+    const auto time_ns = now();
+    for(const auto& backend_completion : _backend_completions) {
+        auto user_data = _user_data.extract(backend_completion.user_data);
+
+        _writer.write(io_trace_record {
+            .time_ns = time_ns,
+            .request_id = backend_completion.user_data,
+            .event = io_trace_event::complete,
+            .success = backend_completion.success
+        });
+
+        completions.push_back(read_completion {
+            .user_data = user_data.mapped(),
+            .success = backend_completion.success
+        });
+    }
+
+    // Flushed once per batch of completions so a killed process loses little of its trace
+    _writer.flush();
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "io_trace.hpp"
+#include "storage_backend.hpp"
+#include <chrono>
+#include <unordered_map>
+
+// Sits in front of another backend and writes every call that crosses it to an I/O trace: files
+// opened and closed, requests with their range, priority and destination kind, submits, and
+// completions. Timestamps count from construction. The trace can be replayed against any backend with
+// dsvk_trace_replay.
+class tracing_backend final : public storage_backend {
+public:
+    tracing_backend(storage_backend& backend, const std::filesystem::path& trace_path);
+
+    uint64_t open_file(const std::filesystem::path& path) override;
+    uint64_t file_size(uint64_t file) const override { return _backend.file_size(file); }
+    void close_file(uint64_t file) override;
+
+    void enqueue(const read_request& request) override;
+    void submit() override;
+    void poll(std::vector<read_completion>& completions) override;
+    void wait() override { _backend.wait(); }
+
+    size_t in_flight() const override { return _backend.in_flight(); }
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    uint64_t now() const;
+
+    storage_backend& _backend;
+    io_trace_writer _writer;
+    clock::time_point _start = clock::now();
+
+    // Keyed by the trace request id, which doubles as the user data given to the inner backend
+    std::unordered_map<uint64_t, uint64_t> _user_data;
+    uint64_t _next_request_id = 1;
+    std::vector<read_completion> _backend_completions;
+};
@@ -0,0 +1,193 @@
+#include "verifying_backend.hpp"
+#include "xxh3.hpp"
+#include <algorithm>
+#include <optional>
+
+verifying_backend::verifying_backend(storage_backend& backend, const verification_desc& desc, job_system* jobs)
+    : _backend(backend), _desc(desc), _jobs(jobs) {
+}
+
+verifying_backend::~verifying_backend() {
+    // The jobs point into the verifications
+    for(const auto& verification : _verifications) {
+        if(verification->job) {
+            _jobs->wait(verification->job);
+        }
+    }
+}
+
+uint64_t verifying_backend::open_file(const std::filesystem::path& path) {
+    const auto file = _backend.open_file(path);
+
+    // Checksums that can't be read, or that were computed before the file last changed size, would fail
+    // every read, so the file is served unverified instead
+    std::optional<chunk_checksums> checksums;
+    try {
+        checksums = read_chunk_checksums(chunk_checksum_path(path));
+    } catch(const std::exception&) {
+        _stats.corrupt_checksum_files++;
+        return file;
+    }
+
+    if(checksums && checksums->file_size == _backend.file_size(file)) {
+        _checksums.emplace(file, std::move(*checksums));
+        _stats.verified_files++;
+    } else {
+        _stats.unverified_files++;
+    }
+
+    return file;
+}
+
+void verifying_backend::close_file(uint64_t file) {
+    _checksums.erase(file);
+    _backend.close_file(file);
+}
+
+void verifying_backend::enqueue(const read_request& request) {
+    const auto read_id = _next_read_id++;
+    const auto& read = _reads.emplace(read_id, tracked_read { .request = request, .retries = 0 }).first->second;
+
+    auto backend_request = read.request;
+    backend_request.user_data = read_id;
+    _backend.enqueue(backend_request);
+}
+
+void verifying_backend::wait() {
+    // A hash running on the job system finishes sooner than a read, and this thread helps with it
+    if(!_verifications.empty()) {
+        _jobs->wait(_verifications.front()->job);
+        return;
+    }
+
+    _backend.wait();
+}
+
+void verifying_backend::hash_chunks(verification& verification) {
+    const auto start = std::chrono::steady_clock::now();
+    for(auto& check : verification.checks) {
+        check.matches = xxh3_64(check.data, check.size) == check.expected_hash;
+    }
+    verification.hash_time = std::chrono::steady_clock::now() - start;
+}
+
+void verifying_backend::start_verification(uint64_t read_id, const read_request& request, const chunk_checksums& checksums) {
+    auto started = std::make_unique<verification>();
+    started->read_id = read_id;
+
+    const auto request_end = request.offset + request.size;
+    const auto* data = static_cast<const uint8_t*>(request.destination);
+    uint64_t bytes = 0;
+
+    // Only chunks the read covers completely can be checked; the last chunk ends with the file
+    for(auto chunk = (request.offset + checksums.chunk_size - 1) / checksums.chunk_size; chunk < checksums.hashes.size(); chunk++) {
+        const auto chunk_offset = chunk * checksums.chunk_size;
+        const auto chunk_end = std::min(chunk_offset + checksums.chunk_size, checksums.file_size);
+        if(chunk_end > request_end) {
+            break;
+        }
+
+        started->checks.push_back(chunk_check {
+            .data = data + (chunk_offset - request.offset),
+            .size = chunk_end - chunk_offset,
+            .expected_hash = checksums.hashes[chunk],
+            .matches = false
+        });
+        bytes += chunk_end - chunk_offset;
+    }
+
+    if(_jobs && bytes >= _desc.min_job_bytes) {
+        started->job = _jobs->schedule([verification = started.get()] { hash_chunks(*verification); });
+    } else {
+        hash_chunks(*started);
+    }
+
+    _verifications.push_back(std::move(started));
+}
+
+bool verifying_backend::finish_verification(const verification& verification, std::vector<read_completion>& completions) {
+    const auto it = _reads.find(verification.read_id);
+    auto& read = it->second;
+
+    _stats.hash_time += verification.hash_time;
+
+    uint64_t mismatches = 0;
+    uint64_t verified_bytes = 0;
+    for(const auto& check : verification.checks) {
+        mismatches += check.matches ? 0 : 1;
+        verified_bytes += check.size;
+    }
+
+    if(mismatches > 0) {
+        _stats.mismatched_chunks += mismatches;
+
+        if(read.retries < _desc.max_retries) {
+            read.retries++;
+            _stats.retries++;
+
+            auto backend_request = read.request;
+            backend_request.user_data = verification.read_id;
+            _backend.enqueue(backend_request);
+            return true;
+        }
+
+        _stats.failed_requests++;
+    } else {
+        _stats.verified_chunks += verification.checks.size();
+        _stats.verified_bytes += verified_bytes;
+        _stats.unverified_bytes += read.request.size - verified_bytes;
+    }
+
+    completions.push_back(read_completion {
+        .user_data = read.request.user_data,
+        .success = mismatches == 0
+    });
+    _reads.erase(it);
+    return false;
+}
+
+void verifying_backend::poll(std::vector<read_completion>& completions) {
+    _backend_completions.clear();
+    _backend.poll(_backend_completions);
+
+    for(const auto& backend_completion : _backend_completions) {
+        const auto it = _reads.find(backend_completion.user_data);
+        if(it == _reads.end()) {
+            continue;
+        }
+
+        const auto& request = it->second.request;
+        const auto checksums = _checksums.find(request.file);
+        if(backend_completion.success && checksums != _checksums.end()) {
+            start_verification(it->first, request, checksums->second);
+            continue;
+        }
+
+        if(backend_completion.success) {
+            _stats.unverified_bytes += request.size;
+        }
+
+        completions.push_back(read_completion {
+            .user_data = request.user_data,
+            .success = backend_completion.success
+        });
+        _reads.erase(it);
+    }
+
+    auto reissued = false;
+    for(auto it = _verifications.begin(); it != _verifications.end();) {
+        const auto& verification = **it;
+        if(verification.job && !verification.job->finished.load(std::memory_order_acquire)) {
+            ++it;
+            continue;
+        }
+
+        reissued |= finish_verification(verification, completions);
+        it = _verifications.erase(it);
+    }
+
+    // Retries go out with this poll instead of waiting for the caller's next submit
+    if(reissued) {
+        _backend.submit();
+    }
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "chunk_checksums.hpp"
+#include "job_system.hpp"
+#include "storage_backend.hpp"
+#include <chrono>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+struct verification_desc {
+    // Times a read with a mismatching chunk is issued again before it completes as failed
+    uint32_t max_retries = 2;
+    // Reads with fewer bytes to hash are hashed on the polling thread, where a job would cost more than it saves
+    uint64_t min_job_bytes = 256 * 1024;
+};
+
+struct verification_stats {
+    uint64_t verified_files;
+    // Opened without checksums, or with checksums for a different size of the file
+    uint64_t unverified_files;
+    // Opened with a checksum file that can't be read as one; also served unverified
+    uint64_t corrupt_checksum_files;
+    uint64_t verified_chunks;
+    uint64_t verified_bytes;
+    // Delivered bytes no whole chunk check covered: reads of unverified files and partial chunks at read edges
+    uint64_t unverified_bytes;
+    uint64_t mismatched_chunks;
+    uint64_t retries;
+    uint64_t failed_requests;
+    // Summed over the threads that hashed
+    std::chrono::nanoseconds hash_time;
+};
+
+// Sits in front of another backend and checks delivered payloads against the chunk checksums stored
+// next to each file (see chunk_checksums.hpp). Every chunk a completed read covers completely is hashed
+// with XXH3. Given a job system, reads are hashed there while the polling thread goes on submitting and
+// harvesting I/O, and complete on a later poll(); without one they are hashed inside poll(). A read with a
+// mismatching chunk is issued again, since transient corruption on the way from the device goes away on
+// a second read, and fails once max_retries is used up. Files without checksums pass through unverified;
+// so do files whose checksum file is corrupt, which are counted apart.
+class verifying_backend final : public storage_backend {
+public:
+    verifying_backend(storage_backend& backend, const verification_desc& desc, job_system* jobs = nullptr);
+    ~verifying_backend();
+
+    verifying_backend(const verifying_backend&) = delete;
+    verifying_backend& operator=(const verifying_backend&) = delete;
+
+    uint64_t open_file(const std::filesystem::path& path) override;
+    uint64_t file_size(uint64_t file) const override { return _backend.file_size(file); }
+    void close_file(uint64_t file) override;
+
+    void enqueue(const read_request& request) override;
+    void submit() override { _backend.submit(); }
+    void poll(std::vector<read_completion>& completions) override;
+    void wait() override;
+
+    size_t in_flight() const override { return _reads.size(); }
+
+    const verification_stats& stats() const { return _stats; }
+
+private:
+    struct tracked_read {
+        read_request request;
+        uint32_t retries;
+    };
+
+    struct chunk_check {
+        const uint8_t* data;
+        uint64_t size;
+        uint64_t expected_hash;
+        bool matches;
+    };
+
+    // A completed read whose chunks are being hashed
+    struct verification {
+        uint64_t read_id;
+        std::vector<chunk_check> checks;
+        std::chrono::nanoseconds hash_time;
+        job_handle job;
+    };
+
+    static void hash_chunks(verification& verification);
+
+    void start_verification(uint64_t read_id, const read_request& request, const chunk_checksums& checksums);
+    bool finish_verification(const verification& verification, std::vector<read_completion>& completions);
+
+    storage_backend& _backend;
+    verification_desc _desc;
+    job_system* _jobs;
+
+    std::unordered_map<uint64_t, chunk_checksums> _checksums;
+    std::unordered_map<uint64_t, tracked_read> _reads;
+    uint64_t _next_read_id = 1;
+
+    std::vector<std::unique_ptr<verification>> _verifications;
+    std::vector<read_completion> _backend_completions;
+
+    verification_stats _stats = {};
+};
@@ -0,0 +1,65 @@
+#include "vulkan_utils.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <format>
+#include <stdexcept>
+#include <string>
+
+void throw_if_failed(VkResult result, const std::string_view& message) {
+    if(result != VK_SUCCESS) {
+        throw std::runtime_error(std::format("{} failed: {}", message, static_cast<int>(result)));
+    }
+}
+
+std::vector<int8_t> read_binary_file(const std::string_view& path) {
+    // std::filesystem sizes are 64-bit everywhere, unlike the long ftell returns on Windows
+    std::error_code error;
+    const auto length = std::filesystem::file_size(std::filesystem::path(path), error);
+    if(error) {
+        throw std::runtime_error(std::format("Failed to get the size of {}: {}", path, error.message()));
+    }
+    if(length == 0) {
+        throw std::runtime_error(std::format("{} is empty", path));
+    }
+
+    auto* file = fopen(std::string(path).c_str(), "rb");
+    if(!file) {
+        throw std::runtime_error(std::format("Failed to open {}", path));
+    }
+
+    std::vector<int8_t> buffer(length);
+
+    // fread takes a size_t but some C runtimes still fail single reads past 2 GiB
+    constexpr size_t max_chunk = 1u << 30;
+    size_t length_read = 0;
+    while(length_read < buffer.size()) {
+        const auto chunk = std::min(buffer.size() - length_read, max_chunk);
+        const auto chunk_read = fread(buffer.data() + length_read, 1, chunk, file);
+        length_read += chunk_read;
+        if(chunk_read != chunk) {
+            break;
+        }
+    }
+
+    fclose(file);
+
+    if(length_read != buffer.size()) {
+        throw std::runtime_error(std::format("Failed to read {}: got {} of {} bytes", path, length_read, buffer.size()));
+    }
+
+    return buffer;
+}
+
+uint32_t find_memory_type(VkPhysicalDevice physical_device, uint32_t memory_type_bits, VkMemoryPropertyFlags properties) {
+    VkPhysicalDeviceMemoryProperties physical_device_memory_properties;
+    vkGetPhysicalDeviceMemoryProperties(physical_device, &physical_device_memory_properties);
+
+    for (auto i = 0; i < physical_device_memory_properties.memoryTypeCount; i++) {
+        if ((memory_type_bits & (1 << i)) && (physical_device_memory_properties.memoryTypes[i].propertyFlags & properties) == properties) {
+            return i;
+        }
+    }
+
+    throw std::runtime_error("Invalid memory type!");
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#ifdef _WIN32
+#define VK_USE_PLATFORM_WIN32_KHR
+#endif
+#include <volk/volk.h>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+void throw_if_failed(VkResult result, const std::string_view& message);
+
+std::vector<int8_t> read_binary_file(const std::string_view& path);
+
+uint32_t find_memory_type(VkPhysicalDevice physical_device, uint32_t memory_type_bits, VkMemoryPropertyFlags properties);
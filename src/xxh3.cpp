@@ -0,0 +1,327 @@
+#include "xxh3.hpp"
+#include <bit>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define XXH3_X86_64
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// GCC and Clang only emit AVX2 in functions that ask for it; MSVC emits any intrinsic anywhere
+#if defined(XXH3_X86_64) && (defined(__GNUC__) || defined(__clang__))
+#define XXH3_AVX2_FUNCTION [[gnu::target("avx2"), gnu::flatten]]
+#else
+#define XXH3_AVX2_FUNCTION
+#endif
+
+namespace {
+    constexpr uint32_t prime32_1 = 0x9E3779B1u;
+    constexpr uint32_t prime32_2 = 0x85EBCA77u;
+    constexpr uint32_t prime32_3 = 0xC2B2AE3Du;
+    constexpr uint64_t prime64_1 = 0x9E3779B185EBCA87ull;
+    constexpr uint64_t prime64_2 = 0xC2B2AE3D27D4EB4Full;
+    constexpr uint64_t prime64_3 = 0x165667B19E3779F9ull;
+    constexpr uint64_t prime64_4 = 0x85EBCA77C2B2AE63ull;
+    constexpr uint64_t prime64_5 = 0x27D4EB2F165667C5ull;
+    constexpr uint64_t prime_mx1 = 0x165667919E3779F9ull;
+    constexpr uint64_t prime_mx2 = 0x9FB21C651E98DF25ull;
+
+    constexpr size_t secret_size = 192;
+    constexpr size_t stripe_size = 64;
+    constexpr size_t stripes_per_block = (secret_size - stripe_size) / 8;
+    constexpr size_t block_size = stripe_size * stripes_per_block;
+
+    alignas(64) constexpr uint8_t secret[secret_size] = {
+        0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+        0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+        0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+        0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+        0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+        0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+        0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+        0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+        0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+        0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+        0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+        0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e
+    };
+
+    // Every platform this builds for is little endian, which is the byte order xxHash reads in
+    uint32_t read32(const uint8_t* data) {
+        uint32_t value;
+        memcpy(&value, data, sizeof(value));
+        return value;
+    }
+
+    uint64_t read64(const uint8_t* data) {
+        uint64_t value;
+        memcpy(&value, data, sizeof(value));
+        return value;
+    }
+
+    uint64_t mul128_fold64(uint64_t a, uint64_t b) {
+#if defined(__SIZEOF_INT128__)
+        const auto product = static_cast<unsigned __int128>(a) * b;
+        return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+#elif defined(_M_X64)
+        uint64_t high = 0;
+        const auto low = _umul128(a, b, &high);
+        return low ^ high;
+#else
+        const auto lo_lo = (a & 0xFFFFFFFF) * (b & 0xFFFFFFFF);
+        const auto hi_lo = (a >> 32) * (b & 0xFFFFFFFF);
+        const auto lo_hi = (a & 0xFFFFFFFF) * (b >> 32);
+        const auto hi_hi = (a >> 32) * (b >> 32);
+        const auto cross = (lo_lo >> 32) + (hi_lo & 0xFFFFFFFF) + lo_hi;
+        const auto high = (hi_lo >> 32) + (cross >> 32) + hi_hi;
+        const auto low = (cross << 32) | (lo_lo & 0xFFFFFFFF);
+        return low ^ high;
+#endif
+    }
+
+    uint64_t xorshift64(uint64_t value, int shift) {
+        return value ^ (value >> shift);
+    }
+
+    uint64_t xxh64_avalanche(uint64_t hash) {
+        hash ^= hash >> 33;
+        hash *= prime64_2;
+        hash ^= hash >> 29;
+        hash *= prime64_3;
+        hash ^= hash >> 32;
+        return hash;
+    }
+
+    uint64_t avalanche(uint64_t hash) {
+        hash = xorshift64(hash, 37);
+        hash *= prime_mx1;
+        return xorshift64(hash, 32);
+    }
+
+    uint64_t rrmxmx(uint64_t hash, uint64_t size) {
+        hash ^= std::rotl(hash, 49) ^ std::rotl(hash, 24);
+        hash *= prime_mx2;
+        hash ^= (hash >> 35) + size;
+        hash *= prime_mx2;
+        return xorshift64(hash, 28);
+    }
+
+    uint64_t mix16(const uint8_t* input, const uint8_t* key) {
+        return mul128_fold64(read64(input) ^ read64(key), read64(input + 8) ^ read64(key + 8));
+    }
+
+    uint64_t hash_0_to_16(const uint8_t* input, size_t size) {
+        if(size > 8) {
+            const auto low = read64(input) ^ (read64(secret + 24) ^ read64(secret + 32));
+            const auto high = read64(input + size - 8) ^ (read64(secret + 40) ^ read64(secret + 48));
+            return avalanche(size + std::byteswap(low) + high + mul128_fold64(low, high));
+        }
+        if(size >= 4) {
+            const uint64_t combined = read32(input + size - 4) + (static_cast<uint64_t>(read32(input)) << 32);
+            return rrmxmx(combined ^ (read64(secret + 8) ^ read64(secret + 16)), size);
+        }
+        if(size > 0) {
+            const auto combined = (static_cast<uint32_t>(input[0]) << 16) | (static_cast<uint32_t>(input[size >> 1]) << 24) |
+                                  static_cast<uint32_t>(input[size - 1]) | (static_cast<uint32_t>(size) << 8);
+            return xxh64_avalanche(combined ^ static_cast<uint64_t>(read32(secret) ^ read32(secret + 4)));
+        }
+        return xxh64_avalanche(read64(secret + 56) ^ read64(secret + 64));
+    }
+
+    uint64_t hash_17_to_128(const uint8_t* input, size_t size) {
+        auto acc = size * prime64_1;
+        if(size > 32) {
+            if(size > 64) {
+                if(size > 96) {
+                    acc += mix16(input + 48, secret + 96);
+                    acc += mix16(input + size - 64, secret + 112);
+                }
+                acc += mix16(input + 32, secret + 64);
+                acc += mix16(input + size - 48, secret + 80);
+            }
+            acc += mix16(input + 16, secret + 32);
+            acc += mix16(input + size - 32, secret + 48);
+        }
+        acc += mix16(input, secret);
+        acc += mix16(input + size - 16, secret + 16);
+        return avalanche(acc);
+    }
+
+    uint64_t hash_129_to_240(const uint8_t* input, size_t size) {
+        auto acc = size * prime64_1;
+        for(size_t i = 0; i < 8; i++) {
+            acc += mix16(input + 16 * i, secret + 16 * i);
+        }
+        acc = avalanche(acc);
+
+        // The rest of the input reuses the secret from byte 3, and the last 16 bytes take bytes 119 to 135
+        for(size_t i = 8; i < size / 16; i++) {
+            acc += mix16(input + 16 * i, secret + 16 * (i - 8) + 3);
+        }
+        acc += mix16(input + size - 16, secret + 119);
+        return avalanche(acc);
+    }
+
+    // Each kernel folds one 64 byte stripe into the eight accumulators, and scrambles them after every
+    // block of 16 stripes
+    struct scalar_kernel {
+        static void accumulate(uint64_t* acc, const uint8_t* input, const uint8_t* key) {
+            for(size_t i = 0; i < 8; i++) {
+                const auto data = read64(input + 8 * i);
+                const auto keyed = data ^ read64(key + 8 * i);
+                acc[i ^ 1] += data;
+                acc[i] += (keyed & 0xFFFFFFFF) * (keyed >> 32);
+            }
+        }
+
+        static void scramble(uint64_t* acc, const uint8_t* key) {
+            for(size_t i = 0; i < 8; i++) {
+                acc[i] = (xorshift64(acc[i], 47) ^ read64(key + 8 * i)) * prime32_1;
+            }
+        }
+    };
+
+#ifdef XXH3_X86_64
+    struct sse2_kernel {
+        static void accumulate(uint64_t* acc, const uint8_t* input, const uint8_t* key) {
+            auto* vectors = reinterpret_cast<__m128i*>(acc);
+            for(size_t i = 0; i < 4; i++) {
+                const auto data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input) + i);
+                const auto keyed = _mm_xor_si128(data, _mm_loadu_si128(reinterpret_cast<const __m128i*>(key) + i));
+                const auto product = _mm_mul_epu32(keyed, _mm_shuffle_epi32(keyed, _MM_SHUFFLE(0, 3, 0, 1)));
+                const auto swapped = _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+                vectors[i] = _mm_add_epi64(product, _mm_add_epi64(vectors[i], swapped));
+            }
+        }
+
+        static void scramble(uint64_t* acc, const uint8_t* key) {
+            auto* vectors = reinterpret_cast<__m128i*>(acc);
+            const auto prime = _mm_set1_epi32(static_cast<int>(prime32_1));
+            for(size_t i = 0; i < 4; i++) {
+                const auto shifted = _mm_xor_si128(vectors[i], _mm_srli_epi64(vectors[i], 47));
+                const auto keyed = _mm_xor_si128(shifted, _mm_loadu_si128(reinterpret_cast<const __m128i*>(key) + i));
+                const auto low = _mm_mul_epu32(keyed, prime);
+                const auto high = _mm_mul_epu32(_mm_shuffle_epi32(keyed, _MM_SHUFFLE(0, 3, 0, 1)), prime);
+                vectors[i] = _mm_add_epi64(low, _mm_slli_epi64(high, 32));
+            }
+        }
+    };
+
+    struct avx2_kernel {
+        XXH3_AVX2_FUNCTION static void accumulate(uint64_t* acc, const uint8_t* input, const uint8_t* key) {
+            auto* vectors = reinterpret_cast<__m256i*>(acc);
+            for(size_t i = 0; i < 2; i++) {
+                const auto data = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(input) + i);
+                const auto keyed = _mm256_xor_si256(data, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(key) + i));
+                const auto product = _mm256_mul_epu32(keyed, _mm256_srli_epi64(keyed, 32));
+                const auto swapped = _mm256_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+                vectors[i] = _mm256_add_epi64(product, _mm256_add_epi64(vectors[i], swapped));
+            }
+        }
+
+        XXH3_AVX2_FUNCTION static void scramble(uint64_t* acc, const uint8_t* key) {
+            auto* vectors = reinterpret_cast<__m256i*>(acc);
+            const auto prime = _mm256_set1_epi32(static_cast<int>(prime32_1));
+            for(size_t i = 0; i < 2; i++) {
+                const auto shifted = _mm256_xor_si256(vectors[i], _mm256_srli_epi64(vectors[i], 47));
+                const auto keyed = _mm256_xor_si256(shifted, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(key) + i));
+                const auto low = _mm256_mul_epu32(keyed, prime);
+                const auto high = _mm256_mul_epu32(_mm256_srli_epi64(keyed, 32), prime);
+                vectors[i] = _mm256_add_epi64(low, _mm256_slli_epi64(high, 32));
+            }
+        }
+    };
+#endif
+
+    template<typename kernel>
+    void accumulate_long(uint64_t* acc, const uint8_t* input, size_t size) {
+        const auto blocks = (size - 1) / block_size;
+        for(size_t block = 0; block < blocks; block++) {
+            for(size_t stripe = 0; stripe < stripes_per_block; stripe++) {
+                kernel::accumulate(acc, input + block * block_size + stripe * stripe_size, secret + stripe * 8);
+            }
+            kernel::scramble(acc, secret + secret_size - stripe_size);
+        }
+
+        const auto stripes = (size - 1 - blocks * block_size) / stripe_size;
+        for(size_t stripe = 0; stripe < stripes; stripe++) {
+            kernel::accumulate(acc, input + blocks * block_size + stripe * stripe_size, secret + stripe * 8);
+        }
+
+        // The last stripe always ends at the end of the input, overlapping the one before it
+        kernel::accumulate(acc, input + size - stripe_size, secret + secret_size - stripe_size - 7);
+    }
+
+    using long_accumulator = void (*)(uint64_t* acc, const uint8_t* input, size_t size);
+
+    struct implementation {
+        long_accumulator accumulate;
+        const char* name;
+    };
+
+#ifdef XXH3_X86_64
+    // Wrapped so the whole loop is compiled for AVX2 with the kernel inlined into it
+    XXH3_AVX2_FUNCTION void accumulate_long_avx2(uint64_t* acc, const uint8_t* input, size_t size) {
+        accumulate_long<avx2_kernel>(acc, input, size);
+    }
+
+    bool cpu_has_avx2() {
+#if defined(__GNUC__) || defined(__clang__)
+        return __builtin_cpu_supports("avx2");
+#else
+        int info[4] = {};
+        __cpuid(info, 1);
+        const auto os_saves_ymm = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6;
+        __cpuidex(info, 7, 0);
+        return os_saves_ymm && (info[1] & (1 << 5)) != 0;
+#endif
+    }
+#endif
+
+    const implementation& selected_implementation() {
+        static const implementation selected = [] {
+#ifdef XXH3_X86_64
+            if(cpu_has_avx2()) {
+                return implementation { .accumulate = accumulate_long_avx2, .name = "AVX2" };
+            }
+            return implementation { .accumulate = accumulate_long<sse2_kernel>, .name = "SSE2" };
+#else
+            return implementation { .accumulate = accumulate_long<scalar_kernel>, .name = "scalar" };
+#endif
+        }();
+        return selected;
+    }
+
+    uint64_t hash_long(const uint8_t* input, size_t size) {
+        alignas(64) uint64_t acc[8] = { prime32_3, prime64_1, prime64_2, prime64_3, prime64_4, prime32_2, prime64_5, prime32_1 };
+        selected_implementation().accumulate(acc, input, size);
+
+        auto hash = size * prime64_1;
+        for(size_t i = 0; i < 4; i++) {
+            hash += mul128_fold64(acc[2 * i] ^ read64(secret + 11 + 16 * i), acc[2 * i + 1] ^ read64(secret + 19 + 16 * i));
+        }
+        return avalanche(hash);
+    }
+}
+
+uint64_t xxh3_64(const void* data, size_t size) {
+    const auto* input = static_cast<const uint8_t*>(data);
+
+    if(size <= 16) {
+        return hash_0_to_16(input, size);
+    }
+    if(size <= 128) {
+        return hash_17_to_128(input, size);
+    }
+    if(size <= 240) {
+        return hash_129_to_240(input, size);
+    }
+    return hash_long(input, size);
+}
+
+const char* xxh3_implementation() {
+    return selected_implementation().name;
+}
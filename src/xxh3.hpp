@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// XXH3 64-bit hash with seed 0 and the default secret, bit for bit the XXH3_64bits() of the reference
+// xxHash. Inputs over 240 bytes go through a vectorized accumulate loop: AVX2 where the CPU has it
+// (picked at run time), SSE2 on other x86-64 CPUs and plain 64-bit arithmetic elsewhere.
+uint64_t xxh3_64(const void* data, size_t size);
+
+// "AVX2", "SSE2" or "scalar": the accumulate loop xxh3_64() uses on this CPU
+const char* xxh3_implementation();
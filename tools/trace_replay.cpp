@@ -0,0 +1,478 @@
+#include "autotuning_backend.hpp"
+#include "caching_backend.hpp"
+#include "coalescing_backend.hpp"
+#include "cpu_topology.hpp"
+#include "emulated_backend.hpp"
+#include "host_memory.hpp"
+#include "io_trace.hpp"
+#include "job_system.hpp"
+#include "load_telemetry.hpp"
+#include "verifying_backend.hpp"
+#include "xxh3.hpp"
+
+#ifdef _WIN32
+#include "dstorage_backend.hpp"
+#else
+#include "storage_selection.hpp"
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <format>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+    using clock = std::chrono::steady_clock;
+
+    struct replay_options {
+        std::filesystem::path trace_path;
+        bool timed = false;
+        bool coalesce = false;
+        std::optional<caching_desc> cache_desc;
+        std::optional<emulated_storage_desc> emulated_desc;
+        bool emulate_from_ram = false;
+        bool autotune = false;
+        autotuning_desc autotune_desc;
+        huge_page_mode huge_pages = huge_page_mode::automatic;
+        thread_placement_desc placement;
+        std::optional<verification_desc> verify_desc;
+#ifndef _WIN32
+        storage_selection_desc storage_desc;
+#endif
+    };
+
+    struct replayed_request {
+        std::unique_ptr<uint8_t[]> buffer;
+        uint64_t trace_file;
+        uint64_t size;
+        clock::time_point enqueue_time;
+    };
+
+    struct replay_stats {
+        uint64_t requests;
+        uint64_t failed_requests;
+        uint64_t skipped_requests;
+        uint64_t bytes;
+        latency_histogram latency;
+        latency_histogram original_latency;
+    };
+
+    replay_options parse_options(int argc, char** args) {
+        replay_options options;
+
+        for(auto i = 1; i < argc; i++) {
+            const std::string_view arg = args[i];
+            if(arg == "--timed") {
+                options.timed = true;
+            } else if(arg == "--coalesce") {
+                options.coalesce = true;
+            } else if(arg == "--cache-ram" && i + 1 < argc) {
+                if(!options.cache_desc) {
+                    options.cache_desc.emplace();
+                }
+                options.cache_desc->ram_capacity = std::stoull(args[++i]);
+            } else if(arg == "--emulate" && i + 1 < argc) {
+                options.emulated_desc = emulated_storage_preset(args[++i]);
+            } else if(arg == "--emulate-ram") {
+                options.emulate_from_ram = true;
+            } else if(arg == "--autotune") {
+                options.autotune = true;
+            } else if(arg == "--autotune-latency" && i + 1 < argc) {
+                options.autotune = true;
+                options.autotune_desc.latency_limit = std::chrono::milliseconds(std::stoul(args[++i]));
+            } else if(arg == "--huge-pages" && i + 1 < argc) {
+                options.huge_pages = parse_huge_page_mode(args[++i]);
+            } else if(arg == "--pin-threads") {
+                options.placement.pin = true;
+            } else if(arg == "--io-node" && i + 1 < argc) {
+                options.placement.pin = true;
+                options.placement.io_node = std::stoi(args[++i]);
+            } else if(arg == "--decode-node" && i + 1 < argc) {
+                options.placement.pin = true;
+                options.placement.decode_node = std::stoi(args[++i]);
+            } else if(arg == "--submit-node" && i + 1 < argc) {
+                options.placement.pin = true;
+                options.placement.submission_node = std::stoi(args[++i]);
+            } else if(arg == "--verify") {
+                if(!options.verify_desc) {
+                    options.verify_desc.emplace();
+                }
+            } else if(arg == "--verify-retries" && i + 1 < argc) {
+                if(!options.verify_desc) {
+                    options.verify_desc.emplace();
+                }
+                options.verify_desc->max_retries = static_cast<uint32_t>(std::stoul(args[++i]));
+#ifndef _WIN32
+            } else if(arg == "--backend" && i + 1 < argc) {
+                options.storage_desc.kind = parse_storage_backend_kind(args[++i]);
+            } else if(arg == "--direct-io") {
+                options.storage_desc.uring.direct_io = true;
+            } else if(arg == "--sq-poll") {
+                options.storage_desc.uring.sq_poll = true;
+            } else if(arg == "--sq-poll-idle" && i + 1 < argc) {
+                options.storage_desc.uring.sq_poll_idle_ms = static_cast<uint32_t>(std::stoul(args[++i]));
+            } else if(arg == "--wait-batch" && i + 1 < argc) {
+                options.storage_desc.uring.wait_batch = static_cast<uint32_t>(std::stoul(args[++i]));
+            } else if(arg == "--io-threads" && i + 1 < argc) {
+                options.storage_desc.pread.thread_count = static_cast<uint32_t>(std::stoul(args[++i]));
+#endif
+            } else if(options.trace_path.empty() && !arg.starts_with("--")) {
+                options.trace_path = arg;
+            } else {
+                throw std::runtime_error(std::format("Unknown argument: {}", arg));
+            }
+        }
+
+        if(options.emulated_desc) {
+            options.emulated_desc->ram_source = options.emulate_from_ram;
+            options.emulated_desc->huge_pages = options.huge_pages;
+        }
+        if(options.cache_desc) {
+            options.cache_desc->huge_pages = options.huge_pages;
+        }
+        validate_thread_placement(options.placement);
+
+#ifndef _WIN32
+        options.storage_desc.uring.huge_pages = options.huge_pages;
+        options.storage_desc.pread.placement = options.placement;
+#endif
+
+        // The replaying thread submits and harvests, so it and the memory it copies through share a node
+        if(options.placement.pin) {
+            const auto node = static_cast<int32_t>(placement_node(options.placement, thread_role::submission, 0));
+            if(options.cache_desc) {
+                options.cache_desc->numa_node = node;
+            }
+#ifndef _WIN32
+            options.storage_desc.uring.numa_node = node;
+#endif
+        }
+
+        if(options.trace_path.empty()) {
+            throw std::runtime_error("Usage: dsvk_trace_replay <trace> [--timed] [--coalesce] [--cache-ram <bytes>] [--emulate nvme|sata|hdd [--emulate-ram]] [--autotune] [--autotune-latency <ms>] [--huge-pages auto|transparent|off] [--pin-threads] [--io-node <node>] [--decode-node <node>] [--submit-node <node>] [--verify] [--verify-retries <count>] [--backend auto|io_uring|pread] [--direct-io] [--sq-poll] [--sq-poll-idle <ms>] [--wait-batch <count>] [--io-threads <count>]");
+        }
+
+        return options;
+    }
+
+    // Replays trace records in order against a backend. Files are opened under the paths they had
+    // while tracing, so the replay has to run where those files exist.
+    class trace_replayer {
+    public:
+        trace_replayer(storage_backend& backend, const io_trace& trace, bool timed) : _backend(backend), _trace(trace), _timed(timed) {
+        }
+
+        void run() {
+            std::unordered_map<uint64_t, uint64_t> original_enqueue_times;
+
+            _start = clock::now();
+
+            for(size_t i = 0; i < _trace.records.size(); i++) {
+                const auto& record = _trace.records[i];
+
+                if(_timed) {
+                    wait_until(_start + std::chrono::nanoseconds(record.time_ns));
+                }
+
+                switch(record.event) {
+                    case io_trace_event::open_file: {
+                        const auto& path = _trace.paths[i];
+                        _files[record.file] = _backend.open_file(std::filesystem::path(std::u8string(path.begin(), path.end())));
+                        break;
+                    }
+                    case io_trace_event::close_file:
+                        close_when_idle(record.file);
+                        break;
+                    case io_trace_event::enqueue:
+                        original_enqueue_times[record.request_id] = record.time_ns;
+                        enqueue(record);
+                        break;
+                    case io_trace_event::submit:
+                        _backend.submit();
+                        break;
+                    case io_trace_event::complete: {
+                        const auto it = original_enqueue_times.find(record.request_id);
+                        if(it != original_enqueue_times.end()) {
+                            _stats.original_latency.record(record.time_ns - it->second);
+                            original_enqueue_times.erase(it);
+                        }
+                        break;
+                    }
+                }
+
+                drain();
+            }
+
+            // Requests the traced process queued without submitting are submitted here
+            _backend.submit();
+            while(_backend.in_flight() > 0) {
+                _backend.wait();
+                drain();
+            }
+
+            _elapsed = clock::now() - _start;
+
+            for(const auto& [trace_file, file] : _files) {
+                _backend.close_file(file);
+            }
+            _files.clear();
+        }
+
+        void report() const {
+            const auto seconds = std::chrono::duration<double>(_elapsed).count();
+
+            printf("replayed %llu requests (%llu failed, %llu skipped), %llu bytes in %.3f s: %.1f MB/s, %.0f requests/s\n",
+                   static_cast<unsigned long long>(_stats.requests), static_cast<unsigned long long>(_stats.failed_requests),
+                   static_cast<unsigned long long>(_stats.skipped_requests), static_cast<unsigned long long>(_stats.bytes), seconds,
+                   static_cast<double>(_stats.bytes) / seconds / (1024.0 * 1024.0), static_cast<double>(_stats.requests) / seconds);
+
+            printf("%-10s %10s %10s %10s %10s %10s %10s\n", "latency us", "count", "p50", "p90", "p99", "p99.9", "max");
+            print_latency("replay", _stats.latency);
+            print_latency("original", _stats.original_latency);
+        }
+
+    private:
+        static void print_latency(const char* name, const latency_histogram& histogram) {
+            const auto us = [&](double percentile) { return static_cast<double>(histogram.value_at_percentile(percentile)) / 1000.0; };
+            printf("%-10s %10llu %10.1f %10.1f %10.1f %10.1f %10.1f\n", name, static_cast<unsigned long long>(histogram.total_count()),
+                   us(50.0), us(90.0), us(99.0), us(99.9), static_cast<double>(histogram.max()) / 1000.0);
+        }
+
+        void enqueue(const io_trace_record& record) {
+            const auto file = _files.find(record.file);
+            if(file == _files.end() || record.offset > _backend.file_size(file->second) || record.size > _backend.file_size(file->second) - record.offset) {
+                // Opened before tracing started, or the file changed since
+                _stats.skipped_requests++;
+                return;
+            }
+
+            auto& request = _requests.emplace(record.request_id, replayed_request {
+                .buffer = std::make_unique_for_overwrite<uint8_t[]>(record.size),
+                .trace_file = record.file,
+                .size = record.size,
+                .enqueue_time = clock::now()
+            }).first->second;
+            _file_requests[record.file]++;
+
+            _backend.enqueue(read_request {
+                .file = file->second,
+                .offset = record.offset,
+                .size = record.size,
+                .destination = request.buffer.get(),
+                .user_data = record.request_id,
+                .priority = record.priority,
+                .destination_kind = record.destination_kind
+            });
+        }
+
+        void drain() {
+            _completions.clear();
+            _backend.poll(_completions);
+
+            const auto now = clock::now();
+            for(const auto& completion : _completions) {
+                auto request = _requests.extract(completion.user_data);
+                auto& replayed = request.mapped();
+
+                _stats.requests++;
+                if(completion.success) {
+                    _stats.bytes += replayed.size;
+                } else {
+                    _stats.failed_requests++;
+                }
+                _stats.latency.record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now - replayed.enqueue_time).count()));
+
+                if(--_file_requests[replayed.trace_file] == 0) {
+                    _file_requests.erase(replayed.trace_file);
+                    if(std::erase(_pending_closes, replayed.trace_file) > 0) {
+                        _backend.close_file(_files.at(replayed.trace_file));
+                        _files.erase(replayed.trace_file);
+                    }
+                }
+            }
+        }
+
+        // Without the original pacing the replay can run ahead of a close, so it waits for the file's reads
+        void close_when_idle(uint64_t trace_file) {
+            const auto file = _files.find(trace_file);
+            if(file == _files.end()) {
+                return;
+            }
+
+            if(_file_requests.contains(trace_file)) {
+                _pending_closes.push_back(trace_file);
+            } else {
+                _backend.close_file(file->second);
+                _files.erase(file);
+            }
+        }
+
+        void wait_until(clock::time_point time) {
+            for(;;) {
+                drain();
+
+                const auto now = clock::now();
+                if(now >= time) {
+                    return;
+                }
+
+                // Completions keep being collected while waiting, so their latency isn't inflated by the pacing
+                if(_backend.in_flight() > 0) {
+                    std::this_thread::sleep_for(std::min<clock::duration>(time - now, std::chrono::microseconds(50)));
+                } else {
+                    std::this_thread::sleep_until(time);
+                }
+            }
+        }
+
+        storage_backend& _backend;
+        const io_trace& _trace;
+        bool _timed;
+
+        std::unordered_map<uint64_t, uint64_t> _files;
+        std::unordered_map<uint64_t, size_t> _file_requests;
+        std::vector<uint64_t> _pending_closes;
+        std::unordered_map<uint64_t, replayed_request> _requests;
+        std::vector<read_completion> _completions;
+
+        clock::time_point _start;
+        clock::duration _elapsed = {};
+        replay_stats _stats = {};
+    };
+
+    void replay(storage_backend& device_backend, const replay_options& options, const io_trace& trace) {
+        std::optional<emulated_backend> emulated;
+        std::optional<autotuning_backend> autotuning;
+        std::optional<job_system> jobs;
+        std::optional<verifying_backend> verifying;
+        std::optional<coalescing_backend> coalescing;
+        std::optional<caching_backend> cache;
+
+        storage_backend* backend = &device_backend;
+        if(options.emulated_desc) {
+            backend = &emulated.emplace(*backend, *options.emulated_desc);
+        }
+        if(options.autotune) {
+            backend = &autotuning.emplace(*backend, options.autotune_desc);
+        }
+        // Below the coalescing backend, so merged reads are checked as one and the cache only keeps verified data
+        if(options.verify_desc) {
+            jobs.emplace(job_system::default_worker_count(), options.placement);
+            backend = &verifying.emplace(*backend, *options.verify_desc, &*jobs);
+        }
+        if(options.coalesce) {
+            backend = &coalescing.emplace(*backend, coalescing_desc {});
+        }
+        if(options.cache_desc) {
+            backend = &cache.emplace(*backend, *options.cache_desc);
+        }
+
+        trace_replayer replayer(*backend, trace, options.timed);
+        replayer.run();
+        replayer.report();
+
+        if(emulated) {
+            const auto& stats = emulated->stats();
+            printf("emulated device: %llu requests, %llu bytes, %llu seeks, %llu waited for a queue slot\n",
+                   static_cast<unsigned long long>(stats.requests), static_cast<unsigned long long>(stats.bytes),
+                   static_cast<unsigned long long>(stats.seeks), static_cast<unsigned long long>(stats.queued_requests));
+        }
+
+        if(autotuning) {
+            const auto& stats = autotuning->stats();
+            printf("autotuner: queue depth %u, request size %llu, %.1f MB/s at p90 %.1f us in the last epoch\n",
+                   stats.queue_depth, static_cast<unsigned long long>(stats.request_size), static_cast<double>(stats.bandwidth) / 1e6,
+                   static_cast<double>(stats.p90_latency.count()) / 1e3);
+            printf("autotuner: %llu epochs (%llu idle), %llu adjustments, %llu latency back-offs, %llu split and %llu merged requests in %llu reads\n",
+                   static_cast<unsigned long long>(stats.epochs), static_cast<unsigned long long>(stats.idle_epochs),
+                   static_cast<unsigned long long>(stats.adjustments), static_cast<unsigned long long>(stats.latency_backoffs),
+                   static_cast<unsigned long long>(stats.split_requests), static_cast<unsigned long long>(stats.merged_requests),
+                   static_cast<unsigned long long>(stats.backend_reads));
+        }
+
+        if(verifying) {
+            const auto& stats = verifying->stats();
+            const auto hash_seconds = std::chrono::duration<double>(stats.hash_time).count();
+            printf("verification: %llu files with checksums, %llu without, %llu with corrupt checksums, %llu chunks and %llu bytes verified, %llu bytes unverified\n",
+                   static_cast<unsigned long long>(stats.verified_files), static_cast<unsigned long long>(stats.unverified_files),
+                   static_cast<unsigned long long>(stats.corrupt_checksum_files),
+                   static_cast<unsigned long long>(stats.verified_chunks), static_cast<unsigned long long>(stats.verified_bytes),
+                   static_cast<unsigned long long>(stats.unverified_bytes));
+            printf("verification: %llu mismatched chunks, %llu retries, %llu failed requests, %.1f ms hashing with %s XXH3 (%.1f GB/s per thread, %u workers)\n",
+                   static_cast<unsigned long long>(stats.mismatched_chunks), static_cast<unsigned long long>(stats.retries),
+                   static_cast<unsigned long long>(stats.failed_requests), hash_seconds * 1e3, xxh3_implementation(),
+                   hash_seconds > 0.0 ? static_cast<double>(stats.verified_bytes) / hash_seconds / 1e9 : 0.0, jobs->worker_count());
+        }
+
+        const auto memory_stats = host_memory_statistics();
+        printf("host memory: %llu bytes in %llu buffers, %llu on explicit huge pages, %llu advised for transparent huge pages (%llu resident), %llu fell back to small pages\n",
+               static_cast<unsigned long long>(memory_stats.bytes), static_cast<unsigned long long>(memory_stats.buffers),
+               static_cast<unsigned long long>(memory_stats.explicit_huge_page_bytes), static_cast<unsigned long long>(memory_stats.transparent_huge_page_bytes),
+               static_cast<unsigned long long>(resident_transparent_huge_page_bytes()), static_cast<unsigned long long>(memory_stats.fallbacks));
+    }
+}
+
+int main(int argc, char** args) {
+    try {
+        const auto options = parse_options(argc, args);
+        const auto trace = read_io_trace(options.trace_path);
+
+        printf("replaying %zu records from %s %s\n", trace.records.size(), options.trace_path.string().c_str(),
+               options.timed ? "with the original timing" : "as fast as possible");
+
+        if(!place_current_thread(options.placement, thread_role::submission, 0)) {
+            printf("could not pin the replaying thread to NUMA node %u\n", placement_node(options.placement, thread_role::submission, 0));
+        }
+
+#ifdef _WIN32
+        ID3D12Device* d3d12_device = nullptr;
+        IDStorageFactory* dstorage_factory = nullptr;
+        throw_if_failed(D3D12CreateDevice(nullptr, D3D_FEATURE_LEVEL_12_0, IID_PPV_ARGS(&d3d12_device)), "D3D12CreateDevice");
+        throw_if_failed(DStorageGetFactory(IID_PPV_ARGS(&dstorage_factory)), "DStorageGetFactory");
+
+        {
+            dstorage_backend backend(dstorage_factory, d3d12_device);
+            replay(backend, options, trace);
+        }
+
+        dstorage_factory->Release();
+        d3d12_device->Release();
+#else
+        auto [backend, backend_kind] = create_storage_backend(options.storage_desc);
+        printf("Replaying through %s\n", storage_backend_name(backend_kind));
+        replay(*backend, options, trace);
+
+        if(backend_kind == storage_backend_kind::pread) {
+            const auto stats = static_cast<pread_backend&>(*backend).stats();
+            printf("pread: %.2f syscalls per request (%llu syscalls, %llu vectored reads)\n",
+                   stats.requests > 0 ? static_cast<double>(stats.syscalls) / static_cast<double>(stats.requests) : 0.0,
+                   static_cast<unsigned long long>(stats.syscalls), static_cast<unsigned long long>(stats.vectored_reads));
+        } else {
+            const auto& uring = static_cast<io_uring_backend&>(*backend);
+            const auto& stats = uring.stats();
+            printf("io_uring: %llu reads, %llu bytes read, %llu bytes through staging buffers, %llu direct and %llu buffered files\n",
+                   static_cast<unsigned long long>(stats.reads), static_cast<unsigned long long>(stats.bytes_read),
+                   static_cast<unsigned long long>(stats.bytes_staged), static_cast<unsigned long long>(stats.direct_files),
+                   static_cast<unsigned long long>(stats.buffered_files));
+            printf("io_uring: %.2f syscalls per request (%llu syscalls, %llu SQPOLL wakeups%s), %.1f completions per harvested batch\n",
+                   stats.requests > 0 ? static_cast<double>(stats.syscalls) / static_cast<double>(stats.requests) : 0.0,
+                   static_cast<unsigned long long>(stats.syscalls), static_cast<unsigned long long>(stats.sq_wakeups),
+                   options.storage_desc.uring.sq_poll && !uring.sq_poll() ? ", SQPOLL refused by the kernel" : "",
+                   stats.completion_batches > 0 ? static_cast<double>(stats.completions) / static_cast<double>(stats.completion_batches) : 0.0);
+        }
+#endif
+    } catch(const std::exception& ex) {
+        printf("%s\n", ex.what());
+        return 1;
+    }
+
+    return 0;
+}